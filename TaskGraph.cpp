@@ -3,12 +3,21 @@
 #include <assert.h>
 #include <iostream>
 #include <map>
+#include <sstream>
 
 #include "src/task_graph.h"
 #include "src/task_graph_utils.h"
+#include "src/task_coroutine.h"
+#include "src/task_pipeline.h"
+#include "src/task_io.h"
+#include "src/flow_graph.h"
 
 #include "ext/ch1.h"
+#include "ext/ch1_tasks.h"
+#include "ext/pixel_kernels.h"
+#include "ext/bmp_writer.h"
 #include "ext/ch2.h"
+#include "ext/ch2_tasks.h"
 
 using namespace std;
 
@@ -99,96 +108,15 @@ void Test2()
 }
 
 using ImagePtr = std::shared_ptr<ch01::Image>;
-auto applyGamma(TaskGraph& graph, TaskRef& parentTask, ImagePtr& image_ptr, ImagePtr& output_image_ptr, double gamma) {
-	
-	const int height = ch01::IMAGE_HEIGHT;
-
-	return ParallelReduce<int>(graph, parentTask, height,
-		[&image_ptr, &output_image_ptr, gamma](unsigned int chunk)->int
-	{
-		auto in_rows = image_ptr->rows();
-		const int width = in_rows[1] - in_rows[0];
-		
-		auto in_row = image_ptr->rows()[chunk];
-		auto out_row = output_image_ptr->rows()[chunk];
-
-		//transform
-		std::transform(in_row, in_row + width,
-			out_row, [gamma](const ch01::Image::Pixel& p) {
-			double v = 0.3*p.bgra[2] + 0.59*p.bgra[1] + 0.11*p.bgra[0];
-			double res = pow(v, gamma);
-			if (res > ch01::MAX_BGR_VALUE) res = ch01::MAX_BGR_VALUE;
-			return ch01::Image::Pixel(res, res, res);
-		});
-		return 0;
-	},
-	[&output_image_ptr]()->int
-	{
-		string outputPath("./");
-		outputPath.append(output_image_ptr->name());
-		outputPath.append(".png");
-
-		output_image_ptr->write(outputPath.c_str());
-
-		std::cout << "Gama tasks done\n";
-		return 0;
-	}
-	);	
-}
-
-auto applyTint(TaskGraph& graph, TaskRef& parentTask, ImagePtr& image_ptr, ImagePtr& output_image_ptr, const double *tints) {
-	
-	//auto in_rows = image_ptr->rows();
-	//const int height = in_rows.size();
-	const int height = ch01::IMAGE_HEIGHT;
-
-	return ParallelReduce<int>(graph, parentTask, height,
-		[&image_ptr, &output_image_ptr, tints](unsigned int chunk)->int
-	{
-		auto in_rows = image_ptr->rows();
-		auto out_rows = output_image_ptr->rows();
-		const int width = in_rows[1] - in_rows[0];
-
-		auto in_row = in_rows[chunk];
-		auto out_row = out_rows[chunk];
-	
-		std::transform(in_row, in_row + width,
-			out_row, [tints](const ch01::Image::Pixel& p) {
-			std::uint8_t b = (double)p.bgra[0] +
-				(ch01::MAX_BGR_VALUE - p.bgra[0])*tints[0];
-			std::uint8_t g = (double)p.bgra[1] +
-				(ch01::MAX_BGR_VALUE - p.bgra[1])*tints[1];
-			std::uint8_t r = (double)p.bgra[2] +
-				(ch01::MAX_BGR_VALUE - p.bgra[2])*tints[2];
-			return ch01::Image::Pixel(
-				(b > ch01::MAX_BGR_VALUE) ? ch01::MAX_BGR_VALUE : b,
-				(g > ch01::MAX_BGR_VALUE) ? ch01::MAX_BGR_VALUE : g,
-				(r > ch01::MAX_BGR_VALUE) ? ch01::MAX_BGR_VALUE : r
-				);
-		});
-
-		return 0;
-	},
-	[&output_image_ptr]()->int
-	{
-		string outputPath("./");
-		outputPath.append(output_image_ptr->name());
-		outputPath.append(".png");
-
-		output_image_ptr->write(outputPath.c_str());
-
-		std::cout << "Tint tasks done\n";
-		return 0;
-	});
-}
 
 void Test3()
 {
 	cout << "\n\nTest 3 start ..\n";
-	cout << "Generating fractal image(serial)..\n";
+	cout << "Generating fractal image(tiled)..\n";
 
 	TaskGraph graph;
-	ImagePtr image;
+	ImagePtr image = std::make_shared<ch01::Image>("fractal_2000000",
+		ch01::IMAGE_WIDTH, ch01::IMAGE_HEIGHT);
 	auto imageWithGamma =
 		std::make_shared<ch01::Image>("fractal_gamma",
 			ch01::IMAGE_WIDTH, ch01::IMAGE_HEIGHT);
@@ -197,25 +125,39 @@ void Test3()
 		std::make_shared<ch01::Image>("fractal_tinted",
 			ch01::IMAGE_WIDTH, ch01::IMAGE_HEIGHT);
 
-	TaskRef generateImageTask = InitialTaskNode<int>::create
+	TaskRef noParent;
+	TaskRef generateImageTask = ch01::makeFractalImageTiled(graph, noParent, image, 2000000);
+
+	//save original image
+	TaskRef writeOriginalTask = InitialTaskNode<void>::create
 		(
-			[&image]()->int
+			[&image]()
 			{
-				image = ch01::makeFractalImage(2000000);
-				//save original image image
 				image->write("./fractal0.png");
-				return 0;
 			}
 			);
+	graph.AddTaskEdge(generateImageTask, writeOriginalTask);
 
-	graph.AddTask(generateImageTask);
-
-	//Apply gamma stage
-	auto gammaTask = applyGamma(graph, generateImageTask, image, imageWithGamma, 1.4f);
-
-	//Apply tint stage
+	//gamma and tint fused in one pass over image, gamma image is materialized only to be written
 	const double tint_array[] = { 0.75, 0, 0 };
-	applyTint(graph, gammaTask, imageWithGamma, imageWithTint, tint_array);
+	auto gammaTintKernel = ch01::makeFusedKernel(
+		ch01::GammaOp(1.4),
+		ch01::MaterializeOp{ ch01::pixelView(*imageWithGamma) },
+		ch01::TintOp(tint_array));
+	auto gammaTintChunks = ch01::applyFusedKernelChunks(graph, generateImageTask, gammaTintKernel,
+		ch01::pixelView(*image), ch01::pixelView(*imageWithTint));
+
+	//rows of both results go to their files as soon as chunk computing them is done
+	ch01::BmpFileWriter gammaWriter(*imageWithGamma, "./" + imageWithGamma->name() + ".png");
+	ch01::BmpFileWriter tintWriter(*imageWithTint, "./" + imageWithTint->name() + ".png");
+	auto writeGammaChunks = ch01::writeBmpChunks(graph, gammaTintChunks, gammaWriter, *imageWithGamma);
+	auto writeTintChunks = ch01::writeBmpChunks(graph, gammaTintChunks, tintWriter, *imageWithTint);
+
+	writeTintChunks.insert(writeTintChunks.end(), writeGammaChunks.begin(), writeGammaChunks.end());
+	JoinChunks<void>(graph, writeTintChunks, []()
+		{
+			std::cout << "Gamma and tint done\n";
+		});
 
 	graph.WaitAll();
 
@@ -270,56 +212,603 @@ void Test5()
 	PNGImage rightImage;
 
 	TaskGraph graph(2);
-	
-	auto increaseLeftPNGChannel = AddTaskSequence<void>(graph,
-		[&leftImage]()
+
+	TaskRef loadLeftImage = InitialTaskNode<void>::create
+		(
+			[&leftImage]()
+			{
+				leftImage = getLeftImage(0);
+				std::cout << "Done loading left image \n";
+			}
+	);
+	TaskRef loadRightImage = InitialTaskNode<void>::create
+		(
+			[&rightImage]()
+			{
+				rightImage = getRightImage(0);
+				std::cout << "Done loading right image \n";
+			}
+	);
+	graph.AddTask(loadLeftImage);
+	graph.AddTask(loadRightImage);
+
+	//images are split into row chunks, merge of chunk waits only for the same chunk of both channel stages
+	const unsigned int chunksCount = 16;
+
+	auto increaseLeftPNGChannel = ParallelForChunks<int>(graph, loadLeftImage, chunksCount,
+		[&leftImage, chunksCount](unsigned int chunk)
 		{
-			leftImage = getLeftImage(0);
-			std::cout << "Done loading left image \n";
-		},
-		[&leftImage]()->int
+			const auto rows = pngChunkRows(leftImage, chunk, chunksCount);
+			increasePNGChannelRows(leftImage, Image::redOffset, 10, rows.first, rows.second);
+			return 0;
+		});
+
+	auto increaseRightPNGChannel = ParallelForChunks<int>(graph, loadRightImage, chunksCount,
+		[&rightImage, chunksCount](unsigned int chunk)
 		{
-			increasePNGChannel(leftImage, Image::redOffset, 10);
-			std::cout << "Done increase PNG channel left \n";
+			const auto rows = pngChunkRows(rightImage, chunk, chunksCount);
+			increasePNGChannelRows(rightImage, Image::blueOffset, 10, rows.first, rows.second);
 			return 0;
 		});
 
-	auto increaseRightPNGChannel = AddTaskSequence<void>(graph,
-		[&rightImage]()
+	auto mergeImages = ParallelForAfter<int>(graph, { increaseLeftPNGChannel, increaseRightPNGChannel }, chunksCount,
+		[&leftImage, &rightImage, chunksCount](unsigned int chunk)
 		{
-			rightImage = getRightImage(0);
-			std::cout << "Done loading right image \n";			
-		},
-		[&rightImage](){
-			increasePNGChannel(rightImage, Image::blueOffset, 10);
-			std::cout << "Done increase PNG channel right \n";			
+			const auto rows = pngChunkRows(leftImage, chunk, chunksCount);
+			mergePNGImagesRows(leftImage, rightImage, rows.first, rows.second);
+			return 0;
 		});
 
-		TaskRef mergeImages = MultiJoinTaskNode<void>::create
-		(
-			[&leftImage, &rightImage](){
-			mergePNGImages(leftImage, rightImage);
-			std::cout << "Done merging images\n";
+	//PNG pieces are compressed as soon as merged rows they filter are ready, join only concatenates them
+	std::vector<png_encoder::Piece> pieces(chunksCount);
+	auto encodeImage = ParallelForAfter<int>(graph, mergeImages, chunksCount,
+		[&leftImage, &pieces, chunksCount](unsigned int chunk)
+		{
+			encodePNGChunk(leftImage, chunk, chunksCount, PNGCompression::Default, pieces[chunk]);
+			return 0;
+		}, ChunkStencil{ 1 });
 
-		},
-			std::vector<TaskRef>{ increaseLeftPNGChannel, increaseRightPNGChannel }
-	);
-	TaskRef writeResult = InitialTaskNode<void>::create
-		(
-			[&leftImage]() -> void {
-				leftImage.write();
-				std::cout << "Done writing image Out0.png \n";
+	JoinChunks<void>(graph, encodeImage,
+		[&leftImage, &pieces]() -> void {
+			std::cout << "Done merging images\n";
+			std::vector<unsigned char> encoded;
+			png_encoder::assemblePNG(leftImage.width, leftImage.height, pieces, PNGCompression::Default, encoded);
+			if (lodepng::save_file(encoded, "out" + std::to_string(leftImage.frameNumber) + ".png"))
+			{
+				std::cerr << "Error: could not write PNG file!" << std::endl;
 			}
-	);
-
-	graph.AddTaskEdges({ increaseLeftPNGChannel, increaseRightPNGChannel }, mergeImages);
-	graph.AddTaskEdge(mergeImages, writeResult);
+			std::cout << "Done writing image Out0.png \n";
+		});
 
 	graph.WaitAll();
 	
 	cout <<"\nTest 5 Done \n";
 }
 
+#ifdef TASKGRAPH_HAS_COROUTINES
+void Test6()
+{
+	cout << "\nTest 6 Start \n";
+
+	TaskGraph graph;
+
+	auto produceSomeInt = InitialTaskNode<int>::create([]()->int
+	{
+		return 1000;
+	});
+
+	//same as Test1 but worker is not blocked while sub graph runs
+	auto doComplexCalculations = CoroutineTaskNode<int>::create(
+		[&]() -> TaskCoroutine<int>
+	{
+		int input = co_await AwaitTask<int>(produceSomeInt);
+
+		TaskGraph subGraph(1);
+		auto node = InitialTaskNode<int>::create(
+			[]()->int
+		{
+			return 500;
+		}
+		);
+		subGraph.AddTask(node);
+
+		auto nodePlusOne = TaskNode<int, int>::create
+			(	node,
+				[](int input)
+				{
+					return input + 1;
+				}
+			);
+
+		subGraph.AddTaskEdge(node, nodePlusOne);
+		co_await AwaitGraph(subGraph);
+
+		std::vector<int> chunks(4, 0);
+		co_await ParallelForAsync<int>(4,
+			[&chunks](unsigned int chunk)->int
+			{
+				chunks[chunk] = 1;
+				return 0;
+			});
+
+		//decoding does not occupy worker
+		PNGImage leftImage = co_await AwaitBlockingCall([]()
+		{
+			return getLeftImage(0);
+		});
+		std::cout << "Loaded left image " << leftImage.width << "x" << leftImage.height << "\n";
+
+		co_return input * 40 * 1000 + nodePlusOne->GetResult() + chunks[0] + chunks[1] + chunks[2] + chunks[3];
+	});
+
+	graph.AddTask(doComplexCalculations);
+	graph.AddTask(produceSomeInt);
+
+	graph.WaitAll();
+
+	assert(doComplexCalculations->GetResult() == 40000505);
+	std::cout << "result " << doComplexCalculations->GetResult() << " \n";
+
+	cout << "Test 6 Done \n";
+}
+#endif
+
+void Test7()
+{
+	cout << "\nTest 7 Start \n";
+
+	using Image = PNGImage;
+	using ImagePair = std::pair<PNGImage, PNGImage>;
+
+	const int numImages = 8;
+	std::atomic<int> writtenImages{ 0 };
+
+	initStereo3D(numImages);
+
+	//stream stereo frames, at most 4 frames in flight
+	ParallelPipeline(4,
+		MakeFilter<void, Image>(FilterMode::SerialInOrder,
+			[](FlowControl& flowControl) -> Image
+			{
+				if (uint64_t frameNumber = getNextFrameNumber())
+				{
+					return getLeftImage(frameNumber);
+				}
+				flowControl.Stop();
+				return Image{};
+			}) &
+		MakeFilter<Image, ImagePair>(FilterMode::SerialInOrder,
+			[](Image left) -> ImagePair
+			{
+				return ImagePair(left, getRightImage(left.frameNumber));
+			}) &
+		MakeFilter<ImagePair, ImagePair>(FilterMode::Parallel,
+			[](ImagePair p) -> ImagePair
+			{
+				increasePNGChannel(p.first, Image::redOffset, 10);
+				return p;
+			}) &
+		MakeFilter<ImagePair, ImagePair>(FilterMode::Parallel,
+			[](ImagePair p) -> ImagePair
+			{
+				increasePNGChannel(p.second, Image::blueOffset, 10);
+				return p;
+			}) &
+		MakeFilter<ImagePair, Image>(FilterMode::Parallel,
+			[](ImagePair p) -> Image
+			{
+				mergePNGImages(p.second, p.first);
+				return p.second;
+			}) &
+		MakeFilter<Image, void>(FilterMode::SerialOutOfOrder,
+			[&writtenImages](Image img)
+			{
+				img.write();
+				++writtenImages;
+			})
+		);
+
+	assert(writtenImages == numImages);
+	cout << "Written images " << writtenImages << "\n";
+	cout << "Test 7 Done \n";
+}
+
+void Test8()
+{
+	cout << "\nTest 8 Start \n";
+
+	struct SensorSample
+	{
+		JoinTag id;
+		double value;
+	};
+	using SamplePair = std::tuple<SensorSample, SensorSample>;
+
+	const int numSamples = 100;
+	std::vector<double> processed;
+	{
+		//standing graph, samples are pushed as they come
+		FlowGraph flowGraph(4);
+
+		BufferNode<SensorSample> buffer(flowGraph);
+		LimiterNode<SensorSample> limiter(flowGraph, 8);
+		BroadcastNode<SensorSample> input(flowGraph);
+
+		FunctionNode<SensorSample, SensorSample> calibrate(flowGraph, UnlimitedConcurrency,
+			[](const SensorSample& sample)
+			{
+				return SensorSample{ sample.id, sample.value * 2 };
+			});
+
+		FunctionNode<SensorSample, SensorSample> offset(flowGraph, 2,
+			[](const SensorSample& sample)
+			{
+				return SensorSample{ sample.id, sample.value + 1 };
+			});
+
+		auto sampleTag = [](const SensorSample& sample) { return sample.id; };
+		JoinNode<TagMatchingJoin, SensorSample, SensorSample> join(flowGraph, sampleTag, sampleTag);
+
+		FunctionNode<SamplePair, SensorSample> combine(flowGraph, UnlimitedConcurrency,
+			[](const SamplePair& samples)
+			{
+				return SensorSample{ std::get<0>(samples).id, std::get<0>(samples).value + std::get<1>(samples).value };
+			});
+
+		SequencerNode<SensorSample> sequencer(flowGraph,
+			[](const SensorSample& sample)
+			{
+				return static_cast<size_t>(sample.id);
+			});
+
+		FunctionNode<SensorSample, ContinueMsg> collect(flowGraph, 1,
+			[&processed](const SensorSample& sample)
+			{
+				processed.push_back(sample.value);
+				return ContinueMsg{};
+			});
+
+		MakeEdge(buffer, limiter);
+		MakeEdge(limiter, input);
+		MakeEdge(input, calibrate);
+		MakeEdge(input, offset);
+		MakeEdge(calibrate, join.InputPort<0>());
+		MakeEdge(offset, join.InputPort<1>());
+		MakeEdge(join, combine);
+		MakeEdge(combine, sequencer);
+		MakeEdge(sequencer, collect);
+		MakeEdge(collect, limiter.DecrementPort());
+
+		for (int sample = 0; sample < numSamples; ++sample)
+		{
+			buffer.TryPut(SensorSample{ static_cast<JoinTag>(sample), static_cast<double>(sample) });
+		}
+
+		flowGraph.WaitForAll();
+	}
+
+	assert(processed.size() == numSamples);
+	for (int sample = 0; sample < numSamples; ++sample)
+	{
+		assert(processed[sample] == sample * 3 + 1);
+	}
+	cout << "Processed samples " << processed.size() << "\n";
+	cout << "Test 8 Done \n";
+}
+
+void Test9()
+{
+	cout << "\nTest 9 Start \n";
+
+	//timeline of a small fan out graph exported as chrome trace
+	const int numTasks = 64;
+	std::atomic<int> executed{ 0 };
+
+	TaskGraph graph(4);
+	graph.EnableTracing();
+
+	auto root = InitialTaskNode<void>::create([]() {});
+	graph.AddTask(root);
+
+	for (int i = 0; i < numTasks; ++i)
+	{
+		graph.AddTaskEdge(root, InitialTaskNode<void>::create([&executed]() { ++executed; }));
+	}
+
+	graph.WaitAll();
+
+	std::ostringstream trace;
+	graph.GetTracer()->WriteChromeTrace(trace);
+
+	const std::string json = trace.str();
+	size_t taskEvents = 0;
+	for (auto pos = json.find("\"cat\":\"task\""); pos != std::string::npos; pos = json.find("\"cat\":\"task\"", pos + 1))
+	{
+		++taskEvents;
+	}
+
+	assert(executed == numTasks);
+	assert(taskEvents == numTasks + 1);
+	assert(graph.GetTracer()->GetDroppedEvents() == 0);
+	cout << "Traced tasks " << taskEvents << "\n";
+	cout << "Test 9 Done \n";
+}
+
+void Test10()
+{
+	cout << "\nTest 10 Start \n";
+
+	const int numTasks = 1000;
+	int snapshots = 0;
+
+	TaskGraph graph(4);
+	graph.SetStatisticsCallback([&snapshots](const SchedulerStatistics& statistics)
+	{
+		assert(statistics.workers.size() == 4);
+		++snapshots;
+	}, std::chrono::milliseconds(5));
+
+	for (int i = 0; i < numTasks; ++i)
+	{
+		graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	}
+
+	//keep graph busy for a few snapshot periods
+	graph.AddTask(InitialTaskNode<void>::create([]()
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(30));
+	}));
+
+	graph.WaitAll();
+
+	const auto total = graph.GetStatistics().Total();
+
+	assert(total.executedTasks == numTasks + 1);
+	assert(total.queueHighWater > 0);
+	assert(snapshots > 0);
+	cout << "Executed " << total.executedTasks << " stolen " << total.stolenTasks
+		<< " failed steals " << total.failedSteals << " wake ups " << total.wakeUps
+		<< " snapshots " << snapshots << "\n";
+	cout << "Test 10 Done \n";
+}
+
+void Test11()
+{
+	cout << "\nTest 11 Start \n";
+
+	auto sleepFor = [](int milliseconds)
+	{
+		return [milliseconds]() { std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds)); };
+	};
+
+	//chain of three long tasks is the critical path, short tasks run beside it
+	TaskGraph graph(4);
+	graph.EnableProfiling();
+
+	TaskRef first = InitialTaskNode<void>::create(sleepFor(10));
+	TaskRef second = InitialTaskNode<void>::create(sleepFor(10));
+	TaskRef third = InitialTaskNode<void>::create(sleepFor(10));
+	graph.AddTask(first);
+	graph.AddTaskEdge(first, second);
+	graph.AddTaskEdge(second, third);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		TaskRef side = InitialTaskNode<void>::create(sleepFor(2));
+		graph.AddTaskEdge(first, side);
+	}
+
+	graph.WaitAll();
+
+	const auto report = graph.AnalyzeLastExecution();
+	report.Print(cout);
+
+	const std::vector<TaskId> expectedPath{ first->GetTaskId(), second->GetTaskId(), third->GetTaskId() };
+	assert(report.criticalPath == expectedPath);
+	assert(report.span >= 30 * 1000000LL);
+	assert(report.work > report.span);
+	assert(report.wallTime >= report.span);
+	assert(report.workerUtilization.size() == 4);
+	cout << "Test 11 Done \n";
+}
+
+void Test12()
+{
+	cout << "\nTest 12 Start \n";
+
+	TaskGraph graph(4);
+	graph.EnableProfiling();
+
+	TaskRef load = InitialTaskNode<int>::create([]() { return 1; });
+	load->SetName("load");
+	graph.AddTask(load);
+
+	auto reduce = ParallelReduce<int>(graph, load, 8,
+		[](unsigned int chunk) { return static_cast<int>(chunk); },
+		[]() { return 0; });
+	reduce->SetName("reduce \"sum\"");
+
+	//structure is known before run
+	std::ostringstream dotBefore;
+	GraphExporter(graph.DescribeGraph()).WriteDot(dotBefore);
+	assert(dotBefore.str().find("ParallelTaskNode") != std::string::npos);
+
+	graph.WaitAll();
+
+	auto description = DescribeExecution(graph.GetExecutionProfile());
+	assert(description.nodes.size() == 10);
+	assert(description.criticalPath.front() == load->GetTaskId());
+	assert(description.criticalPath.back() == reduce->GetTaskId());
+
+	std::ostringstream dot;
+	GraphExporter(description).WriteDot(dot);
+	assert(dot.str().find("label=\"load\\nInitialTaskNode") != std::string::npos);
+	assert(dot.str().find("reduce \\\"sum\\\"\\nMultiJoinTaskNode") != std::string::npos);
+	assert(dot.str().find("fan-in 8") != std::string::npos);
+
+	std::ostringstream graphML;
+	GraphExporter(description).WriteGraphML(graphML);
+	assert(graphML.str().find("reduce &quot;sum&quot;") != std::string::npos);
+
+	cout << "Test 12 Done \n";
+}
+
+void Test13()
+{
+	cout << "\nTest 13 Start \n";
+
+	TaskGraph graph(2);
+	const bool available = graph.EnablePerfCounters();
+
+	std::vector<int> data(1 << 20, 1);
+	TaskRef noParent;
+	auto sum = ParallelReduce<long long>(graph, noParent, 4,
+		[&data](unsigned int chunk)
+		{
+			long long partial = 0;
+			for (size_t i = chunk; i < data.size(); i += 4)
+			{
+				partial += data[i];
+			}
+			return partial;
+		},
+		[]() { return 0LL; });
+	sum->SetName("sum");
+
+	graph.WaitAll();
+
+	const auto report = graph.AnalyzePerfCounters();
+	assert(report.byType.at("ParallelTaskNode").tasks == 4);
+	assert(report.byName.at("sum").tasks == 1);
+	assert(report.byName.at("unnamed").tasks == 4);
+	if (available)
+	{
+		assert(report.byType.at("ParallelTaskNode").values.instructions > 0);
+	}
+
+	report.Print(cout);
+	cout << "Hardware counters " << (available ? "available" : "not available") << "\n";
+	cout << "Test 13 Done \n";
+}
+
+void Test14()
+{
+	cout << "\nTest 14 Start \n";
+
+	//histogram keeps values within 1/16
+	LatencyHistogram histogram;
+	for (unsigned long long value = 1; value <= 100000; ++value)
+	{
+		histogram.Record(value);
+	}
+	assert(histogram.GetCount() == 100000);
+	assert(std::abs(static_cast<double>(histogram.GetValueAtPercentile(50)) - 50000) < 50000 / 16.0);
+	assert(std::abs(static_cast<double>(histogram.GetValueAtPercentile(99)) - 99000) < 99000 / 16.0);
+
+	auto model = std::make_shared<TaskCostModel>();
+
+	//grain size follows item cost, first run has no history
+	std::vector<int> items(200000, 1);
+	std::atomic<long long> sum{ 0 };
+	unsigned int chunksCounts[2] = {};
+	for (int run = 0; run < 2; ++run)
+	{
+		sum = 0;
+		TaskGraph graph(4);
+		chunksCounts[run] = ParallelForAdaptive(graph, *model, "sum items", static_cast<unsigned int>(items.size()),
+			[&](unsigned int begin, unsigned int end)
+			{
+				long long partial = 0;
+				for (auto i = begin; i < end; ++i)
+				{
+					partial += items[i];
+				}
+				sum += partial;
+			}, 4);
+		graph.WaitAll();
+		assert(sum == static_cast<long long>(items.size()));
+	}
+	assert(chunksCounts[0] == 16);
+	assert(model->EstimateItemNanoseconds("sum items") > 0);
+
+	//learned long chain runs before short tasks on single worker
+	model->Record("chain", 1000000);
+	model->Record("short", 1000);
+
+	TaskGraph graph(1);
+	graph.SetCostModel(model);
+
+	std::vector<std::string> order;
+	for (int i = 0; i < 8; ++i)
+	{
+		TaskRef shortTask = InitialTaskNode<void>::create([&order]() { order.push_back("short"); });
+		shortTask->SetName("short");
+		graph.AddTask(shortTask);
+	}
+
+	TaskRef chainHead = InitialTaskNode<void>::create([&order]() { order.push_back("chain"); });
+	chainHead->SetName("chain");
+	graph.AddTask(chainHead);
+	TaskRef chainTail = InitialTaskNode<void>::create([]() {});
+	chainTail->SetName("chain");
+	graph.AddTaskEdge(chainHead, chainTail);
+
+	graph.WaitAll();
+
+	assert(order.front() == "chain");
+	assert(model->GetLatencyHistogram("short").GetCount() == 9);
+	cout << "Chunks without history " << chunksCounts[0] << " with history " << chunksCounts[1] << "\n";
+	cout << "Test 14 Done \n";
+}
+
+void Test15()
+{
+	cout << "\nTest 15 Start \n";
+
+	using ImagePair = std::pair<PNGImage, PNGImage>;
+	const unsigned long long numImages = 8;
+	std::atomic<int> writtenImages{ 0 };
+
+	{
+		TaskGraph graph(2);
+		//decode and encode run on I/O threads, workers only process frames
+		IoExecutor io(graph, 2);
+
+		auto prefetcher = std::make_shared<IoPrefetcher<ImagePair>>(io, 3,
+			[numImages](unsigned long long frameNumber, ImagePair& frame)
+			{
+				if (frameNumber > numImages)
+				{
+					return false;
+				}
+				frame = ImagePair(getLeftImage(frameNumber), getRightImage(frameNumber));
+				return true;
+			},
+			[&io, &writtenImages](unsigned long long, ImagePair frame)
+			{
+				increasePNGChannel(frame.first, PNGImage::redOffset, 10);
+				increasePNGChannel(frame.second, PNGImage::blueOffset, 10);
+				mergePNGImages(frame.second, frame.first);
+
+				io.SubmitWrite([image = frame.second, &writtenImages]()
+				{
+					image.write();
+					++writtenImages;
+				});
+			});
+		prefetcher->Start(1);
+
+		graph.WaitAll();
+	}
+
+	assert(writtenImages == numImages);
+	cout << "Written images " << writtenImages << "\n";
+	//frames are decoded into recycled buffers once first ones are released
+	const auto poolStats = pngBufferPool().GetStats();
+	cout << "Frame buffers reused " << poolStats.hits << " allocated " << poolStats.misses << "\n";
+	cout << "Test 15 Done \n";
+}
+
 int main()
 {
 	Test1();
@@ -327,10 +816,19 @@ int main()
 	Test3();
 	Test4();
 	Test5();
-
-	cout << "\nType a word and pres [Enter] to exit\n";
-	char z;
-	cin >> z;
-    return 0;
+#ifdef TASKGRAPH_HAS_COROUTINES
+	Test6();
+#endif
+	Test7();
+	Test8();
+	Test9();
+	Test10();
+	Test11();
+	Test12();
+	Test13();
+	Test14();
+	Test15();
+
+	return 0;
 }
 
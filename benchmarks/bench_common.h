@@ -0,0 +1,226 @@
+#pragma once
+#include "../src/task_graph.h"
+#include "../src/task_items.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+//integer option of one benchmark, parsed together with shared ones
+struct BenchmarkOption
+{
+	const char* name;
+	int value;
+	int minimum;
+	const char* help;
+};
+
+//command line shared by benchmarks
+//--threads N max threads, --reps N repetitions, --scale N size multiplier
+//--filter text runs matching cases only, --json prints json lines instead of csv
+//benchmark adds its own integer options, --help prints all of them
+//unknown option or bad value prints usage and exits
+struct BenchmarkOptions
+{
+	unsigned int maxThreads{ GetNumberOfCPUs() };
+	unsigned int repetitions{ 5 };
+	unsigned int scale{ 1 };
+	std::string filter;
+	bool json{ false };
+	std::vector<BenchmarkOption> extraOptions;
+
+	BenchmarkOptions(int argc, char* argv[], std::vector<BenchmarkOption> options = {}) :
+		extraOptions(std::move(options))
+	{
+		for (int arg = 1; arg < argc; ++arg)
+		{
+			const bool hasValue = arg + 1 < argc;
+			if (!std::strcmp(argv[arg], "--help"))
+			{
+				PrintUsage(std::cout, argv[0]);
+				std::exit(0);
+			}
+			else if (!std::strcmp(argv[arg], "--json"))
+			{
+				json = true;
+			}
+			else if (!std::strcmp(argv[arg], "--filter") && hasValue)
+			{
+				filter = argv[++arg];
+			}
+			else if (!std::strcmp(argv[arg], "--threads") && hasValue)
+			{
+				maxThreads = ParseValue(argv, arg, 1);
+			}
+			else if (!std::strcmp(argv[arg], "--reps") && hasValue)
+			{
+				repetitions = ParseValue(argv, arg, 1);
+			}
+			else if (!std::strcmp(argv[arg], "--scale") && hasValue)
+			{
+				scale = ParseValue(argv, arg, 1);
+			}
+			else
+			{
+				auto option = std::find_if(extraOptions.begin(), extraOptions.end(),
+					[&](const BenchmarkOption& extra) { return !std::strcmp(argv[arg], extra.name); });
+				if (option == extraOptions.end() || !hasValue)
+				{
+					Fail(argv, std::string("unknown option or missing value ") + argv[arg]);
+				}
+				option->value = ParseValue(argv, arg, option->minimum);
+			}
+		}
+	}
+
+	bool Selected(const std::string& name) const
+	{
+		return filter.empty() || name.find(filter) != std::string::npos;
+	}
+
+	//value of benchmark option, default when not given
+	int Value(const char* name) const
+	{
+		for (const auto& option : extraOptions)
+		{
+			if (!std::strcmp(option.name, name))
+			{
+				return option.value;
+			}
+		}
+		return 0;
+	}
+
+private:
+	void PrintUsage(std::ostream& out, const char* program) const
+	{
+		out << "usage: " << program << " [--threads N] [--reps N] [--scale N] [--filter name] [--json] [--help]\n";
+		for (const auto& option : extraOptions)
+		{
+			out << "  " << option.name << " N  " << option.help << ", default " << option.value << "\n";
+		}
+	}
+
+	[[noreturn]] void Fail(char* argv[], const std::string& error) const
+	{
+		std::cerr << argv[0] << ": " << error << "\n";
+		PrintUsage(std::cerr, argv[0]);
+		std::exit(1);
+	}
+
+	//value after option at arg, whole argument has to be number of at least minimum
+	int ParseValue(char* argv[], int& arg, int minimum) const
+	{
+		const char* name = argv[arg];
+		const char* text = argv[++arg];
+		char* end = nullptr;
+		const long value = std::strtol(text, &end, 10);
+		if (end == text || *end != '\0' || value < minimum || value > std::numeric_limits<int>::max())
+		{
+			Fail(argv, std::string("bad value ") + text + " of " + name);
+		}
+		return static_cast<int>(value);
+	}
+};
+
+struct BenchmarkResult
+{
+	std::string name;
+	unsigned int threads{ 1 };
+	//tasks executed by one repetition
+	size_t tasks{ 0 };
+	//work items of one repetition ( e.g. pixels ), zero when case only counts tasks
+	size_t items{ 0 };
+	double bestMs{ 0 };
+	double medianMs{ 0 };
+};
+
+class Stopwatch
+{
+	std::chrono::steady_clock::time_point _start{ std::chrono::steady_clock::now() };
+public:
+	double ElapsedMs() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - _start).count();
+	}
+};
+
+//runs case repetitions times, runCase gets thread count and returns measured milliseconds
+//so that graph construction can stay out of the measurement
+template<typename CaseType>
+BenchmarkResult RunBenchmark(const std::string& name, unsigned int threads, size_t tasks, unsigned int repetitions, CaseType&& runCase)
+{
+	std::vector<double> times;
+	for (unsigned int rep = 0; rep < repetitions; ++rep)
+	{
+		times.push_back(runCase(threads));
+	}
+	std::sort(times.begin(), times.end());
+
+	BenchmarkResult result;
+	result.name = name;
+	result.threads = threads;
+	result.tasks = tasks;
+	result.bestMs = times.front();
+	result.medianMs = times[times.size() / 2];
+	return result;
+}
+
+class BenchmarkReporter
+{
+	bool _json;
+	//best time on one thread per case, base of speedup
+	std::vector<std::pair<std::string, double>> _singleThreadTimes;
+
+public:
+	explicit BenchmarkReporter(bool json) :
+		_json(json)
+	{
+		if (!_json)
+		{
+			std::cout << "name,threads,tasks,best_ms,median_ms,tasks_per_s,speedup,efficiency,items,items_per_s\n";
+		}
+	}
+
+	void Report(const BenchmarkResult& result)
+	{
+		if (result.threads == 1)
+		{
+			_singleThreadTimes.emplace_back(result.name, result.bestMs);
+		}
+
+		double speedup = 0;
+		for (const auto& singleThreadTime : _singleThreadTimes)
+		{
+			if (singleThreadTime.first == result.name)
+			{
+				speedup = singleThreadTime.second / result.bestMs;
+			}
+		}
+
+		const double tasksPerSecond = result.bestMs > 0 ? result.tasks / (result.bestMs / 1000.0) : 0;
+		const double itemsPerSecond = result.bestMs > 0 ? result.items / (result.bestMs / 1000.0) : 0;
+		//speedup per thread, 1 is perfect scaling
+		const double efficiency = speedup / result.threads;
+
+		if (_json)
+		{
+			std::cout << "{\"name\":\"" << result.name << "\",\"threads\":" << result.threads
+				<< ",\"tasks\":" << result.tasks << ",\"best_ms\":" << result.bestMs
+				<< ",\"median_ms\":" << result.medianMs << ",\"tasks_per_s\":" << tasksPerSecond
+				<< ",\"speedup\":" << speedup << ",\"efficiency\":" << efficiency
+				<< ",\"items\":" << result.items << ",\"items_per_s\":" << itemsPerSecond << "}\n";
+		}
+		else
+		{
+			std::cout << result.name << "," << result.threads << "," << result.tasks << ","
+				<< result.bestMs << "," << result.medianMs << "," << tasksPerSecond << "," << speedup << ","
+				<< efficiency << "," << result.items << "," << itemsPerSecond << "\n";
+		}
+		std::cout.flush();
+	}
+};
@@ -0,0 +1,378 @@
+//image stages of Test3 and Test5 over growing images, chunking strategies and thread counts
+//nothing is written to disk, sources are generated once per size outside of measurement
+//usage: bench_image [--threads N] [--reps N] [--filter name] [--json] [--help]
+//                   [--max-size N] largest image side, sizes are 800, 2000, 4000, 8000, 16000
+//                   [--fractal-max-size N] largest side of serial fractal case, default 800
+#include "bench_common.h"
+#include "../src/task_graph_utils.h"
+#include "../ext/ch1_tasks.h"
+#include "../ext/pixel_kernels.h"
+#include "../ext/ch2_tasks.h"
+
+enum class Chunking
+{
+	//one task per row like Test3
+	Row,
+	//one chunk per thread
+	PerThread,
+	//eight chunks per thread, leaves room for stealing
+	Oversubscribed,
+	//chunk size learned by cost model
+	Adaptive
+};
+
+struct ChunkingStrategy
+{
+	Chunking chunking;
+	const char* name;
+};
+
+const ChunkingStrategy ChunkingStrategies[] =
+{
+	{ Chunking::Row, "row" },
+	{ Chunking::PerThread, "per_thread" },
+	{ Chunking::Oversubscribed, "oversubscribed" },
+	{ Chunking::Adaptive, "adaptive" }
+};
+
+//adds tasks calling rowsCallable(begin, end) for all rows, returns tasks count
+template<typename RowsCallable>
+size_t AddRowTasks(TaskGraph& graph, Chunking chunking, unsigned int threads, unsigned int rows,
+	TaskCostModel& model, const std::string& name, RowsCallable&& rowsCallable)
+{
+	if (chunking == Chunking::Adaptive)
+	{
+		return ParallelForAdaptive(graph, model, name, rows, rowsCallable, threads);
+	}
+
+	unsigned int chunksCount = rows;
+	if (chunking == Chunking::PerThread)
+	{
+		chunksCount = threads;
+	}
+	else if (chunking == Chunking::Oversubscribed)
+	{
+		chunksCount = threads * 8;
+	}
+	chunksCount = std::max(1u, std::min(chunksCount, rows));
+
+	ParallelFor<int>(graph, chunksCount, [rows, chunksCount, rowsCallable](unsigned int chunk)
+	{
+		const unsigned int begin = static_cast<unsigned int>(static_cast<unsigned long long>(rows) * chunk / chunksCount);
+		const unsigned int end = static_cast<unsigned int>(static_cast<unsigned long long>(rows) * (chunk + 1) / chunksCount);
+		rowsCallable(begin, end);
+		return 0;
+	});
+	return chunksCount;
+}
+
+//measures graph built by addTasks, returns milliseconds and stores tasks count
+template<typename AddTasksCallable>
+double RunRowsCase(unsigned int threads, size_t& tasksCount, AddTasksCallable&& addTasks)
+{
+	TaskGraph graph(threads);
+	tasksCount = addTasks(graph);
+
+	Stopwatch stopwatch;
+	graph.WaitAll();
+	return stopwatch.ElapsedMs();
+}
+
+//cheap deterministic pattern, fractal of big sizes takes minutes to generate
+std::shared_ptr<ch01::Image> MakePatternImage(int size)
+{
+	auto image = std::make_shared<ch01::Image>("pattern", size, size);
+	image->fill([](int x, int y) { return (x * 7 + y * 13) % 256; });
+	return image;
+}
+
+PNGImage MakePatternPNG(int size, unsigned char seed)
+{
+	PNGImage image;
+	image.width = size;
+	image.height = size;
+	image.buffer = std::make_shared<std::vector<unsigned char>>(static_cast<size_t>(size) * size * PNGImage::numChannels);
+
+	auto& buffer = *image.buffer;
+	for (size_t i = 0; i < buffer.size(); ++i)
+	{
+		buffer[i] = static_cast<unsigned char>(i * 31 + seed);
+	}
+	return image;
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options(argc, argv, {
+		{ "--max-size", 4000, 1, "largest image side, sizes are 800, 2000, 4000, 8000, 16000" },
+		{ "--fractal-max-size", 800, 1, "largest side of serial fractal case" } });
+	BenchmarkReporter reporter(options.json);
+
+	const int maxSize = options.Value("--max-size");
+	const int fractalMaxSize = options.Value("--fractal-max-size");
+
+	const double tints[] = { 0.75, 0, 0 };
+	const auto gammaCurve = ch01::ToneCurve::gamma(1.4);
+
+	for (int size : { 800, 2000, 4000, 8000, 16000 })
+	{
+		if (size > maxSize)
+		{
+			break;
+		}
+
+		const size_t pixels = static_cast<size_t>(size) * size;
+		const unsigned int rows = static_cast<unsigned int>(size);
+		const std::string sizeName = std::to_string(size);
+
+		//serial generation, base line for parallel generators
+		if (size <= fractalMaxSize && options.Selected("fractal"))
+		{
+			auto result = RunBenchmark("fractal_serial/" + sizeName, 1, 1, options.repetitions, [&](unsigned int)
+			{
+				Stopwatch stopwatch;
+				ch01::makeFractalImage(2000000, size, size);
+				return stopwatch.ElapsedMs();
+			});
+			result.items = pixels;
+			reporter.Report(result);
+		}
+
+		//single thread kernel throughput, scalar kernel is calcOnePixel
+		for (auto kernel : { ch01::FractalKernel::Scalar, ch01::FractalKernel::Avx2, ch01::FractalKernel::Avx512 })
+		{
+			const std::string name = std::string("fractal_kernel/") + ch01::fractalKernelName(kernel) + "/" + sizeName;
+			if (size > fractalMaxSize || !ch01::fractalKernelSupported(kernel) || !options.Selected(name))
+			{
+				continue;
+			}
+
+			auto result = RunBenchmark(name, 1, 1, options.repetitions, [&](unsigned int)
+			{
+				const ch01::Fractal fractal(size, size);
+				std::vector<double> values(size);
+
+				Stopwatch stopwatch;
+				for (int row = 0; row < size; ++row)
+				{
+					ch01::calcFractalPixels(fractal, row, 0, size, values.data(), kernel);
+				}
+				return stopwatch.ElapsedMs();
+			});
+			result.items = pixels;
+			reporter.Report(result);
+		}
+
+		//tiles are balanced dynamically, fractal cost varies a lot between regions
+		for (int tileSize : { 16, 64, 256 })
+		{
+			const std::string name = "fractal_tiled_" + std::to_string(tileSize) + "/" + sizeName;
+			if (size > fractalMaxSize || !options.Selected(name))
+			{
+				continue;
+			}
+
+			for (unsigned int threads = 1; threads <= options.maxThreads; ++threads)
+			{
+				auto result = RunBenchmark(name, threads, 0, options.repetitions, [&](unsigned int numThreads)
+				{
+					Stopwatch stopwatch;
+					ch01::makeFractalImageParallel(2000000, size, size, numThreads, tileSize);
+					return stopwatch.ElapsedMs();
+				});
+				result.tasks = std::min<size_t>(threads, ((size + tileSize - 1) / tileSize) * ((size + tileSize - 1) / tileSize)) + 1;
+				result.items = pixels;
+				reporter.Report(result);
+			}
+		}
+
+		//PNG encode of merged Test5 image, lodepng is serial base line, pieces are compressed in parallel
+		const PNGImage encodeSource = MakePatternPNG(size, 1);
+		if (options.Selected("png_encode_lodepng/" + sizeName))
+		{
+			auto result = RunBenchmark("png_encode_lodepng/" + sizeName, 1, 1, options.repetitions, [&](unsigned int)
+			{
+				std::vector<unsigned char> encoded;
+				Stopwatch stopwatch;
+				lodepng::encode(encoded, *encodeSource.buffer, encodeSource.width, encodeSource.height);
+				return stopwatch.ElapsedMs();
+			});
+			result.items = pixels;
+			reporter.Report(result);
+		}
+
+		for (auto compression : { PNGCompression::Fast, PNGCompression::Default })
+		{
+			const std::string name = std::string("png_encode/") + (compression == PNGCompression::Fast ? "fast" : "default") + "/" + sizeName;
+			if (!options.Selected(name))
+			{
+				continue;
+			}
+
+			for (unsigned int threads = 1; threads <= options.maxThreads; ++threads)
+			{
+				const unsigned int chunksCount = threads * 4;
+				std::vector<unsigned char> encoded;
+				size_t tasksCount = 0;
+				auto result = RunBenchmark(name, threads, 0, options.repetitions, [&](unsigned int numThreads)
+				{
+					return RunRowsCase(numThreads, tasksCount, [&](TaskGraph& graph)
+					{
+						TaskRef noParent;
+						encodePNGParallel(graph, noParent, encodeSource, encoded, compression, chunksCount);
+						return static_cast<size_t>(chunksCount) + 1;
+					});
+				});
+				result.tasks = tasksCount;
+				result.items = pixels;
+				reporter.Report(result);
+			}
+		}
+
+		auto source = MakePatternImage(size);
+		ch01::Image target("target", size, size);
+		ch01::Image intermediate("intermediate", size, size);
+		auto gammaTintKernel = ch01::makeFusedKernel(ch01::GammaOp(1.4), ch01::TintOp(tints));
+		auto gammaTintMaterializedKernel = ch01::makeFusedKernel(ch01::GammaOp(1.4),
+			ch01::MaterializeOp{ ch01::pixelView(intermediate) }, ch01::TintOp(tints));
+		PNGImage left = MakePatternPNG(size, 1);
+		PNGImage right = MakePatternPNG(size, 2);
+
+		//gamma then tint over intermediate image, stages meet at global join or chunk of tint waits for its chunk of gamma
+		for (bool chained : { false, true })
+		{
+			const std::string name = std::string(chained ? "gamma_tint_chained/" : "gamma_tint_joined/") + sizeName;
+			if (!options.Selected(name))
+			{
+				continue;
+			}
+
+			for (unsigned int threads = 1; threads <= options.maxThreads; ++threads)
+			{
+				const unsigned int chunksCount = std::min(rows, threads * 8);
+				auto chunkRows = [rows, chunksCount](unsigned int chunk)
+				{
+					return std::make_pair(static_cast<int>(rows * chunk / chunksCount), static_cast<int>(rows * (chunk + 1) / chunksCount));
+				};
+				auto gammaChunk = [&, chunkRows](unsigned int chunk)
+				{
+					const auto range = chunkRows(chunk);
+					ch01::applyToneCurveToRows(*gammaCurve, *source, intermediate, range.first, range.second);
+					return 0;
+				};
+				auto tintChunk = [&, chunkRows](unsigned int chunk)
+				{
+					const auto range = chunkRows(chunk);
+					ch01::applyTintToRows(intermediate, target, tints, range.first, range.second);
+					return 0;
+				};
+
+				size_t tasksCount = 0;
+				auto result = RunBenchmark(name, threads, 0, options.repetitions, [&](unsigned int numThreads)
+				{
+					return RunRowsCase(numThreads, tasksCount, [&](TaskGraph& graph)
+					{
+						TaskRef noParent;
+						if (chained)
+						{
+							auto gammaStage = ParallelForChunks<int>(graph, noParent, chunksCount, gammaChunk);
+							ParallelForAfter<int>(graph, gammaStage, chunksCount, tintChunk);
+						}
+						else
+						{
+							TaskRef gammaJoin = ParallelReduce<int>(graph, noParent, chunksCount, gammaChunk, []() { return 0; });
+							ParallelForChunks<int>(graph, gammaJoin, chunksCount, tintChunk);
+						}
+						return static_cast<size_t>(chunksCount) * 2;
+					});
+				});
+				result.tasks = tasksCount;
+				result.items = pixels;
+				reporter.Report(result);
+			}
+		}
+
+		for (const auto& strategy : ChunkingStrategies)
+		{
+			//cost model keeps what it learned over repetitions and thread counts
+			TaskCostModel model;
+
+			for (unsigned int threads = 1; threads <= options.maxThreads; ++threads)
+			{
+				auto runStage = [&](const std::string& stage, auto rowsCallable)
+				{
+					const std::string name = stage + "/" + strategy.name + "/" + sizeName;
+					if (!options.Selected(name))
+					{
+						return;
+					}
+
+					size_t tasksCount = 0;
+					auto result = RunBenchmark(name, threads, 0, options.repetitions, [&](unsigned int numThreads)
+					{
+						return RunRowsCase(numThreads, tasksCount, [&](TaskGraph& graph)
+						{
+							return AddRowTasks(graph, strategy.chunking, numThreads, rows, model, name, rowsCallable);
+						});
+					});
+					result.tasks = tasksCount;
+					result.items = pixels;
+					reporter.Report(result);
+				};
+
+				runStage("gamma", [&](unsigned int begin, unsigned int end)
+				{
+					ch01::applyGammaToRows(*source, target, 1.4, begin, end);
+				});
+
+				runStage("gamma_lut", [&](unsigned int begin, unsigned int end)
+				{
+					ch01::applyToneCurveToRows(*gammaCurve, *source, target, begin, end);
+				});
+
+				runStage("tint", [&](unsigned int begin, unsigned int end)
+				{
+					ch01::applyTintToRows(*source, target, tints, begin, end);
+				});
+
+				//compare with gamma_lut followed by tint, both stages in one pass
+				runStage("gamma_tint_fused", [&](unsigned int begin, unsigned int end)
+				{
+					gammaTintKernel.applyToRows(ch01::pixelView(*source), ch01::pixelView(target), begin, end);
+				});
+
+				//same with gamma image materialized, costs one more write stream
+				runStage("gamma_tint_fused_materialized", [&](unsigned int begin, unsigned int end)
+				{
+					gammaTintMaterializedKernel.applyToRows(ch01::pixelView(*source), ch01::pixelView(target), begin, end);
+				});
+
+				runStage("channel", [&](unsigned int begin, unsigned int end)
+				{
+					increasePNGChannelRows(left, PNGImage::redOffset, 10, begin, end);
+				});
+
+				runStage("merge", [&](unsigned int begin, unsigned int end)
+				{
+					mergePNGImagesRows(right, left, begin, end);
+				});
+
+				//byte loops the vector kernels replaced
+				runStage("channel_scalar", [&](unsigned int begin, unsigned int end)
+				{
+					const size_t rowBytes = static_cast<size_t>(size) * PNGImage::numChannels;
+					addToChannelScalar(left.buffer->data() + rowBytes * begin, static_cast<size_t>(size) * (end - begin), PNGImage::redOffset, 10);
+				});
+
+				runStage("merge_scalar", [&](unsigned int begin, unsigned int end)
+				{
+					const size_t rowBytes = static_cast<size_t>(size) * PNGImage::numChannels;
+					copyChannelScalar(right.buffer->data() + rowBytes * begin, left.buffer->data() + rowBytes * begin,
+						static_cast<size_t>(size) * (end - begin), PNGImage::redOffset);
+				});
+			}
+		}
+	}
+
+	return 0;
+}
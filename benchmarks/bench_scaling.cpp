@@ -0,0 +1,33 @@
+//scaling of scheduler on empty tasks, from 1 thread to number of CPUs
+//usage: bench_scaling [--threads N] [--reps N] [--scale N] [--json]
+#include "bench_common.h"
+
+double RunEmptyTasks(unsigned int numThreads, size_t tasksCount)
+{
+	TaskGraph graph(numThreads);
+
+	for (size_t i = 0; i < tasksCount; ++i)
+	{
+		graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	}
+
+	Stopwatch stopwatch;
+	graph.WaitAll();
+	return stopwatch.ElapsedMs();
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options(argc, argv);
+	BenchmarkReporter reporter(options.json);
+
+	const size_t tasksCount = 100000 * options.scale;
+
+	for (unsigned int numThreads = 1; numThreads <= options.maxThreads; ++numThreads)
+	{
+		reporter.Report(RunBenchmark("empty_tasks_scaling", numThreads, tasksCount, options.repetitions,
+			[&](unsigned int threads) { return RunEmptyTasks(threads, tasksCount); }));
+	}
+
+	return 0;
+}
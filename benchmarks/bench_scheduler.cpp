@@ -0,0 +1,174 @@
+//scheduler overhead on tiny tasks for different graph shapes, from 1 thread to --threads
+//usage: bench_scheduler [--threads N] [--reps N] [--scale N] [--filter name] [--json] [--help]
+//                       [--dag-width N] tasks in every level of random_dag, default 64
+//                       [--dag-depth N] levels of random_dag, default 100 * scale
+#include "bench_common.h"
+#include "../src/task_graph_utils.h"
+#include <random>
+
+//independent tasks, measures pure queueing and completion cost
+double EmptyTasks(unsigned int threads, size_t tasksCount)
+{
+	TaskGraph graph(threads);
+	for (size_t i = 0; i < tasksCount; ++i)
+	{
+		graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	}
+
+	Stopwatch stopwatch;
+	graph.WaitAll();
+	return stopwatch.ElapsedMs();
+}
+
+//root, chunks and join as built by ParallelReduce
+double FanOutFanIn(unsigned int threads, size_t chunks)
+{
+	TaskGraph graph(threads);
+	TaskRef root = InitialTaskNode<int>::create([]() { return 0; });
+	graph.AddTask(root);
+
+	ParallelReduce<int>(graph, root, static_cast<unsigned int>(chunks),
+		[](unsigned int chunk) { return static_cast<int>(chunk); },
+		[]() { return 0; });
+
+	Stopwatch stopwatch;
+	graph.WaitAll();
+	return stopwatch.ElapsedMs();
+}
+
+//every task depends on previous one, measures round trip worker - coordinator
+double Chain(unsigned int threads, size_t length)
+{
+	TaskGraph graph(threads);
+	TaskRef previous = InitialTaskNode<void>::create([]() {});
+	graph.AddTask(previous);
+
+	for (size_t i = 1; i < length; ++i)
+	{
+		TaskRef next = InitialTaskNode<void>::create([]() {});
+		graph.AddTaskEdge(previous, next);
+		previous = next;
+	}
+
+	Stopwatch stopwatch;
+	graph.WaitAll();
+	return stopwatch.ElapsedMs();
+}
+
+//layers of width tasks, every task depends on up to maxParents tasks of previous layer
+double RandomDag(unsigned int threads, size_t width, size_t depth, size_t maxParents)
+{
+	TaskGraph graph(threads);
+	std::mt19937 random(12345);
+
+	std::vector<TaskRef> previousLayer;
+	for (size_t i = 0; i < width; ++i)
+	{
+		TaskRef task = InitialTaskNode<void>::create([]() {});
+		graph.AddTask(task);
+		previousLayer.push_back(task);
+	}
+
+	for (size_t layer = 1; layer < depth; ++layer)
+	{
+		std::vector<TaskRef> currentLayer;
+		for (size_t i = 0; i < width; ++i)
+		{
+			const size_t parentsCount = 1 + random() % maxParents;
+			std::vector<TaskRef> parents;
+			for (size_t parent = 0; parent < parentsCount; ++parent)
+			{
+				auto& candidate = previousLayer[random() % width];
+				if (std::find(parents.begin(), parents.end(), candidate) == parents.end())
+				{
+					parents.push_back(candidate);
+				}
+			}
+
+			TaskRef task = MultiJoinTaskNode<void>::create([]() {}, parents);
+			graph.AddTaskEdges(parents, task);
+			currentLayer.push_back(task);
+		}
+		previousLayer.swap(currentLayer);
+	}
+
+	Stopwatch stopwatch;
+	graph.WaitAll();
+	return stopwatch.ElapsedMs();
+}
+
+//tasks running their own small graph like Test1, measures graph start and shutdown latency
+double NestedGraphs(unsigned int threads, size_t outerTasks)
+{
+	TaskGraph graph(threads);
+	for (size_t i = 0; i < outerTasks; ++i)
+	{
+		graph.AddTask(InitialTaskNode<int>::create([]()
+		{
+			TaskGraph subGraph(1);
+			auto node = InitialTaskNode<int>::create([]() { return 500; });
+			subGraph.AddTask(node);
+
+			auto nodePlusOne = TaskNode<int, int>::create(node, [](int input) { return input + 1; });
+			subGraph.AddTaskEdge(node, nodePlusOne);
+			subGraph.WaitAll();
+
+			return nodePlusOne->GetResult();
+		}));
+	}
+
+	Stopwatch stopwatch;
+	graph.WaitAll();
+	return stopwatch.ElapsedMs();
+}
+
+int main(int argc, char* argv[])
+{
+	BenchmarkOptions options(argc, argv, {
+		{ "--dag-width", 64, 1, "tasks in every level of random_dag" },
+		{ "--dag-depth", 0, 0, "levels of random_dag, 0 is 100 * scale" } });
+	BenchmarkReporter reporter(options.json);
+
+	const size_t emptyTasks = 50000 * options.scale;
+	const size_t fanOutChunks = 20000 * options.scale;
+	const size_t chainLength = 5000 * options.scale;
+	const size_t dagWidth = options.Value("--dag-width");
+	const size_t dagDepth = options.Value("--dag-depth") > 0 ? options.Value("--dag-depth") : 100 * options.scale;
+	const size_t dagMaxParents = 4;
+	const size_t nestedGraphs = 200 * options.scale;
+
+	for (unsigned int threads = 1; threads <= options.maxThreads; ++threads)
+	{
+		if (options.Selected("empty_tasks"))
+		{
+			reporter.Report(RunBenchmark("empty_tasks", threads, emptyTasks, options.repetitions,
+				[&](unsigned int numThreads) { return EmptyTasks(numThreads, emptyTasks); }));
+		}
+
+		if (options.Selected("fan_out_in"))
+		{
+			reporter.Report(RunBenchmark("fan_out_in", threads, fanOutChunks + 2, options.repetitions,
+				[&](unsigned int numThreads) { return FanOutFanIn(numThreads, fanOutChunks); }));
+		}
+
+		if (options.Selected("chain"))
+		{
+			reporter.Report(RunBenchmark("chain", threads, chainLength, options.repetitions,
+				[&](unsigned int numThreads) { return Chain(numThreads, chainLength); }));
+		}
+
+		if (options.Selected("random_dag"))
+		{
+			reporter.Report(RunBenchmark("random_dag", threads, dagWidth * dagDepth, options.repetitions,
+				[&](unsigned int numThreads) { return RandomDag(numThreads, dagWidth, dagDepth, dagMaxParents); }));
+		}
+
+		if (options.Selected("nested_graphs"))
+		{
+			reporter.Report(RunBenchmark("nested_graphs", threads, nestedGraphs * 3, options.repetitions,
+				[&](unsigned int numThreads) { return NestedGraphs(numThreads, nestedGraphs); }));
+		}
+	}
+
+	return 0;
+}
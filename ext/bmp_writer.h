@@ -0,0 +1,118 @@
+#pragma once
+#include "ch1.h"
+#include "../src/task_graph_utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CH01_HAS_PWRITE 1
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace ch01 {
+
+	//BMP file of image written in row ranges as they get ready, in any order and from many threads
+	//file is created at full size with header, every range is one write at its offset ( rows are bottom-up )
+	//so output overlaps with computation and no pass over whole image is needed at the end
+	class BmpFileWriter {
+	public:
+		BmpFileWriter(const Image& image, const std::string& fname) : myImage(image) {
+			const auto header = image.bmpHeader();
+#ifdef CH01_HAS_PWRITE
+			myFile = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			myGood = myFile >= 0 && ::ftruncate(myFile, static_cast<off_t>(image.bmpFileSize())) == 0;
+#else
+			myStream.open(fname, std::ios::binary | std::ios::out | std::ios::trunc);
+			myGood = myStream.good();
+#endif
+			myGood = myGood && writeAt(header.data(), header.size(), 0);
+			if (!myGood)
+				std::cerr << "Error: could not write BMP file!" << std::endl;
+		}
+
+		~BmpFileWriter() {
+#ifdef CH01_HAS_PWRITE
+			if (myFile >= 0)
+				::close(myFile);
+#endif
+		}
+
+		bool good() const { return myGood; }
+
+		//rows [rowBegin, rowEnd) of image, they must be done and not change until write returns
+		void writeRows(int rowBegin, int rowEnd) {
+			rowBegin = std::max(rowBegin, 0);
+			rowEnd = std::min(rowEnd, myImage.height());
+			if (!myGood || rowBegin >= rowEnd)
+				return;
+
+			//range is contiguous in file from last row up
+			const size_t rowSize = myImage.bmpRowSize();
+			const size_t pixelsSize = myImage.width() * sizeof(Image::Pixel);
+			std::vector<char> buffer(rowSize * (rowEnd - rowBegin), 0);
+			for (int row = rowBegin; row < rowEnd; ++row)
+				std::memcpy(buffer.data() + rowSize * (rowEnd - 1 - row), myImage.rows()[row], pixelsSize);
+
+			if (!writeAt(buffer.data(), buffer.size(), myImage.bmpRowOffset(rowEnd - 1))) {
+				myGood = false;
+				std::cerr << "Error: could not write BMP file!" << std::endl;
+			}
+		}
+
+	private:
+		bool writeAt(const char* data, size_t size, size_t offset) {
+#ifdef CH01_HAS_PWRITE
+			while (size > 0) {
+				const ssize_t written = ::pwrite(myFile, data, size, static_cast<off_t>(offset));
+				if (written < 0 && errno == EINTR)
+					continue;
+				if (written <= 0)
+					return false;
+				data += written;
+				size -= static_cast<size_t>(written);
+				offset += static_cast<size_t>(written);
+			}
+			return true;
+#else
+			std::lock_guard<std::mutex> lock(myMutex);
+			myStream.seekp(static_cast<std::streamoff>(offset));
+			myStream.write(data, size);
+			return myStream.good();
+#endif
+		}
+
+		BmpFileWriter(const BmpFileWriter&);
+		void operator=(const BmpFileWriter&);
+
+		const Image& myImage;
+		std::atomic<bool> myGood{ false };
+#ifdef CH01_HAS_PWRITE
+		int myFile = -1;
+#else
+		std::mutex myMutex;
+		std::ofstream myStream;
+#endif
+	};
+
+	//write stage after chunk tasks of image rows, chunk is written as soon as it is done
+	//rows of chunk are split like in applyFusedKernelChunks, returns write tasks of chunks
+	inline std::vector<TaskRef> writeBmpChunks(TaskGraph& graph, const std::vector<TaskRef>& chunkTasks, BmpFileWriter& writer,
+		const Image& image) {
+		const unsigned int chunksCount = static_cast<unsigned int>(chunkTasks.size());
+		const unsigned long long rows = static_cast<unsigned long long>(image.height());
+		return ParallelForAfter<int>(graph, chunkTasks, chunksCount,
+			[&writer, rows, chunksCount](unsigned int chunk) {
+				writer.writeRows(static_cast<int>(rows * chunk / chunksCount), static_cast<int>(rows * (chunk + 1) / chunksCount));
+				return 0;
+			});
+	}
+}
@@ -29,6 +29,7 @@ SPDX-License-Identifier: MIT
 #include <memory>
 #include <string>
 #include <vector>
+#include "../src/task_buffer_pool.h"
 
 namespace ch01 {
 
@@ -47,6 +48,16 @@ namespace ch01 {
 			reset(w, h);
 		}
 
+		~Image() {
+			pixelPool().Release(std::move(myData));
+		}
+
+		//raster buffers of all images, buffer of destroyed image is reused by next one of same size
+		static BufferPool<Pixel>& pixelPool() {
+			static auto* pool = new BufferPool<Pixel>();
+			return *pool;
+		}
+
 		std::string name() const { return myName; }
 		std::string setName(const std::string &n) { return myName = n; }
 
@@ -58,12 +69,30 @@ namespace ch01 {
 				std::cout << "Warning: Image is empty.\n";
 				return;
 			}
-			std::ofstream stream{ fname };
-			stream.write((char*)&file.type, file.sizeRest);
-			stream.write((char*)&info, info.size);
-			stream.write((char*)myData[0].bgra, myData.size()*sizeof(myData[0]));
+			std::ofstream stream{ fname, std::ios::binary };
+			const auto header = bmpHeader();
+			stream.write(header.data(), header.size());
+
+			//rows are stored bottom-up, each padded to 4 bytes
+			const char padding[4] = {};
+			for (int row = myHeight - 1; row >= 0; --row) {
+				stream.write((const char*)myRows[row], myWidth*sizeof(myData[0]));
+				stream.write(padding, myPadSize);
+			}
 		}
 
+		//BMP file layout, lets writers put rows straight at their place in file
+		std::vector<char> bmpHeader() const {
+			std::vector<char> header(file.offBits, 0);
+			std::copy((const char*)&file.type, (const char*)&file.type + file.sizeRest, header.begin());
+			std::copy((const char*)&info, (const char*)&info + info.size, header.begin() + file.sizeRest);
+			return header;
+		}
+		size_t bmpFileSize() const { return file.size; }
+		size_t bmpRowSize() const { return myWidth*sizeof(myData[0]) + myPadSize; }
+		size_t bmpRowOffset(int row) const { return file.offBits + bmpRowSize()*(myHeight - 1 - row); }
+		int bmpPadSize() const { return myPadSize; }
+
 		void fill(std::uint8_t r, std::uint8_t g, std::uint8_t b, int x = -1, int y = -1) {
 			if (myData.empty())
 				return;
@@ -93,7 +122,23 @@ namespace ch01 {
 			});
 		}
 
+		//same as fill for rows [rowBegin, rowEnd) and columns [columnBegin, columnEnd) only
+		//tiles can be filled from many threads, image must be allocated
+		template <typename F>
+		void fillTile(F f, int rowBegin, int rowEnd, int columnBegin, int columnEnd) {
+			for (int x = rowBegin; x < rowEnd; ++x) {
+				Pixel* row = myRows[x];
+				for (int y = columnBegin; y < columnEnd; ++y) {
+					auto val = f(x, y);
+					if (val > 255)
+						val = 255;
+					row[y] = Image::Pixel(val, val, val);
+				}
+			}
+		}
+
 		std::vector<Pixel*>& rows() { return myRows; }
+		const std::vector<Pixel*>& rows() const { return myRows; }
 
 	private:
 		void reset(int w, int h) {
@@ -104,8 +149,10 @@ namespace ch01 {
 
 			myWidth = w, myHeight = h;
 
-			//reset raw data
-			myData.resize(myWidth*myHeight);
+			//reset raw data, pooled buffer keeps content of previous image
+			if (!myData.empty())
+				pixelPool().Release(std::move(myData));
+			myData = pixelPool().Acquire(myWidth*myHeight);
 			myRows.resize(myHeight);
 
 			//reset rows
@@ -114,7 +161,7 @@ namespace ch01 {
 
 			myPadSize = (4 - (w*sizeof(myData[0])) % 4) % 4;
 			int sizeData = w*h*sizeof(myData[0]) + h*myPadSize;
-			int sizeAll = sizeData + sizeof(file) + sizeof(info);
+			int sizeAll = sizeData + 14 + 40; //file and info headers as stored, without sizeRest
 
 			//BITMAPFILEHEADER
 			file.sizeRest = 14;
@@ -189,11 +236,9 @@ namespace ch01 {
 		//! Constructor
 		Fractal(int x, int y, double m = 2000000.0) : mySize{ x, y }, myMagn(m) {}
 		//! One pixel calculation routine
-		double calcOnePixel(int x0, int y0) {
-			double fx0 = double(x0) - double(mySize[0]) / 2;
-			double fy0 = double(y0) - double(mySize[1]) / 2;
-			fx0 = fx0 / myMagn + cx;
-			fy0 = fy0 / myMagn + cy;
+		double calcOnePixel(int x0, int y0) const {
+			const double fx0 = realPart(x0);
+			const double fy0 = imagPart(y0);
 
 			double res = 0, x = 0, y = 0;
 			for (int iter = 0; x*x + y*y <= 4 && iter < maxIter; ++iter) {
@@ -204,6 +249,15 @@ namespace ch01 {
 			return res;
 		}
 
+		//! Pixel coordinates mapped to complex plane, used by vectorized kernels
+		double realPart(int x0) const {
+			return (double(x0) - double(mySize[0]) / 2) / myMagn + cx;
+		}
+		double imagPart(int y0) const {
+			return (double(y0) - double(mySize[1]) / 2) / myMagn + cy;
+		}
+		int maxIterations() const { return maxIter; }
+
 	private:
 		//! Size of the Fractal area
 		const int mySize[2];
@@ -214,12 +268,43 @@ namespace ch01 {
 		const int maxIter = 1000;
 	};
 
-	static std::shared_ptr<Image> makeFractalImage(double magn = 2000000) {
+	inline std::shared_ptr<Image> makeFractalImage(double magn = 2000000, int width = IMAGE_WIDTH, int height = IMAGE_HEIGHT) {
 		const std::string name = std::string("fractal_") + std::to_string((int)magn);
-		auto image_ptr = std::make_shared<Image>(name, IMAGE_WIDTH, IMAGE_HEIGHT);
+		auto image_ptr = std::make_shared<Image>(name, width, height);
 		Fractal fr(image_ptr->width(), image_ptr->height(), magn);
 		image_ptr->fill([&fr](int x, int y) { return fr.calcOnePixel(x, y); });
 		return image_ptr;
 	}
 
-}
\ No newline at end of file
+	//grayscale with gamma of rows [rowBegin, rowEnd), images have the same size
+	inline void applyGammaToRows(Image& in, Image& out, double gamma, int rowBegin, int rowEnd) {
+		const int width = in.width();
+		for (int row = rowBegin; row < rowEnd; ++row) {
+			auto in_row = in.rows()[row];
+			std::transform(in_row, in_row + width, out.rows()[row], [gamma](const Image::Pixel& p) {
+				double v = 0.3*p.bgra[2] + 0.59*p.bgra[1] + 0.11*p.bgra[0];
+				double res = pow(v, gamma);
+				if (res > MAX_BGR_VALUE) res = MAX_BGR_VALUE;
+				return Image::Pixel(res, res, res);
+			});
+		}
+	}
+
+	//moves every channel towards white by its tint in range 0 - 1
+	inline void applyTintToRows(Image& in, Image& out, const double* tints, int rowBegin, int rowEnd) {
+		const int width = in.width();
+		for (int row = rowBegin; row < rowEnd; ++row) {
+			auto in_row = in.rows()[row];
+			std::transform(in_row, in_row + width, out.rows()[row], [tints](const Image::Pixel& p) {
+				std::uint8_t b = (double)p.bgra[0] + (MAX_BGR_VALUE - p.bgra[0])*tints[0];
+				std::uint8_t g = (double)p.bgra[1] + (MAX_BGR_VALUE - p.bgra[1])*tints[1];
+				std::uint8_t r = (double)p.bgra[2] + (MAX_BGR_VALUE - p.bgra[2])*tints[2];
+				return Image::Pixel(
+					(b > MAX_BGR_VALUE) ? MAX_BGR_VALUE : b,
+					(g > MAX_BGR_VALUE) ? MAX_BGR_VALUE : g,
+					(r > MAX_BGR_VALUE) ? MAX_BGR_VALUE : r);
+			});
+		}
+	}
+
+}
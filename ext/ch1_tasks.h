@@ -0,0 +1,46 @@
+#pragma once
+#include "ch1.h"
+#include "fractal_simd.h"
+#include "../src/task_graph_utils.h"
+
+namespace ch01 {
+
+	//fractal generated in tiles on graph, tiles are balanced dynamically between tasksCount tasks
+	//image has to be allocated, pixels are ready when returned task is done
+	//tile rows are computed by kernel, consecutive columns share vector lanes
+	inline TaskRef makeFractalImageTiled(TaskGraph& graph, TaskRef& parent, const std::shared_ptr<Image>& image_ptr,
+		double magn = 2000000, int tileSize = 64, unsigned int tasksCount = GetNumberOfCPUs(),
+		FractalKernel kernel = bestFractalKernel()) {
+		auto fractal = std::make_shared<Fractal>(image_ptr->width(), image_ptr->height(), magn);
+
+		//image rows are fractal x, tile x runs over columns
+		return ParallelForTiles(graph, parent, image_ptr->width(), image_ptr->height(), tileSize, tileSize,
+			[image_ptr, fractal, kernel](const TileRange& tile) {
+				std::vector<double> values(tile.x1 - tile.x0);
+				for (unsigned int row = tile.y0; row < tile.y1; ++row) {
+					calcFractalPixels(*fractal, row, tile.x0, static_cast<int>(values.size()), values.data(), kernel);
+
+					Image::Pixel* pixels = image_ptr->rows()[row];
+					for (size_t i = 0; i < values.size(); ++i) {
+						const double val = std::min(values[i], 255.0);
+						pixels[tile.x0 + i] = Image::Pixel(val, val, val);
+					}
+				}
+			}, tasksCount);
+	}
+
+	//same image as makeFractalImage, generated by its own graph
+	inline std::shared_ptr<Image> makeFractalImageParallel(double magn = 2000000, int width = IMAGE_WIDTH, int height = IMAGE_HEIGHT,
+		unsigned int numThreads = GetNumberOfCPUs(), int tileSize = 64, FractalKernel kernel = bestFractalKernel()) {
+		const std::string name = std::string("fractal_") + std::to_string((int)magn);
+		auto image_ptr = std::make_shared<Image>(name, width, height);
+
+		TaskGraph graph(numThreads);
+		TaskRef noParent;
+		makeFractalImageTiled(graph, noParent, image_ptr, magn, tileSize, numThreads, kernel);
+		graph.WaitAll();
+
+		return image_ptr;
+	}
+
+}
@@ -27,6 +27,8 @@ SPDX-License-Identifier: MIT
 #include <utility>
 #include <vector>
 #include "lodepng.h"
+#include "png_simd.h"
+#include "../src/task_buffer_pool.h"
 //#include <tbb/tbb.h>
 
 class PNGImage {
@@ -101,34 +103,48 @@ void mergePNGImages(PNGImage& right, const PNGImage& left);
 //		);
 //}
 
-PNGImage::PNGImage(uint64_t frame_number, const std::string& file_name) :
-	frameNumber{ frame_number }, buffer{ std::make_shared< std::vector<unsigned char> >() } {
-	if (lodepng::decode(*buffer, width, height, file_name)) {
+//pixel buffers of decoded frames, they go back to pool when last image sharing them is gone
+inline BufferPool<unsigned char>& pngBufferPool() {
+	static auto* pool = new BufferPool<unsigned char>();
+	return *pool;
+}
+
+inline PNGImage::PNGImage(uint64_t frame_number, const std::string& file_name) :
+	frameNumber{ frame_number } {
+	//size is read from header first, so pixels are decoded into pooled buffer of right capacity
+	std::vector<unsigned char> file;
+	lodepng::State state;
+	unsigned error = lodepng::load_file(file, file_name);
+	if (!error)
+		error = lodepng_inspect(&width, &height, &state, file.data(), file.size());
+	buffer = pngBufferPool().AcquireShared(error ? 0 : static_cast<size_t>(width) * height * numChannels);
+	buffer->clear();
+	if (error || lodepng::decode(*buffer, width, height, file)) {
 		std::cerr << "Error: could not read PNG file!" << std::endl;
 		width = height = 0;
 	}
 };
 
-PNGImage::PNGImage(const PNGImage& p) : frameNumber{ p.frameNumber },
+inline PNGImage::PNGImage(const PNGImage& p) : frameNumber{ p.frameNumber },
 width{ p.width }, height{ p.height },
 buffer{ p.buffer } {}
 
-void PNGImage::write() const {
+inline void PNGImage::write() const {
 	std::string file_name = std::string("out") + std::to_string(frameNumber) + ".png";
 	if (lodepng::encode(file_name, *buffer, width, height)) {
 		std::cerr << "Error: could not write PNG file!" << std::endl;
 	}
 }
 
-static int stereo3DFrameCounter = 0;
-static int stero3DNumImages = 0;
+inline int stereo3DFrameCounter = 0;
+inline int stero3DNumImages = 0;
 
-void initStereo3D(int num_images) {
+inline void initStereo3D(int num_images) {
 	stereo3DFrameCounter = 0;
 	stero3DNumImages = num_images;
 }
 
-int getNextFrameNumber() {
+inline int getNextFrameNumber() {
 	if (stereo3DFrameCounter < stero3DNumImages) {
 		return ++stereo3DFrameCounter;
 	}
@@ -137,42 +153,36 @@ int getNextFrameNumber() {
 	}
 }
 
-PNGImage getLeftImage(uint64_t frameNumber) {
+inline PNGImage getLeftImage(uint64_t frameNumber) {
 	return PNGImage(frameNumber, "input1.png");
 }
 
-PNGImage getRightImage(uint64_t frameNumber) {
+inline PNGImage getRightImage(uint64_t frameNumber) {
 	return PNGImage(frameNumber, "input2.png");
 }
 
-void increasePNGChannel(PNGImage& image, int channel_offset, int increase) {
-	const int height_base = PNGImage::numChannels * image.width;
-	std::vector<unsigned char>& buffer = *image.buffer;
-
-	// Increase selected color channel by a predefined value
-	for (unsigned int y = 0; y < image.height; y++) {
-		const int height_offset = height_base * y;
-		for (unsigned int x = 0; x < image.width; x++) {
-			int pixel_offset = height_offset + PNGImage::numChannels * x + channel_offset;
-			buffer[pixel_offset] = static_cast<uint8_t>(std::min(buffer[pixel_offset] + increase, 255));
-		}
-	}
+inline void increasePNGChannelRows(PNGImage& image, int channel_offset, int increase, unsigned int row_begin, unsigned int row_end) {
+	const size_t row_pixels = image.width;
+	unsigned char* pixels = image.buffer->data() + PNGImage::numChannels * row_pixels * row_begin;
+
+	// Increase selected color channel by a predefined value, saturating at 255
+	addToChannel(pixels, row_pixels * (row_end - row_begin), channel_offset, increase);
 }
 
-void mergePNGImages(PNGImage& right, const PNGImage& left) {
-	const int channels_per_pixel = PNGImage::numChannels;
-	const int height_base = channels_per_pixel * right.width;
-	std::vector<unsigned char>& left_buffer = *left.buffer;
-	std::vector<unsigned char>& right_buffer = *right.buffer;
-
-	for (unsigned int y = 0; y < right.height; y++) {
-		const int height_offset = height_base * y;
-		for (unsigned int x = 0; x < right.width; x++) {
-			const int pixel_offset = height_offset + channels_per_pixel * x;
-			const int red_index = pixel_offset + PNGImage::redOffset;
-			right_buffer[red_index] = left_buffer[red_index];
-		}
-	}
+inline void increasePNGChannel(PNGImage& image, int channel_offset, int increase) {
+	increasePNGChannelRows(image, channel_offset, increase, 0, image.height);
+}
+
+inline void mergePNGImagesRows(PNGImage& right, const PNGImage& left, unsigned int row_begin, unsigned int row_end) {
+	const size_t row_pixels = right.width;
+	const size_t offset = PNGImage::numChannels * row_pixels * row_begin;
+
+	// Red channel of right image is taken from left one
+	copyChannel(right.buffer->data() + offset, left.buffer->data() + offset, row_pixels * (row_end - row_begin), PNGImage::redOffset);
+}
+
+inline void mergePNGImages(PNGImage& right, const PNGImage& left) {
+	mergePNGImagesRows(right, left, 0, right.height);
 }
 
 //static void warmupTBB() {
@@ -0,0 +1,59 @@
+#pragma once
+#include "ch2.h"
+#include "png_encoder.h"
+#include "../src/task_graph_utils.h"
+#include <memory>
+
+//rows [first, second) of chunk when image is split into chunksCount chunks
+inline std::pair<unsigned int, unsigned int> pngChunkRows(const PNGImage& image, unsigned int chunk, unsigned int chunksCount) {
+	const unsigned long long height = image.height;
+	return { static_cast<unsigned int>(height * chunk / chunksCount), static_cast<unsigned int>(height * (chunk + 1) / chunksCount) };
+}
+
+//rows of image in chunksCount tasks, returns join task chained after parent when given
+//images are read when tasks run, so parent can load them, they must live until join is done
+inline TaskRef increasePNGChannelParallel(TaskGraph& graph, TaskRef& parent, PNGImage& image, int channel_offset, int increase,
+	unsigned int chunksCount = GetNumberOfCPUs() * 4) {
+	return ParallelReduce<int>(graph, parent, chunksCount,
+		[&image, channel_offset, increase, chunksCount](unsigned int chunk) {
+			const auto rows = pngChunkRows(image, chunk, chunksCount);
+			increasePNGChannelRows(image, channel_offset, increase, rows.first, rows.second);
+			return 0;
+		},
+		[]() { return 0; });
+}
+
+//same split as increasePNGChannelParallel, chunk of right image gets red channel of same chunk of left one
+inline TaskRef mergePNGImagesParallel(TaskGraph& graph, TaskRef& parent, PNGImage& right, const PNGImage& left,
+	unsigned int chunksCount = GetNumberOfCPUs() * 4) {
+	return ParallelReduce<int>(graph, parent, chunksCount,
+		[&right, &left, chunksCount](unsigned int chunk) {
+			const auto rows = pngChunkRows(right, chunk, chunksCount);
+			mergePNGImagesRows(right, left, rows.first, rows.second);
+			return 0;
+		},
+		[]() { return 0; });
+}
+
+//piece of PNG encoded from rows of chunk, first row is filtered against last row of previous chunk,
+//so in chunked pipeline it waits for previous chunk too ( ChunkStencil )
+inline void encodePNGChunk(const PNGImage& image, unsigned int chunk, unsigned int chunksCount, PNGCompression compression,
+	png_encoder::Piece& piece) {
+	const auto rows = pngChunkRows(image, chunk, chunksCount);
+	png_encoder::encodePiece(image.buffer->data(), image.width, rows.first, rows.second, chunk + 1 == chunksCount, compression, piece);
+}
+
+//PNG file bytes encoded in chunksCount tasks, join concatenates pieces into out
+inline TaskRef encodePNGParallel(TaskGraph& graph, TaskRef& parent, const PNGImage& image, std::vector<unsigned char>& out,
+	PNGCompression compression = PNGCompression::Default, unsigned int chunksCount = GetNumberOfCPUs() * 4) {
+	auto pieces = std::make_shared<std::vector<png_encoder::Piece>>(chunksCount);
+	return ParallelReduce<int>(graph, parent, chunksCount,
+		[&image, pieces, compression, chunksCount](unsigned int chunk) {
+			encodePNGChunk(image, chunk, chunksCount, compression, (*pieces)[chunk]);
+			return 0;
+		},
+		[&image, &out, pieces, compression]() {
+			png_encoder::assemblePNG(image.width, image.height, *pieces, compression, out);
+			return 0;
+		});
+}
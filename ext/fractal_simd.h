@@ -0,0 +1,208 @@
+#pragma once
+#include "ch1.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CH01_HAS_X86_FRACTAL_KERNELS 1
+#include <immintrin.h>
+//gcc fuses multiply and add of intrinsics when target has fma, which changes escape iterations
+#if defined(__clang__)
+#define CH01_NO_FP_CONTRACT
+#else
+#define CH01_NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#endif
+#endif
+
+namespace ch01 {
+
+	enum class FractalKernel {
+		Scalar,
+		Avx2,
+		Avx512
+	};
+
+	inline const char* fractalKernelName(FractalKernel kernel) {
+		switch (kernel) {
+		case FractalKernel::Avx2: return "avx2";
+		case FractalKernel::Avx512: return "avx512";
+		default: return "scalar";
+		}
+	}
+
+	inline bool fractalKernelSupported(FractalKernel kernel) {
+#ifdef CH01_HAS_X86_FRACTAL_KERNELS
+		switch (kernel) {
+		case FractalKernel::Avx2: return __builtin_cpu_supports("avx2");
+		case FractalKernel::Avx512: return __builtin_cpu_supports("avx512f");
+		default: return true;
+		}
+#else
+		return kernel == FractalKernel::Scalar;
+#endif
+	}
+
+	//widest kernel the cpu runs, checked once
+	inline FractalKernel bestFractalKernel() {
+		static const FractalKernel best =
+			fractalKernelSupported(FractalKernel::Avx512) ? FractalKernel::Avx512 :
+			fractalKernelSupported(FractalKernel::Avx2) ? FractalKernel::Avx2 :
+			FractalKernel::Scalar;
+		return best;
+	}
+
+#ifdef CH01_HAS_X86_FRACTAL_KERNELS
+	//vector kernels follow calcOnePixel operation by operation without fused multiply add,
+	//so escape decisions are the same as in scalar code and only exp is approximated:
+	//exp(v) = 2^n * p(r), v = n * ln2 + r, |r| <= ln2 / 2, p is Taylor polynomial of degree 11
+	//relative error of p is below 1e-14, v is clamped at -708 where result underflows anyway
+	//bound holds against calcOnePixel built with -ffp-contract=off, scalar code may be fused by compiler
+	//with fma in target ( e.g. -march=native ), then its escape iterations and result may differ more
+	namespace fractal_detail {
+		const double Log2E = 1.4426950408889634;
+		const double Ln2Hi = 6.93145751953125e-1;
+		const double Ln2Lo = 1.42860682030941723212e-6;
+		const double MinExponent = -708.0;
+		const double ExpCoefficients[] = {
+			1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880, 1.0 / 40320, 1.0 / 5040, 1.0 / 720,
+			1.0 / 120, 1.0 / 24, 1.0 / 6, 1.0 / 2, 1.0, 1.0
+		};
+		//1.5 * 2^52, adding it leaves integer part of rounded double in low mantissa bits
+		const double RoundMagic = 6755399441055744.0;
+
+		__attribute__((target("avx2"))) CH01_NO_FP_CONTRACT
+		inline __m256d exp4(__m256d v) {
+			v = _mm256_max_pd(v, _mm256_set1_pd(MinExponent));
+			const __m256d n = _mm256_round_pd(_mm256_mul_pd(v, _mm256_set1_pd(Log2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			__m256d r = _mm256_sub_pd(v, _mm256_mul_pd(n, _mm256_set1_pd(Ln2Hi)));
+			r = _mm256_sub_pd(r, _mm256_mul_pd(n, _mm256_set1_pd(Ln2Lo)));
+
+			__m256d p = _mm256_set1_pd(ExpCoefficients[0]);
+			for (size_t i = 1; i < sizeof(ExpCoefficients) / sizeof(ExpCoefficients[0]); ++i)
+				p = _mm256_add_pd(_mm256_mul_pd(p, r), _mm256_set1_pd(ExpCoefficients[i]));
+
+			//2^n built directly in exponent bits
+			const __m256i magic = _mm256_castpd_si256(_mm256_set1_pd(RoundMagic));
+			const __m256i integer = _mm256_sub_epi64(_mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(RoundMagic))), magic);
+			const __m256i exponent = _mm256_slli_epi64(_mm256_add_epi64(integer, _mm256_set1_epi64x(1023)), 52);
+			return _mm256_mul_pd(p, _mm256_castsi256_pd(exponent));
+		}
+
+		__attribute__((target("avx2"))) CH01_NO_FP_CONTRACT
+		inline void calcPixelsAvx2(const Fractal& fractal, int x0, int y0, int count, double* results) {
+			const __m256d fx0 = _mm256_set1_pd(fractal.realPart(x0));
+			const __m256d two = _mm256_set1_pd(2.0);
+			const __m256d four = _mm256_set1_pd(4.0);
+			const __m256d zero = _mm256_setzero_pd();
+
+			for (int lane = 0; lane < count; lane += 4) {
+				alignas(32) double fy0Lanes[4];
+				for (int i = 0; i < 4; ++i)
+					fy0Lanes[i] = fractal.imagPart(y0 + std::min(lane + i, count - 1));
+				const __m256d fy0 = _mm256_load_pd(fy0Lanes);
+
+				__m256d x = zero, y = zero, res = zero;
+				for (int iter = 0; iter < fractal.maxIterations(); ++iter) {
+					const __m256d xx = _mm256_mul_pd(x, x);
+					const __m256d yy = _mm256_mul_pd(y, y);
+					//escaped lanes keep their values, so once outside they stay outside
+					const __m256d active = _mm256_cmp_pd(_mm256_add_pd(xx, yy), four, _CMP_LE_OQ);
+					if (_mm256_testz_pd(active, active))
+						break;
+
+					const __m256d val = _mm256_add_pd(_mm256_sub_pd(xx, yy), fx0);
+					const __m256d newY = _mm256_add_pd(_mm256_mul_pd(_mm256_mul_pd(two, x), y), fy0);
+					x = _mm256_blendv_pd(x, val, active);
+					y = _mm256_blendv_pd(y, newY, active);
+
+					const __m256d distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)));
+					const __m256d term = exp4(_mm256_sub_pd(zero, distance));
+					res = _mm256_add_pd(res, _mm256_and_pd(term, active));
+				}
+
+				alignas(32) double resLanes[4];
+				_mm256_store_pd(resLanes, res);
+				for (int i = 0; i < 4 && lane + i < count; ++i)
+					results[lane + i] = resLanes[i];
+			}
+		}
+
+		//unmasked avx512 intrinsics of gcc 12 headers start from self initialized __Y ( undefined vector ),
+		//after inlining -Wmaybe-uninitialized reports it although every lane is written
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+		__attribute__((target("avx512f"))) CH01_NO_FP_CONTRACT
+		inline __m512d exp8(__m512d v) {
+			v = _mm512_max_pd(v, _mm512_set1_pd(MinExponent));
+			const __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(v, _mm512_set1_pd(Log2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+			__m512d r = _mm512_sub_pd(v, _mm512_mul_pd(n, _mm512_set1_pd(Ln2Hi)));
+			r = _mm512_sub_pd(r, _mm512_mul_pd(n, _mm512_set1_pd(Ln2Lo)));
+
+			__m512d p = _mm512_set1_pd(ExpCoefficients[0]);
+			for (size_t i = 1; i < sizeof(ExpCoefficients) / sizeof(ExpCoefficients[0]); ++i)
+				p = _mm512_add_pd(_mm512_mul_pd(p, r), _mm512_set1_pd(ExpCoefficients[i]));
+
+			return _mm512_scalef_pd(p, n);
+		}
+
+		__attribute__((target("avx512f"))) CH01_NO_FP_CONTRACT
+		inline void calcPixelsAvx512(const Fractal& fractal, int x0, int y0, int count, double* results) {
+			const __m512d fx0 = _mm512_set1_pd(fractal.realPart(x0));
+			const __m512d two = _mm512_set1_pd(2.0);
+			const __m512d four = _mm512_set1_pd(4.0);
+			const __m512d zero = _mm512_setzero_pd();
+
+			for (int lane = 0; lane < count; lane += 8) {
+				alignas(64) double fy0Lanes[8];
+				for (int i = 0; i < 8; ++i)
+					fy0Lanes[i] = fractal.imagPart(y0 + std::min(lane + i, count - 1));
+				const __m512d fy0 = _mm512_load_pd(fy0Lanes);
+
+				__m512d x = zero, y = zero, res = zero;
+				for (int iter = 0; iter < fractal.maxIterations(); ++iter) {
+					const __m512d xx = _mm512_mul_pd(x, x);
+					const __m512d yy = _mm512_mul_pd(y, y);
+					const __mmask8 active = _mm512_cmp_pd_mask(_mm512_add_pd(xx, yy), four, _CMP_LE_OQ);
+					if (!active)
+						break;
+
+					const __m512d val = _mm512_add_pd(_mm512_sub_pd(xx, yy), fx0);
+					const __m512d newY = _mm512_add_pd(_mm512_mul_pd(_mm512_mul_pd(two, x), y), fy0);
+					x = _mm512_mask_mov_pd(x, active, val);
+					y = _mm512_mask_mov_pd(y, active, newY);
+
+					const __m512d distance = _mm512_sqrt_pd(_mm512_add_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y)));
+					res = _mm512_mask_add_pd(res, active, res, exp8(_mm512_sub_pd(zero, distance)));
+				}
+
+				alignas(64) double resLanes[8];
+				_mm512_store_pd(resLanes, res);
+				for (int i = 0; i < 8 && lane + i < count; ++i)
+					results[lane + i] = resLanes[i];
+			}
+		}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+	}
+#endif
+
+	//values of pixels (x0, y0) ... (x0, y0 + count - 1) as calcOnePixel gives them,
+	//vector kernels differ by exp approximation only, unsupported kernel falls back to scalar
+	inline void calcFractalPixels(const Fractal& fractal, int x0, int y0, int count, double* results,
+		FractalKernel kernel = bestFractalKernel()) {
+#ifdef CH01_HAS_X86_FRACTAL_KERNELS
+		if (kernel == FractalKernel::Avx512 && fractalKernelSupported(kernel)) {
+			fractal_detail::calcPixelsAvx512(fractal, x0, y0, count, results);
+			return;
+		}
+		if (kernel == FractalKernel::Avx2 && fractalKernelSupported(kernel)) {
+			fractal_detail::calcPixelsAvx2(fractal, x0, y0, count, results);
+			return;
+		}
+#endif
+		for (int i = 0; i < count; ++i)
+			results[i] = fractal.calcOnePixel(x0, y0 + i);
+	}
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+#include "ch1.h"
+#include "ch2.h"
+#include "tone_curve.h"
+#include "../src/task_graph_utils.h"
+#include <cstring>
+#include <tuple>
+
+namespace ch01 {
+
+	//channels of run of pixels of one row while they pass through fused operators,
+	//indexed like PNGImage offsets, block fits L1 cache so intermediates never reach memory
+	struct PixelBlock {
+		static const int Size = 256;
+		int channels[4][Size];
+	};
+
+	//byte positions of r, g, b, a in 4 byte pixel
+	struct BgraLayout {
+		static constexpr int offsets[4] = { 2, 1, 0, 3 };
+	};
+	struct RgbaLayout {
+		static constexpr int offsets[4] = { 0, 1, 2, 3 };
+	};
+
+	//rows of 4 byte pixels of Image or PNGImage, layout is known at compile time so channel shifts are constants
+	template <typename Layout>
+	struct PixelView {
+		using LayoutType = Layout;
+
+		unsigned char* data = nullptr;
+		int width = 0;
+		int height = 0;
+
+		unsigned char* pixel(int row, int column) const {
+			return data + (static_cast<size_t>(row) * width + column) * 4;
+		}
+
+		//count pixels starting at (row, column) into block channels
+		//pixels are handled as little endian words, so loops vectorize into shifts and masks
+		void load(int row, int column, int count, PixelBlock& block) const {
+			const unsigned char* p = pixel(row, column);
+			for (int i = 0; i < count; ++i) {
+				std::uint32_t word;
+				std::memcpy(&word, p + i * 4, 4);
+				for (int channel = 0; channel < 4; ++channel)
+					block.channels[channel][i] = (word >> (8 * Layout::offsets[channel])) & 0xff;
+			}
+		}
+
+		void store(int row, int column, int count, const PixelBlock& block) const {
+			unsigned char* p = pixel(row, column);
+			for (int i = 0; i < count; ++i) {
+				std::uint32_t word = 0;
+				for (int channel = 0; channel < 4; ++channel)
+					word |= static_cast<std::uint32_t>(block.channels[channel][i]) << (8 * Layout::offsets[channel]);
+				std::memcpy(p + i * 4, &word, 4);
+			}
+		}
+	};
+
+	inline PixelView<BgraLayout> pixelView(Image& image) {
+		return PixelView<BgraLayout>{ image.rows()[0]->bgra, image.width(), image.height() };
+	}
+
+	inline PixelView<RgbaLayout> pixelView(PNGImage& image) {
+		return PixelView<RgbaLayout>{ image.buffer->data(), static_cast<int>(image.width), static_cast<int>(image.height) };
+	}
+
+	//operators change block of pixels in place, they get position of first pixel for operators reading other images
+
+	//same as applyGammaLutToRows through cached tone curve
+	struct GammaOp {
+		std::shared_ptr<const ToneCurve> curve;
+
+		explicit GammaOp(double gamma) : curve(ToneCurve::gamma(gamma)) {}
+
+		void operator()(PixelBlock& block, int count, int, int) const {
+			const std::uint32_t* table = curve->table();
+			int* r = block.channels[PNGImage::redOffset];
+			int* g = block.channels[PNGImage::greenOffset];
+			int* b = block.channels[PNGImage::blueOffset];
+			for (int i = 0; i < count; ++i) {
+				const int level = static_cast<std::uint8_t>(table[ToneCurve::lumaIndex(r[i], g[i], b[i])]);
+				r[i] = g[i] = b[i] = level;
+			}
+		}
+	};
+
+	//same as applyTintToRows
+	struct TintOp {
+		//tints in PNGImage order
+		double tints[3];
+
+		//tints in Image order b, g, r like applyTintToRows
+		explicit TintOp(const double* bgrTints) {
+			tints[PNGImage::blueOffset] = bgrTints[0];
+			tints[PNGImage::greenOffset] = bgrTints[1];
+			tints[PNGImage::redOffset] = bgrTints[2];
+		}
+
+		void operator()(PixelBlock& block, int count, int, int) const {
+			for (int channel = 0; channel < 3; ++channel) {
+				const double tint = tints[channel];
+				int* values = block.channels[channel];
+				for (int i = 0; i < count; ++i)
+					values[i] = static_cast<std::uint8_t>(static_cast<int>(values[i] + (MAX_BGR_VALUE - values[i])*tint));
+			}
+		}
+	};
+
+	//same as increasePNGChannel
+	struct ChannelBoostOp {
+		int channel;
+		int increase;
+
+		void operator()(PixelBlock& block, int count, int, int) const {
+			int* values = block.channels[channel];
+			for (int i = 0; i < count; ++i)
+				values[i] = std::min(values[i] + increase, 255);
+		}
+	};
+
+	//same as mergePNGImages, channel of pixels is taken from source at the same position
+	template <typename View>
+	struct MergeOp {
+		View source;
+		int channel = PNGImage::redOffset;
+
+		void operator()(PixelBlock& block, int count, int row, int column) const {
+			const unsigned char* p = source.pixel(row, column);
+			const int offset = View::LayoutType::offsets[channel];
+			int* values = block.channels[channel];
+			for (int i = 0; i < count; ++i)
+				values[i] = p[i * 4 + offset];
+		}
+	};
+
+	//writes pixels as they are at this point of kernel, only way intermediate images are produced
+	template <typename View>
+	struct MaterializeOp {
+		View target;
+
+		void operator()(PixelBlock& block, int count, int row, int column) const {
+			target.store(row, column, count, block);
+		}
+	};
+
+	//operators applied one after another to each block of row while it is in L1 cache,
+	//so chain of per pixel stages reads input and writes output once
+	template <typename... Ops>
+	class FusedKernel {
+	public:
+		explicit FusedKernel(Ops... ops) : myOps(std::move(ops)...) {}
+
+		//in and out have the same size, they can be the same image
+		template <typename InView, typename OutView>
+		void applyToRows(const InView& in, const OutView& out, int rowBegin, int rowEnd) const {
+			PixelBlock block;
+			for (int row = rowBegin; row < rowEnd; ++row)
+				for (int column = 0; column < in.width; column += PixelBlock::Size) {
+					const int count = std::min(PixelBlock::Size, in.width - column);
+					in.load(row, column, count, block);
+					std::apply([&block, count, row, column](const Ops&... ops) { (ops(block, count, row, column), ...); }, myOps);
+					out.store(row, column, count, block);
+				}
+		}
+
+	private:
+		std::tuple<Ops...> myOps;
+	};
+
+	template <typename... Ops>
+	FusedKernel<Ops...> makeFusedKernel(Ops... ops) {
+		return FusedKernel<Ops...>(std::move(ops)...);
+	}
+
+	//kernel over all rows in chunksCount tasks, one pass and one join for whole chain of operators
+	//returns join task, chained after parent when given, images must live until it is done
+	template <typename Kernel, typename InView, typename OutView>
+	TaskRef applyFusedKernel(TaskGraph& graph, TaskRef& parent, const Kernel& kernel, const InView& in, const OutView& out,
+		unsigned int chunksCount = GetNumberOfCPUs() * 4) {
+		const unsigned int rows = static_cast<unsigned int>(in.height);
+		chunksCount = std::max(1u, std::min(chunksCount, rows));
+
+		return ParallelReduce<int>(graph, parent, chunksCount,
+			[kernel, in, out, rows, chunksCount](unsigned int chunk) {
+				const int begin = static_cast<int>(static_cast<unsigned long long>(rows) * chunk / chunksCount);
+				const int end = static_cast<int>(static_cast<unsigned long long>(rows) * (chunk + 1) / chunksCount);
+				kernel.applyToRows(in, out, begin, end);
+				return 0;
+			},
+			[]() { return 0; });
+	}
+
+	//same chunks without join, returns chunk tasks so next stage ( e.g. writeBmpChunks ) can follow each chunk
+	template <typename Kernel, typename InView, typename OutView>
+	std::vector<TaskRef> applyFusedKernelChunks(TaskGraph& graph, TaskRef& parent, const Kernel& kernel, const InView& in, const OutView& out,
+		unsigned int chunksCount = GetNumberOfCPUs() * 4) {
+		const unsigned int rows = static_cast<unsigned int>(in.height);
+		chunksCount = std::max(1u, std::min(chunksCount, rows));
+
+		return ParallelForChunks<int>(graph, parent, chunksCount,
+			[kernel, in, out, rows, chunksCount](unsigned int chunk) {
+				const int begin = static_cast<int>(static_cast<unsigned long long>(rows) * chunk / chunksCount);
+				const int end = static_cast<int>(static_cast<unsigned long long>(rows) * (chunk + 1) / chunksCount);
+				kernel.applyToRows(in, out, begin, end);
+				return 0;
+			});
+	}
+
+}
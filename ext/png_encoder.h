@@ -0,0 +1,588 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "lodepng.h"
+
+//PNG encoder built from pieces compressed independently, so pieces can be done in parallel
+//every piece is run of filtered scanlines compressed by its own deflate, pieces except the last one
+//end with empty stored block ( sync flush ) so they are byte aligned and concatenate into one deflate stream
+//zlib adler32 of whole stream is combined from adler32 of pieces
+
+enum class PNGCompression {
+	//one match candidate, stops at first match long enough, for throughput sensitive runs
+	Fast,
+	//longer match search
+	Default
+};
+
+namespace png_encoder {
+
+	const int MinMatch = 3;
+	const int MaxMatch = 258;
+	const int WindowSize = 32768;
+	const int HashBits = 15;
+	const size_t SymbolsPerBlock = 1 << 16;
+	const unsigned int AdlerBase = 65521;
+
+	const unsigned short LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const unsigned char LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const unsigned short DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const unsigned char DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+	const unsigned char CodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	inline unsigned int adler32(const unsigned char* data, size_t size, unsigned int adler = 1) {
+		unsigned int s1 = adler & 0xffff, s2 = adler >> 16;
+		while (size > 0) {
+			//5552 bytes keep sums in 32 bits before modulo, same bound as zlib
+			const size_t run = std::min<size_t>(size, 5552);
+			for (size_t i = 0; i < run; ++i) {
+				s1 += data[i];
+				s2 += s1;
+			}
+			s1 %= AdlerBase;
+			s2 %= AdlerBase;
+			data += run;
+			size -= run;
+		}
+		return (s2 << 16) | s1;
+	}
+
+	//adler32 of concatenation from adler32 of both parts and length of second one, as zlib adler32_combine
+	inline unsigned int adler32Combine(unsigned int adler1, unsigned int adler2, size_t size2) {
+		const unsigned int rem = static_cast<unsigned int>(size2 % AdlerBase);
+		unsigned int sum1 = adler1 & 0xffff;
+		unsigned int sum2 = static_cast<unsigned int>((static_cast<unsigned long long>(rem) * sum1) % AdlerBase);
+		sum1 += (adler2 & 0xffff) + AdlerBase - 1;
+		sum2 += (adler1 >> 16) + (adler2 >> 16) + AdlerBase - rem;
+		if (sum1 >= AdlerBase) sum1 -= AdlerBase;
+		if (sum1 >= AdlerBase) sum1 -= AdlerBase;
+		if (sum2 >= (AdlerBase << 1)) sum2 -= (AdlerBase << 1);
+		if (sum2 >= AdlerBase) sum2 -= AdlerBase;
+		return sum1 | (sum2 << 16);
+	}
+
+	//deflate bits go least significant first
+	class BitWriter {
+	public:
+		explicit BitWriter(std::vector<unsigned char>& out) : myOut(out) {}
+
+		void write(unsigned int bits, int count) {
+			myBuffer |= static_cast<unsigned long long>(bits) << myCount;
+			myCount += count;
+			while (myCount >= 8) {
+				myOut.push_back(static_cast<unsigned char>(myBuffer));
+				myBuffer >>= 8;
+				myCount -= 8;
+			}
+		}
+
+		void alignToByte() {
+			if (myCount > 0)
+				write(0, 8 - myCount);
+		}
+
+	private:
+		std::vector<unsigned char>& myOut;
+		unsigned long long myBuffer = 0;
+		int myCount = 0;
+	};
+
+	//canonical Huffman code, codes are stored bit reversed ready for BitWriter
+	struct HuffmanCode {
+		std::vector<unsigned char> lengths;
+		std::vector<unsigned short> codes;
+
+		void buildCodes() {
+			unsigned short countPerLength[16] = {};
+			for (auto length : lengths)
+				++countPerLength[length];
+			countPerLength[0] = 0;
+
+			unsigned short nextCode[16] = {};
+			unsigned short code = 0;
+			for (int bits = 1; bits < 16; ++bits) {
+				code = static_cast<unsigned short>((code + countPerLength[bits - 1]) << 1);
+				nextCode[bits] = code;
+			}
+
+			codes.assign(lengths.size(), 0);
+			for (size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+				const int length = lengths[symbol];
+				if (length == 0)
+					continue;
+				unsigned short value = nextCode[length]++;
+				unsigned short reversed = 0;
+				for (int bit = 0; bit < length; ++bit) {
+					reversed = static_cast<unsigned short>((reversed << 1) | (value & 1));
+					value >>= 1;
+				}
+				codes[symbol] = reversed;
+			}
+		}
+
+		void write(BitWriter& writer, size_t symbol) const {
+			writer.write(codes[symbol], lengths[symbol]);
+		}
+	};
+
+	//Huffman code lengths limited to maxLength, frequencies are halved until tree fits,
+	//at least two symbols get a code so every decoder accepts the tree
+	inline void buildLengths(std::vector<unsigned int> frequencies, int maxLength, std::vector<unsigned char>& lengths) {
+		const size_t symbolsCount = frequencies.size();
+		lengths.assign(symbolsCount, 0);
+
+		size_t used = 0;
+		for (auto frequency : frequencies)
+			used += frequency > 0;
+		for (size_t symbol = 0; used < 2 && symbol < symbolsCount; ++symbol)
+			if (frequencies[symbol] == 0) {
+				frequencies[symbol] = 1;
+				++used;
+			}
+
+		struct Node {
+			unsigned long long weight;
+			int left, right;
+		};
+
+		while (true) {
+			std::vector<Node> nodes;
+			std::vector<int> leaves;
+			for (size_t symbol = 0; symbol < symbolsCount; ++symbol)
+				if (frequencies[symbol] > 0) {
+					leaves.push_back(static_cast<int>(symbol));
+					nodes.push_back(Node{ frequencies[symbol], -1, static_cast<int>(symbol) });
+				}
+
+			//min heap of node indexes
+			auto greater = [&nodes](int a, int b) { return nodes[a].weight > nodes[b].weight; };
+			std::vector<int> heap;
+			for (int node = 0; node < static_cast<int>(nodes.size()); ++node)
+				heap.push_back(node);
+			std::make_heap(heap.begin(), heap.end(), greater);
+
+			while (heap.size() > 1) {
+				std::pop_heap(heap.begin(), heap.end(), greater);
+				const int first = heap.back();
+				heap.pop_back();
+				std::pop_heap(heap.begin(), heap.end(), greater);
+				const int second = heap.back();
+				heap.pop_back();
+
+				nodes.push_back(Node{ nodes[first].weight + nodes[second].weight, first, second });
+				heap.push_back(static_cast<int>(nodes.size()) - 1);
+				std::push_heap(heap.begin(), heap.end(), greater);
+			}
+
+			//depth of leaves, leaf has left == -1 and symbol in right
+			int maxDepth = 0;
+			std::vector<std::pair<int, int>> stack{ { static_cast<int>(nodes.size()) - 1, 0 } };
+			while (!stack.empty()) {
+				const auto [node, depth] = stack.back();
+				stack.pop_back();
+				if (nodes[node].left < 0) {
+					lengths[nodes[node].right] = static_cast<unsigned char>(depth);
+					maxDepth = std::max(maxDepth, depth);
+				}
+				else {
+					stack.push_back({ nodes[node].left, depth + 1 });
+					stack.push_back({ nodes[node].right, depth + 1 });
+				}
+			}
+
+			if (maxDepth <= maxLength)
+				return;
+
+			std::fill(lengths.begin(), lengths.end(), 0);
+			for (auto& frequency : frequencies)
+				if (frequency > 0)
+					frequency = (frequency + 1) / 2;
+		}
+	}
+
+	//literal when distance is 0, match length otherwise
+	struct Symbol {
+		unsigned short value;
+		unsigned short distance;
+	};
+
+	inline int lengthCode(int length) {
+		int code = 0;
+		while (code < 28 && LengthBase[code + 1] <= length)
+			++code;
+		return code;
+	}
+
+	inline int distanceCode(int distance) {
+		int code = 0;
+		while (code < 29 && DistanceBase[code + 1] <= distance)
+			++code;
+		return code;
+	}
+
+	inline void writeSymbols(BitWriter& writer, const std::vector<Symbol>& symbols,
+		const HuffmanCode& literals, const HuffmanCode& distances) {
+		for (const auto& symbol : symbols) {
+			if (symbol.distance == 0) {
+				literals.write(writer, symbol.value);
+				continue;
+			}
+			const int length = lengthCode(symbol.value);
+			literals.write(writer, 257 + length);
+			writer.write(symbol.value - LengthBase[length], LengthExtra[length]);
+			const int distance = distanceCode(symbol.distance);
+			distances.write(writer, distance);
+			writer.write(symbol.distance - DistanceBase[distance], DistanceExtra[distance]);
+		}
+		literals.write(writer, 256);
+	}
+
+	inline const std::pair<HuffmanCode, HuffmanCode>& fixedCodes() {
+		static const auto codes = []() {
+			std::pair<HuffmanCode, HuffmanCode> fixed;
+			fixed.first.lengths.assign(288, 8);
+			std::fill(fixed.first.lengths.begin() + 144, fixed.first.lengths.begin() + 256, 9);
+			std::fill(fixed.first.lengths.begin() + 256, fixed.first.lengths.begin() + 280, 7);
+			fixed.second.lengths.assign(30, 5);
+			fixed.first.buildCodes();
+			fixed.second.buildCodes();
+			return fixed;
+		}();
+		return codes;
+	}
+
+	//block with dynamic Huffman codes or fixed ones, whichever takes less bits, as zlib does
+	inline void writeBlock(BitWriter& writer, const std::vector<Symbol>& symbols, bool final) {
+		std::vector<unsigned int> literalFrequencies(286, 0), distanceFrequencies(30, 0);
+		for (const auto& symbol : symbols) {
+			if (symbol.distance == 0)
+				++literalFrequencies[symbol.value];
+			else {
+				++literalFrequencies[257 + lengthCode(symbol.value)];
+				++distanceFrequencies[distanceCode(symbol.distance)];
+			}
+		}
+		literalFrequencies[256] = 1;
+
+		HuffmanCode literals, distances;
+		buildLengths(literalFrequencies, 15, literals.lengths);
+		buildLengths(distanceFrequencies, 15, distances.lengths);
+
+		int literalsCount = 286, distancesCount = 30;
+		while (literalsCount > 257 && literals.lengths[literalsCount - 1] == 0)
+			--literalsCount;
+		while (distancesCount > 1 && distances.lengths[distancesCount - 1] == 0)
+			--distancesCount;
+
+		//code lengths of both trees run length encoded with codes 16 ( repeat previous ), 17 and 18 ( repeat zero )
+		std::vector<unsigned char> allLengths(literals.lengths.begin(), literals.lengths.begin() + literalsCount);
+		allLengths.insert(allLengths.end(), distances.lengths.begin(), distances.lengths.begin() + distancesCount);
+
+		std::vector<std::pair<unsigned char, unsigned char>> runs;
+		for (size_t i = 0; i < allLengths.size();) {
+			const unsigned char length = allLengths[i];
+			size_t run = 1;
+			while (i + run < allLengths.size() && allLengths[i + run] == length)
+				++run;
+
+			size_t left = run;
+			if (length == 0) {
+				while (left >= 11) {
+					const size_t count = std::min<size_t>(left, 138);
+					runs.push_back({ 18, static_cast<unsigned char>(count - 11) });
+					left -= count;
+				}
+				if (left >= 3) {
+					runs.push_back({ 17, static_cast<unsigned char>(left - 3) });
+					left = 0;
+				}
+			}
+			else {
+				runs.push_back({ length, 0 });
+				--left;
+				while (left >= 3) {
+					const size_t count = std::min<size_t>(left, 6);
+					runs.push_back({ 16, static_cast<unsigned char>(count - 3) });
+					left -= count;
+				}
+			}
+			for (; left > 0; --left)
+				runs.push_back({ length, 0 });
+			i += run;
+		}
+
+		std::vector<unsigned int> codeLengthFrequencies(19, 0);
+		for (const auto& run : runs)
+			++codeLengthFrequencies[run.first];
+		HuffmanCode codeLengths;
+		buildLengths(codeLengthFrequencies, 7, codeLengths.lengths);
+
+		int codeLengthsCount = 19;
+		while (codeLengthsCount > 4 && codeLengths.lengths[CodeLengthOrder[codeLengthsCount - 1]] == 0)
+			--codeLengthsCount;
+
+		//extra bits of lengths and distances are the same for both kinds of block, they are not counted
+		const auto& fixed = fixedCodes();
+		size_t dynamicBits = 5 + 5 + 4 + 3 * static_cast<size_t>(codeLengthsCount);
+		size_t fixedBits = 0;
+		for (const auto& run : runs)
+			dynamicBits += codeLengths.lengths[run.first] + (run.first == 16 ? 2 : run.first == 17 ? 3 : run.first == 18 ? 7 : 0);
+		for (size_t symbol = 0; symbol < literalFrequencies.size(); ++symbol) {
+			dynamicBits += static_cast<size_t>(literalFrequencies[symbol]) * literals.lengths[symbol];
+			fixedBits += static_cast<size_t>(literalFrequencies[symbol]) * fixed.first.lengths[symbol];
+		}
+		for (size_t symbol = 0; symbol < distanceFrequencies.size(); ++symbol) {
+			dynamicBits += static_cast<size_t>(distanceFrequencies[symbol]) * distances.lengths[symbol];
+			fixedBits += static_cast<size_t>(distanceFrequencies[symbol]) * fixed.second.lengths[symbol];
+		}
+
+		writer.write(final ? 1 : 0, 1);
+		if (fixedBits <= dynamicBits) {
+			writer.write(1, 2);
+			writeSymbols(writer, symbols, fixed.first, fixed.second);
+			return;
+		}
+
+		literals.buildCodes();
+		distances.buildCodes();
+		codeLengths.buildCodes();
+
+		writer.write(2, 2);
+		writer.write(literalsCount - 257, 5);
+		writer.write(distancesCount - 1, 5);
+		writer.write(codeLengthsCount - 4, 4);
+		for (int i = 0; i < codeLengthsCount; ++i)
+			writer.write(codeLengths.lengths[CodeLengthOrder[i]], 3);
+
+		for (const auto& run : runs) {
+			codeLengths.write(writer, run.first);
+			if (run.first == 16)
+				writer.write(run.second, 2);
+			else if (run.first == 17)
+				writer.write(run.second, 3);
+			else if (run.first == 18)
+				writer.write(run.second, 7);
+		}
+
+		writeSymbols(writer, symbols, literals, distances);
+	}
+
+	//raw deflate of one piece appended to out, last piece ends stream, other pieces end with sync flush
+	inline void deflatePiece(const unsigned char* data, size_t size, bool last, PNGCompression compression,
+		std::vector<unsigned char>& out) {
+		BitWriter writer(out);
+		const int maxChain = compression == PNGCompression::Fast ? 1 : 32;
+		const int niceLength = compression == PNGCompression::Fast ? 32 : MaxMatch;
+
+		std::vector<int> head(1 << HashBits, -1);
+		std::vector<int> previous(WindowSize, -1);
+		auto hash = [data](size_t position) {
+			const unsigned int value = data[position] | (data[position + 1] << 8) | (data[position + 2] << 16);
+			return (value * 2654435761u) >> (32 - HashBits);
+		};
+		auto insert = [&](size_t position) {
+			if (position + MinMatch > size)
+				return;
+			const unsigned int key = hash(position);
+			previous[position % WindowSize] = head[key];
+			head[key] = static_cast<int>(position);
+		};
+
+		std::vector<Symbol> symbols;
+		symbols.reserve(SymbolsPerBlock);
+		auto flushBlock = [&](bool final) {
+			writeBlock(writer, symbols, final);
+			symbols.clear();
+		};
+
+		size_t position = 0;
+		while (position < size) {
+			int bestLength = 0, bestDistance = 0;
+			if (position + MinMatch <= size) {
+				const size_t maxLength = std::min<size_t>(MaxMatch, size - position);
+				int candidate = head[hash(position)];
+				for (int chain = 0; chain < maxChain && candidate >= 0; ++chain) {
+					const size_t distance = position - candidate;
+					if (distance > WindowSize - 1)
+						break;
+					size_t length = 0;
+					while (length < maxLength && data[candidate + length] == data[position + length])
+						++length;
+					if (static_cast<int>(length) > bestLength) {
+						bestLength = static_cast<int>(length);
+						bestDistance = static_cast<int>(distance);
+						if (bestLength >= niceLength)
+							break;
+					}
+					const int next = previous[candidate % WindowSize];
+					if (next >= candidate)
+						break;
+					candidate = next;
+				}
+			}
+
+			if (bestLength >= MinMatch) {
+				symbols.push_back(Symbol{ static_cast<unsigned short>(bestLength), static_cast<unsigned short>(bestDistance) });
+				for (int i = 0; i < bestLength; ++i)
+					insert(position + i);
+				position += bestLength;
+			}
+			else {
+				symbols.push_back(Symbol{ data[position], 0 });
+				insert(position);
+				++position;
+			}
+
+			if (symbols.size() >= SymbolsPerBlock)
+				flushBlock(false);
+		}
+
+		flushBlock(last);
+		if (!last) {
+			//empty stored block aligns piece to byte without ending stream
+			writer.write(0, 3);
+			writer.alignToByte();
+			writer.write(0x0000, 16);
+			writer.write(0xffff, 16);
+		}
+		writer.alignToByte();
+	}
+
+	inline int paeth(int a, int b, int c) {
+		const int p = a + b - c;
+		const int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+		if (pa <= pb && pa <= pc)
+			return a;
+		return pb <= pc ? b : c;
+	}
+
+	//filtered scanlines of rows [rowBegin, rowEnd) of RGBA image appended to out, filter byte first
+	//filter of every row is the one with minimal sum of absolute values like lodepng default
+	inline void filterRows(const unsigned char* rgba, unsigned int width, unsigned int rowBegin, unsigned int rowEnd,
+		std::vector<unsigned char>& out) {
+		const size_t stride = static_cast<size_t>(width) * 4;
+		std::vector<unsigned char> candidates[5];
+		for (auto& candidate : candidates)
+			candidate.resize(stride);
+
+		for (unsigned int row = rowBegin; row < rowEnd; ++row) {
+			const unsigned char* line = rgba + stride * row;
+			const unsigned char* above = row > 0 ? line - stride : nullptr;
+
+			for (size_t i = 0; i < stride; ++i) {
+				const int a = i >= 4 ? line[i - 4] : 0;
+				const int b = above ? above[i] : 0;
+				const int c = above && i >= 4 ? above[i - 4] : 0;
+				candidates[0][i] = line[i];
+				candidates[1][i] = static_cast<unsigned char>(line[i] - a);
+				candidates[2][i] = static_cast<unsigned char>(line[i] - b);
+				candidates[3][i] = static_cast<unsigned char>(line[i] - ((a + b) >> 1));
+				candidates[4][i] = static_cast<unsigned char>(line[i] - paeth(a, b, c));
+			}
+
+			int bestFilter = 0;
+			size_t bestSum = ~size_t(0);
+			for (int filter = 0; filter < 5; ++filter) {
+				size_t sum = 0;
+				for (size_t i = 0; i < stride; ++i)
+					sum += std::abs(static_cast<signed char>(candidates[filter][i]));
+				if (sum < bestSum) {
+					bestSum = sum;
+					bestFilter = filter;
+				}
+			}
+
+			out.push_back(static_cast<unsigned char>(bestFilter));
+			out.insert(out.end(), candidates[bestFilter].begin(), candidates[bestFilter].end());
+		}
+	}
+
+	//compressed rows of one piece
+	struct Piece {
+		std::vector<unsigned char> deflated;
+		unsigned int adler = 1;
+		size_t filteredSize = 0;
+	};
+
+	inline void encodePiece(const unsigned char* rgba, unsigned int width, unsigned int rowBegin, unsigned int rowEnd,
+		bool last, PNGCompression compression, Piece& piece) {
+		std::vector<unsigned char> filtered;
+		filtered.reserve((static_cast<size_t>(width) * 4 + 1) * (rowEnd - rowBegin));
+		filterRows(rgba, width, rowBegin, rowEnd, filtered);
+
+		piece.deflated.clear();
+		deflatePiece(filtered.data(), filtered.size(), last, compression, piece.deflated);
+		piece.adler = adler32(filtered.data(), filtered.size());
+		piece.filteredSize = filtered.size();
+	}
+
+	inline void appendChunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, size_t size) {
+		const size_t start = out.size();
+		const unsigned char header[8] = {
+			static_cast<unsigned char>(size >> 24), static_cast<unsigned char>(size >> 16),
+			static_cast<unsigned char>(size >> 8), static_cast<unsigned char>(size),
+			static_cast<unsigned char>(type[0]), static_cast<unsigned char>(type[1]),
+			static_cast<unsigned char>(type[2]), static_cast<unsigned char>(type[3]) };
+		out.insert(out.end(), header, header + 8);
+		if (size > 0)
+			out.insert(out.end(), data, data + size);
+
+		//crc covers type and data
+		const unsigned int crc = lodepng_crc32(out.data() + start + 4, size + 4);
+		for (int shift = 24; shift >= 0; shift -= 8)
+			out.push_back(static_cast<unsigned char>(crc >> shift));
+	}
+
+	//8 bit RGBA PNG with single IDAT made of pieces in order of rows
+	inline void assemblePNG(unsigned int width, unsigned int height, const std::vector<Piece>& pieces,
+		PNGCompression compression, std::vector<unsigned char>& out) {
+		static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+		out.assign(signature, signature + 8);
+
+		const unsigned char header[13] = {
+			static_cast<unsigned char>(width >> 24), static_cast<unsigned char>(width >> 16),
+			static_cast<unsigned char>(width >> 8), static_cast<unsigned char>(width),
+			static_cast<unsigned char>(height >> 24), static_cast<unsigned char>(height >> 16),
+			static_cast<unsigned char>(height >> 8), static_cast<unsigned char>(height),
+			8, 6, 0, 0, 0 };
+		appendChunk(out, "IHDR", header, sizeof(header));
+
+		//zlib header, 32K window, level hint
+		std::vector<unsigned char> zlib{ 0x78, static_cast<unsigned char>(compression == PNGCompression::Fast ? 0x01 : 0x9c) };
+		unsigned int adler = 1;
+		for (const auto& piece : pieces) {
+			zlib.insert(zlib.end(), piece.deflated.begin(), piece.deflated.end());
+			adler = adler32Combine(adler, piece.adler, piece.filteredSize);
+		}
+		for (int shift = 24; shift >= 0; shift -= 8)
+			zlib.push_back(static_cast<unsigned char>(adler >> shift));
+
+		appendChunk(out, "IDAT", zlib.data(), zlib.size());
+		appendChunk(out, "IEND", nullptr, 0);
+	}
+
+	//rows of piece out of piecesCount
+	inline std::pair<unsigned int, unsigned int> pieceRows(unsigned int height, unsigned int piece, unsigned int piecesCount) {
+		return { static_cast<unsigned int>(static_cast<unsigned long long>(height) * piece / piecesCount),
+			static_cast<unsigned int>(static_cast<unsigned long long>(height) * (piece + 1) / piecesCount) };
+	}
+}
+
+//whole PNG on calling thread, pieces are encoded one after another
+inline void encodePNGPieces(const unsigned char* rgba, unsigned int width, unsigned int height, unsigned int piecesCount,
+	PNGCompression compression, std::vector<unsigned char>& out) {
+	piecesCount = std::max(1u, std::min(piecesCount, std::max(1u, height)));
+	std::vector<png_encoder::Piece> pieces(piecesCount);
+	for (unsigned int piece = 0; piece < piecesCount; ++piece) {
+		const auto rows = png_encoder::pieceRows(height, piece, piecesCount);
+		png_encoder::encodePiece(rgba, width, rows.first, rows.second, piece + 1 == piecesCount, compression, pieces[piece]);
+	}
+	png_encoder::assemblePNG(width, height, pieces, compression, out);
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PNG_HAS_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+//byte kernels of PNGImage stages over runs of 4 byte RGBA pixels
+//rows of PNGImage are contiguous, so range of rows is one run
+
+inline void addToChannelScalar(unsigned char* pixels, size_t count, int channel_offset, int increase) {
+	for (size_t i = 0; i < count; ++i) {
+		unsigned char& value = pixels[i * 4 + channel_offset];
+		value = static_cast<unsigned char>(std::min(value + increase, 255));
+	}
+}
+
+inline void copyChannelScalar(unsigned char* target, const unsigned char* source, size_t count, int channel_offset) {
+	for (size_t i = 0; i < count; ++i) {
+		target[i * 4 + channel_offset] = source[i * 4 + channel_offset];
+	}
+}
+
+#ifdef PNG_HAS_X86_KERNELS
+//32 bytes are 8 pixels, channel is selected by byte mask repeated every 4 bytes
+//returns pixels done, rest is left for scalar loop
+
+__attribute__((target("avx2")))
+inline size_t addToChannelAvx2(unsigned char* pixels, size_t count, int channel_offset, int increase) {
+	const __m256i add = _mm256_set1_epi32(static_cast<int>(static_cast<unsigned int>(increase) << (8 * channel_offset)));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i* p = reinterpret_cast<__m256i*>(pixels + i * 4);
+		_mm256_storeu_si256(p, _mm256_adds_epu8(_mm256_loadu_si256(p), add));
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+inline size_t copyChannelAvx2(unsigned char* target, const unsigned char* source, size_t count, int channel_offset) {
+	const __m256i mask = _mm256_set1_epi32(static_cast<int>(0xffu << (8 * channel_offset)));
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i* t = reinterpret_cast<__m256i*>(target + i * 4);
+		const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+		_mm256_storeu_si256(t, _mm256_blendv_epi8(_mm256_loadu_si256(t), s, mask));
+	}
+	return i;
+}
+
+inline bool pngKernelsUseAvx2() {
+	static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+	return hasAvx2;
+}
+#endif
+
+//same as min(value + increase, 255) on one channel of count pixels
+//vector path is saturating byte add, it matches only for increase in range 0 - 255
+inline void addToChannel(unsigned char* pixels, size_t count, int channel_offset, int increase) {
+	size_t done = 0;
+#ifdef PNG_HAS_X86_KERNELS
+	if (increase >= 0 && increase <= 255 && pngKernelsUseAvx2())
+		done = addToChannelAvx2(pixels, count, channel_offset, increase);
+#endif
+	addToChannelScalar(pixels + done * 4, count - done, channel_offset, increase);
+}
+
+//one channel of count pixels taken from source, other channels are kept
+inline void copyChannel(unsigned char* target, const unsigned char* source, size_t count, int channel_offset) {
+	size_t done = 0;
+#ifdef PNG_HAS_X86_KERNELS
+	if (pngKernelsUseAvx2())
+		done = copyChannelAvx2(target, source, count, channel_offset);
+#endif
+	copyChannelScalar(target + done * 4, source + done * 4, count - done, channel_offset);
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "ch1.h"
+#include <map>
+#include <mutex>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CH01_HAS_X86_TONE_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace ch01 {
+
+	//grayscale tone curve applied through lookup table, no floating point per pixel
+	//luma is 0.3 r + 0.59 g + 0.11 b in fixed point with LumaFractionBits fraction bits,
+	//table holds ready grayscale pixels for every luma value
+	class ToneCurve {
+	public:
+		static const int LumaFractionBits = 4;
+		static const int TableSize = (MAX_BGR_VALUE << LumaFractionBits) + 1;
+
+		//curve maps luma in range 0 - 255 to output, output is clamped to 255
+		template <typename F>
+		explicit ToneCurve(F curve) : myTable(TableSize) {
+			for (int i = 0; i < TableSize; ++i) {
+				double res = curve(double(i) / (1 << LumaFractionBits));
+				if (res > MAX_BGR_VALUE) res = MAX_BGR_VALUE;
+				if (res < 0) res = 0;
+				myTable[i] = Image::Pixel(res, res, res).value;
+			}
+		}
+
+		//tables are built once per gamma and shared by all callers
+		static std::shared_ptr<const ToneCurve> gamma(double gamma) {
+			static std::mutex mutex;
+			static std::map<double, std::shared_ptr<const ToneCurve>> curves;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			auto& curve = curves[gamma];
+			if (!curve)
+				curve = std::make_shared<const ToneCurve>([gamma](double v) { return pow(v, gamma); });
+			return curve;
+		}
+
+		//weights sum to 1 << 16, rounding keeps luma within table
+		static std::uint32_t lumaIndex(std::uint32_t r, std::uint32_t g, std::uint32_t b) {
+			const std::uint32_t sum = 19661u * r + 38666u * g + 7209u * b;
+			return (sum + (1u << (15 - LumaFractionBits))) >> (16 - LumaFractionBits);
+		}
+		static std::uint32_t lumaIndex(const Image::Pixel& p) {
+			return lumaIndex(p.bgra[2], p.bgra[1], p.bgra[0]);
+		}
+
+		const std::uint32_t* table() const { return myTable.data(); }
+		//grayscale level for luma index
+		std::uint8_t level(std::uint32_t index) const { return std::uint8_t(myTable[index]); }
+
+		void applyToRow(const Image::Pixel* in, Image::Pixel* out, int width) const {
+			int done = 0;
+#ifdef CH01_HAS_X86_TONE_KERNELS
+			static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+			if (hasAvx2)
+				done = applyToRowAvx2(in, out, width);
+#endif
+			for (int i = done; i < width; ++i)
+				out[i].value = myTable[lumaIndex(in[i])];
+		}
+
+	private:
+#ifdef CH01_HAS_X86_TONE_KERNELS
+		//eight pixels per step, luma from 16 bit products, pixels gathered from table
+		//returns number of pixels done, rest is left for scalar loop
+		__attribute__((target("avx2")))
+		int applyToRowAvx2(const Image::Pixel* in, Image::Pixel* out, int width) const {
+			const __m256i byteMask = _mm256_set1_epi32(0xff);
+			const __m256i weightB = _mm256_set1_epi32(7209);
+			const __m256i weightG = _mm256_set1_epi32(38666);
+			const __m256i weightR = _mm256_set1_epi32(19661);
+			const __m256i rounding = _mm256_set1_epi32(1 << (15 - LumaFractionBits));
+			const int* table = reinterpret_cast<const int*>(myTable.data());
+
+			int i = 0;
+			for (; i + 8 <= width; i += 8) {
+				const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+				const __m256i b = _mm256_and_si256(pixels, byteMask);
+				const __m256i g = _mm256_and_si256(_mm256_srli_epi32(pixels, 8), byteMask);
+				const __m256i r = _mm256_and_si256(_mm256_srli_epi32(pixels, 16), byteMask);
+
+				__m256i sum = _mm256_mullo_epi32(r, weightR);
+				sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(g, weightG));
+				sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(b, weightB));
+				const __m256i index = _mm256_srli_epi32(_mm256_add_epi32(sum, rounding), 16 - LumaFractionBits);
+
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_i32gather_epi32(table, index, 4));
+			}
+			return i;
+		}
+#endif
+
+		std::vector<std::uint32_t> myTable;
+	};
+
+	//rows [rowBegin, rowEnd) through tone curve, images have the same size
+	inline void applyToneCurveToRows(const ToneCurve& curve, Image& in, Image& out, int rowBegin, int rowEnd) {
+		const int width = in.width();
+		for (int row = rowBegin; row < rowEnd; ++row)
+			curve.applyToRow(in.rows()[row], out.rows()[row], width);
+	}
+
+	//same as applyGammaToRows within quantization of luma, pow is evaluated only when table is built
+	inline void applyGammaLutToRows(Image& in, Image& out, double gamma, int rowBegin, int rowEnd) {
+		applyToneCurveToRows(*ToneCurve::gamma(gamma), in, out, rowBegin, rowEnd);
+	}
+
+}
@@ -0,0 +1,703 @@
+#pragma once
+#include "task_graph.h"
+#include "task_items.h"
+#include <deque>
+#include <map>
+#include <tuple>
+
+//message without data, used to signal events ( e.g. limiter decrement )
+struct ContinueMsg
+{
+};
+
+//standing graph, node bodies are executed by TaskGraph workers as messages arrive
+class FlowGraph
+{
+	TaskGraph _graph;
+	std::thread _coordinatorThread;
+
+	std::mutex _mutexActive;
+	std::condition_variable _cvActive;
+	size_t _activeTasks{ 0 };
+
+public:
+	explicit FlowGraph(unsigned int numThreads = GetNumberOfCPUs()) :
+		_graph(numThreads)
+	{
+		_graph.Retain();
+		_coordinatorThread = std::thread([this]()
+		{
+			_graph.WaitAll();
+		});
+	}
+
+	FlowGraph(const FlowGraph&) = delete;
+	FlowGraph& operator=(const FlowGraph&) = delete;
+
+	~FlowGraph()
+	{
+		WaitForAll();
+
+		_graph.Release();
+		_coordinatorThread.join();
+	}
+
+	//run body on a worker
+	void Spawn(std::function<void()> body)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutexActive);
+			++_activeTasks;
+		}
+
+		_graph.SpawnTask(InitialTaskNode<void>::create([this, body]()
+		{
+			body();
+			TaskDone();
+		}));
+	}
+
+	//wait till no node body is running, messages kept in buffers stay there
+	void WaitForAll()
+	{
+		std::unique_lock<std::mutex> lock(_mutexActive);
+		_cvActive.wait(lock, [&]() { return _activeTasks == 0; });
+	}
+
+private:
+	void TaskDone()
+	{
+		bool idle = false;
+		{
+			std::unique_lock<std::mutex> lock(_mutexActive);
+			idle = --_activeTasks == 0;
+		}
+
+		if (idle)
+		{
+			_cvActive.notify_all();
+		}
+	}
+};
+
+template<typename T>
+class FlowSender;
+
+template<typename T>
+class FlowReceiver
+{
+	std::mutex _mutexPredecessors;
+	std::vector<FlowSender<T>*> _predecessors;
+
+public:
+	virtual ~FlowReceiver() = default;
+
+	//returns false when message is rejected, sender keeps it if it buffers messages
+	virtual bool TryPut(const T& message) = 0;
+
+	void AddPredecessor(FlowSender<T>& sender)
+	{
+		std::unique_lock<std::mutex> lock(_mutexPredecessors);
+		_predecessors.push_back(&sender);
+	}
+
+protected:
+	//pull one message from buffering predecessors after rejecting some
+	bool TryGetFromPredecessors(T& message)
+	{
+		std::vector<FlowSender<T>*> predecessors;
+		{
+			std::unique_lock<std::mutex> lock(_mutexPredecessors);
+			predecessors = _predecessors;
+		}
+
+		for (auto predecessor : predecessors)
+		{
+			if (predecessor->TryGet(message))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+};
+
+template<typename T>
+class FlowSender
+{
+	std::mutex _mutexSuccessors;
+	std::vector<FlowReceiver<T>*> _successors;
+
+public:
+	virtual ~FlowSender() = default;
+
+	void AddSuccessor(FlowReceiver<T>& receiver)
+	{
+		std::unique_lock<std::mutex> lock(_mutexSuccessors);
+		_successors.push_back(&receiver);
+	}
+
+	//take buffered message, only buffering nodes have some
+	virtual bool TryGet(T&)
+	{
+		return false;
+	}
+
+protected:
+	//offer message to all successors, returns true if any accepted it
+	bool Broadcast(const T& message)
+	{
+		bool accepted = false;
+		for (auto successor : GetSuccessors())
+		{
+			accepted = successor->TryPut(message) || accepted;
+		}
+		return accepted;
+	}
+
+	//offer message to successors till first accepts it
+	bool PutToOne(const T& message)
+	{
+		for (auto successor : GetSuccessors())
+		{
+			if (successor->TryPut(message))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	std::vector<FlowReceiver<T>*> GetSuccessors()
+	{
+		std::unique_lock<std::mutex> lock(_mutexSuccessors);
+		return _successors;
+	}
+};
+
+template<typename T>
+void MakeEdge(FlowSender<T>& sender, FlowReceiver<T>& receiver)
+{
+	sender.AddSuccessor(receiver);
+	receiver.AddPredecessor(sender);
+}
+
+const size_t UnlimitedConcurrency = 0;
+
+enum class FlowPolicy
+{
+	//queue messages above concurrency limit
+	Queueing,
+	//reject messages above concurrency limit, pull them from predecessors later
+	Rejecting
+};
+
+//runs body for every message on workers, at most concurrency bodies at once
+template<typename InputType, typename OutputType>
+class FunctionNode :
+	public FlowReceiver<InputType>,
+	public FlowSender<OutputType>
+{
+	using NodeCallable = std::function<OutputType(const InputType&)>;
+
+	FlowGraph& _flowGraph;
+	size_t _concurrency;
+	FlowPolicy _policy;
+	NodeCallable _callable;
+
+	std::mutex _mutex;
+	size_t _running{ 0 };
+	std::deque<InputType> _queue;
+
+public:
+	FunctionNode(FlowGraph& flowGraph, size_t concurrency, NodeCallable callable, FlowPolicy policy = FlowPolicy::Queueing) :
+		_flowGraph(flowGraph),
+		_concurrency(concurrency),
+		_policy(policy),
+		_callable(std::move(callable))
+	{
+	}
+
+	FunctionNode(const FunctionNode&) = delete;
+	FunctionNode& operator=(const FunctionNode&) = delete;
+
+	bool TryPut(const InputType& message) override
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if (_concurrency != UnlimitedConcurrency && _running >= _concurrency)
+			{
+				if (_policy == FlowPolicy::Rejecting)
+				{
+					return false;
+				}
+				_queue.push_back(message);
+				return true;
+			}
+			++_running;
+		}
+
+		SpawnBody(message);
+		return true;
+	}
+
+private:
+	void SpawnBody(InputType message)
+	{
+		_flowGraph.Spawn([this, message]()
+		{
+			this->Broadcast(_callable(message));
+			BodyDone();
+		});
+	}
+
+	void BodyDone()
+	{
+		InputType message;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if (!_queue.empty())
+			{
+				message = std::move(_queue.front());
+				_queue.pop_front();
+			}
+			else if (_policy == FlowPolicy::Queueing)
+			{
+				--_running;
+				return;
+			}
+			else
+			{
+				//rejecting node asks predecessors for message it may have rejected
+				--_running;
+				lock.unlock();
+
+				if (!this->TryGetFromPredecessors(message))
+				{
+					return;
+				}
+				if (!TryPut(message))
+				{
+					//taken message has to be processed, queue it
+					lock.lock();
+					_queue.push_back(std::move(message));
+				}
+				return;
+			}
+		}
+
+		SpawnBody(std::move(message));
+	}
+};
+
+//forwards every message to all successors
+template<typename T>
+class BroadcastNode :
+	public FlowReceiver<T>,
+	public FlowSender<T>
+{
+public:
+	explicit BroadcastNode(FlowGraph&)
+	{
+	}
+
+	bool TryPut(const T& message) override
+	{
+		this->Broadcast(message);
+		return true;
+	}
+};
+
+//keeps messages no successor accepted, successors pull them later
+template<typename T>
+class BufferNode :
+	public FlowReceiver<T>,
+	public FlowSender<T>
+{
+	//held while forwarding, successor pulling meanwhile waits till rejected message is buffered
+	std::recursive_mutex _mutex;
+	std::deque<T> _buffer;
+
+public:
+	explicit BufferNode(FlowGraph&)
+	{
+	}
+
+	bool TryPut(const T& message) override
+	{
+		std::unique_lock<std::recursive_mutex> lock(_mutex);
+
+		//keep order, older messages wait already
+		if (!_buffer.empty() || !this->PutToOne(message))
+		{
+			_buffer.push_back(message);
+		}
+		return true;
+	}
+
+	bool TryGet(T& message) override
+	{
+		std::unique_lock<std::recursive_mutex> lock(_mutex);
+		if (_buffer.empty())
+		{
+			return false;
+		}
+		message = std::move(_buffer.front());
+		_buffer.pop_front();
+		return true;
+	}
+
+	size_t Size()
+	{
+		std::unique_lock<std::recursive_mutex> lock(_mutex);
+		return _buffer.size();
+	}
+};
+
+//reorders messages by sequence number starting at 0
+template<typename T>
+class SequencerNode :
+	public FlowReceiver<T>,
+	public FlowSender<T>
+{
+	using SequencerCallable = std::function<size_t(const T&)>;
+
+	SequencerCallable _sequencer;
+
+	//held while forwarding, same as in BufferNode
+	std::recursive_mutex _mutex;
+	size_t _nextSequence{ 0 };
+	std::map<size_t, T> _buffer;
+
+public:
+	SequencerNode(FlowGraph&, SequencerCallable sequencer) :
+		_sequencer(std::move(sequencer))
+	{
+	}
+
+	bool TryPut(const T& message) override
+	{
+		std::unique_lock<std::recursive_mutex> lock(_mutex);
+		_buffer.emplace(_sequencer(message), message);
+
+		ForwardInOrder();
+		return true;
+	}
+
+	bool TryGet(T& message) override
+	{
+		std::unique_lock<std::recursive_mutex> lock(_mutex);
+		auto it = _buffer.find(_nextSequence);
+		if (it == _buffer.end())
+		{
+			return false;
+		}
+		message = std::move(it->second);
+		_buffer.erase(it);
+		++_nextSequence;
+		return true;
+	}
+
+private:
+	//locked from outside
+	void ForwardInOrder()
+	{
+		while (true)
+		{
+			auto it = _buffer.find(_nextSequence);
+			if (it == _buffer.end() || !this->PutToOne(it->second))
+			{
+				//stays buffered till successor pulls it
+				return;
+			}
+
+			_buffer.erase(it);
+			++_nextSequence;
+		}
+	}
+};
+
+//passes at most threshold messages, each decrement lets one more through
+template<typename T>
+class LimiterNode :
+	public FlowReceiver<T>,
+	public FlowSender<T>
+{
+	class DecrementReceiver : public FlowReceiver<ContinueMsg>
+	{
+		LimiterNode& _limiter;
+	public:
+		explicit DecrementReceiver(LimiterNode& limiter) :
+			_limiter(limiter)
+		{
+		}
+
+		bool TryPut(const ContinueMsg&) override
+		{
+			_limiter.Decrement();
+			return true;
+		}
+	};
+
+	size_t _threshold;
+	std::mutex _mutex;
+	size_t _count{ 0 };
+	size_t _rejections{ 0 };
+	DecrementReceiver _decrement;
+
+public:
+	LimiterNode(FlowGraph&, size_t threshold) :
+		_threshold(threshold),
+		_decrement(*this)
+	{
+	}
+
+	bool TryPut(const T& message) override
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if (_count >= _threshold)
+			{
+				++_rejections;
+				return false;
+			}
+			++_count;
+		}
+
+		if (!this->Broadcast(message))
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			--_count;
+			return false;
+		}
+		return true;
+	}
+
+	FlowReceiver<ContinueMsg>& DecrementPort()
+	{
+		return _decrement;
+	}
+
+private:
+	//successors are expected to accept pulled messages ( e.g. queueing function nodes )
+	void Decrement()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (_count > 0)
+		{
+			--_count;
+		}
+
+		while (_count < _threshold)
+		{
+			//reserve slot and pull message rejected before
+			const size_t rejections = _rejections;
+			++_count;
+			lock.unlock();
+
+			T message;
+			if (this->TryGetFromPredecessors(message) && this->Broadcast(message))
+			{
+				return;
+			}
+
+			lock.lock();
+			--_count;
+
+			//retry only if something was rejected while slot was reserved
+			if (_rejections == rejections)
+			{
+				return;
+			}
+		}
+	}
+};
+
+struct QueueingJoin
+{
+};
+
+struct TagMatchingJoin
+{
+};
+
+using JoinTag = unsigned long long;
+
+template<typename JoinType, size_t Index, typename T>
+class JoinInputPort : public FlowReceiver<T>
+{
+	JoinType& _join;
+public:
+	//not explicit, ports are constructed in place from join reference
+	JoinInputPort(JoinType& join) :
+		_join(join)
+	{
+	}
+
+	JoinInputPort(const JoinInputPort&) = delete;
+	JoinInputPort& operator=(const JoinInputPort&) = delete;
+
+	bool TryPut(const T& message) override
+	{
+		return _join.template PutToPort<Index>(message);
+	}
+};
+
+template<typename JoinType, typename Indices, typename ...Types>
+struct JoinPorts;
+
+template<typename JoinType, size_t ...Indices, typename ...Types>
+struct JoinPorts<JoinType, std::index_sequence<Indices...>, Types...>
+{
+	using type = std::tuple<JoinInputPort<JoinType, Indices, Types>...>;
+};
+
+//join reference repeated for every port type
+template<typename T, typename JoinType>
+JoinType& JoinRef(JoinType& join)
+{
+	return join;
+}
+
+template<typename Policy, typename ...Types>
+class JoinNode;
+
+//joins one message from every port into tuple, in arrival order per port
+template<typename ...Types>
+class JoinNode<QueueingJoin, Types...> :
+	public FlowSender<std::tuple<Types...>>
+{
+	template<typename JoinType, size_t Index, typename T>
+	friend class JoinInputPort;
+
+	using OutputType = std::tuple<Types...>;
+
+	std::mutex _mutex;
+	std::tuple<std::deque<Types>...> _queues;
+	typename JoinPorts<JoinNode, std::index_sequence_for<Types...>, Types...>::type _ports;
+
+public:
+	explicit JoinNode(FlowGraph&) :
+		_ports(JoinRef<Types>(*this)...)
+	{
+	}
+
+	JoinNode(const JoinNode&) = delete;
+	JoinNode& operator=(const JoinNode&) = delete;
+
+	template<size_t Index>
+	auto& InputPort()
+	{
+		return std::get<Index>(_ports);
+	}
+
+private:
+	template<size_t Index>
+	bool PutToPort(const std::tuple_element_t<Index, OutputType>& message)
+	{
+		OutputType output;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			std::get<Index>(_queues).push_back(message);
+
+			if (!AllQueuesReady(std::index_sequence_for<Types...>()))
+			{
+				return true;
+			}
+			output = PopFront(std::index_sequence_for<Types...>());
+		}
+
+		this->Broadcast(output);
+		return true;
+	}
+
+	template<size_t ...Indices>
+	bool AllQueuesReady(std::index_sequence<Indices...>) const
+	{
+		return (!std::get<Indices>(_queues).empty() && ...);
+	}
+
+	template<size_t ...Indices>
+	OutputType PopFront(std::index_sequence<Indices...>)
+	{
+		OutputType output(std::move(std::get<Indices>(_queues).front())...);
+		(std::get<Indices>(_queues).pop_front(), ...);
+		return output;
+	}
+};
+
+//joins messages with the same tag from every port
+template<typename ...Types>
+class JoinNode<TagMatchingJoin, Types...> :
+	public FlowSender<std::tuple<Types...>>
+{
+	template<typename JoinType, size_t Index, typename T>
+	friend class JoinInputPort;
+
+	using OutputType = std::tuple<Types...>;
+
+	std::mutex _mutex;
+	std::tuple<std::function<JoinTag(const Types&)>...> _tagCallables;
+	std::tuple<std::multimap<JoinTag, Types>...> _messages;
+	typename JoinPorts<JoinNode, std::index_sequence_for<Types...>, Types...>::type _ports;
+
+public:
+	JoinNode(FlowGraph&, std::function<JoinTag(const Types&)> ...tagCallables) :
+		_tagCallables(std::move(tagCallables)...),
+		_ports(JoinRef<Types>(*this)...)
+	{
+	}
+
+	JoinNode(const JoinNode&) = delete;
+	JoinNode& operator=(const JoinNode&) = delete;
+
+	template<size_t Index>
+	auto& InputPort()
+	{
+		return std::get<Index>(_ports);
+	}
+
+private:
+	template<size_t Index>
+	bool PutToPort(const std::tuple_element_t<Index, OutputType>& message)
+	{
+		OutputType output;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			const JoinTag tag = std::get<Index>(_tagCallables)(message);
+			std::get<Index>(_messages).emplace(tag, message);
+
+			if (!AllPortsHaveTag(tag, std::index_sequence_for<Types...>()))
+			{
+				return true;
+			}
+			output = ExtractTag(tag, std::index_sequence_for<Types...>());
+		}
+
+		this->Broadcast(output);
+		return true;
+	}
+
+	template<size_t ...Indices>
+	bool AllPortsHaveTag(JoinTag tag, std::index_sequence<Indices...>) const
+	{
+		return ((std::get<Indices>(_messages).count(tag) > 0) && ...);
+	}
+
+	template<size_t Index>
+	std::tuple_element_t<Index, OutputType> ExtractMessage(JoinTag tag)
+	{
+		auto& messages = std::get<Index>(_messages);
+		auto it = messages.find(tag);
+		auto message = std::move(it->second);
+		messages.erase(it);
+		return message;
+	}
+
+	template<size_t ...Indices>
+	OutputType ExtractTag(JoinTag tag, std::index_sequence<Indices...>)
+	{
+		return OutputType(ExtractMessage<Indices>(tag)...);
+	}
+};
@@ -9,6 +9,21 @@
 #include <chrono>       
 #include <ctime>
 #include <set>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <utility>
+#include <string>
+#include <string_view>
+
+#include "task_trace.h"
+#include "task_perf_counters.h"
+#include "task_cost_model.h"
 
 using TaskId = unsigned int;
 class TaskBase;
@@ -113,16 +128,36 @@ protected:
 		return id++;
 	}
 	TaskId _taskId = GetNextTaskId();
+	std::string _name;
+
+	std::mutex _completionMutex;
+	bool _completed{ false };
+	std::vector<std::function<void()>> _completionCallbacks;
 
 	virtual void ExecuteInt() = 0;
 
+	//returns false if task suspended itself and will be resumed later
+	virtual bool ResumeInt()
+	{
+		ExecuteInt();
+		return true;
+	}
+
 public:
 
 	TaskBase() = default;
 
 	TaskBase(TaskBase& other):
 		_affinity(other._affinity),
-		_taskId(GetNextTaskId())
+		_taskId(GetNextTaskId()),
+		_name(other._name)
+	{
+	}
+
+	TaskBase(TaskBase&& other) :
+		_affinity(other._affinity),
+		_taskId(other._taskId),
+		_name(std::move(other._name))
 	{
 	}
 
@@ -133,13 +168,21 @@ public:
 			_affinity = other._affinity;
 			//taskid has to be unique
 			_taskId = GetNextTaskId();
+			_name = other._name;
 		}
 		return *this;
 	}
 
-	TaskBase(TaskBase&& other) = default;
-	
-	TaskBase& operator=(TaskBase&& other) = default;
+	TaskBase& operator=(TaskBase&& other)
+	{
+		if (this != &other)
+		{
+			_affinity = other._affinity;
+			_taskId = other._taskId;
+			_name = std::move(other._name);
+		}
+		return *this;
+	}
 
 	virtual ~TaskBase() = default;
 	
@@ -148,15 +191,66 @@ public:
 		return _taskId;
 	}
 
+	//name shown in exported graphs and profiles, set it before graph runs
+	void SetName(std::string name)
+	{
+		_name = std::move(name);
+	}
+
+	const std::string& GetName() const
+	{
+		return _name;
+	}
+
+	//kind of node, used to group tasks in exports and statistics
+	virtual const char* GetTypeName() const
+	{
+		return "TaskBase";
+	}
+
 	virtual bool CanRun(TaskId prevTaskId) const
 	{
 		return true;
 	}
 
-	TaskId Run()
+	//returns true when task is completed, false when it is suspended
+	bool Run()
 	{
-		ExecuteInt();
-		return GetTaskId();
+		return ResumeInt();
+	}
+
+	//register callback invoked when task completes
+	//returns false if task is already completed (callback is not stored)
+	bool AddCompletionCallback(std::function<void()> callback)
+	{
+		std::unique_lock<std::mutex> lock(_completionMutex);
+		if (_completed)
+		{
+			return false;
+		}
+		_completionCallbacks.push_back(std::move(callback));
+		return true;
+	}
+
+	void Complete()
+	{
+		std::vector<std::function<void()>> callbacks;
+		{
+			std::unique_lock<std::mutex> lock(_completionMutex);
+			_completed = true;
+			callbacks.swap(_completionCallbacks);
+		}
+
+		for (auto& callback : callbacks)
+		{
+			callback();
+		}
+	}
+
+	bool IsCompleted()
+	{
+		std::unique_lock<std::mutex> lock(_completionMutex);
+		return _completed;
 	}
 	
 	void SetAffinity(const std::initializer_list<unsigned int>& affinities)
@@ -170,65 +264,571 @@ public:
 	}
 };
 
+const size_t CacheLineSize = 64;
+
+//ring of completed task ids, written by one worker and drained by coordinator without locks
+class CompletionBuffer
+{
+	static const size_t Capacity = 1024;
+
+	//producer and consumer indexes on separate cache lines
+	alignas(CacheLineSize) std::atomic<size_t> _head{ 0 };
+	alignas(CacheLineSize) std::atomic<size_t> _tail{ 0 };
+	alignas(CacheLineSize) std::array<TaskId, Capacity> _tasks;
+
+public:
+	//returns number of pushed tasks, less than count when buffer is full
+	size_t Push(const TaskId* tasks, size_t count)
+	{
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		const size_t head = _head.load(std::memory_order_acquire);
+
+		count = std::min(count, Capacity - (tail - head));
+		for (size_t index = 0; index < count; ++index)
+		{
+			_tasks[(tail + index) % Capacity] = tasks[index];
+		}
+
+		_tail.store(tail + count, std::memory_order_release);
+		return count;
+	}
+
+	bool Empty() const
+	{
+		return _head.load(std::memory_order_relaxed) == _tail.load(std::memory_order_acquire);
+	}
+
+	size_t Drain(std::vector<TaskId>& tasks)
+	{
+		const size_t head = _head.load(std::memory_order_relaxed);
+		const size_t tail = _tail.load(std::memory_order_acquire);
+
+		for (size_t index = head; index != tail; ++index)
+		{
+			tasks.push_back(_tasks[index % Capacity]);
+		}
+
+		_head.store(tail, std::memory_order_release);
+		return tail - head;
+	}
+
+	//approximate when read by other thread than producer and consumer
+	size_t Size() const
+	{
+		return _tail.load(std::memory_order_relaxed) - _head.load(std::memory_order_relaxed);
+	}
+};
+
+//how many completions coordinator handles per wake up
+struct CompletionBatchStatistics
+{
+	static const size_t HistogramSize = 16;
+
+	unsigned long long batches{ 0 };
+	unsigned long long completedTasks{ 0 };
+	//bucket i counts batches of size [2^i, 2^(i+1))
+	std::array<unsigned long long, HistogramSize> batchSizeHistogram{};
+};
+
+struct WorkerStatistics
+{
+	unsigned long long executedTasks{ 0 };
+	unsigned long long stolenTasks{ 0 };
+	unsigned long long failedSteals{ 0 };
+	//time waiting for jobs on condition variable
+	unsigned long long parkedNanoseconds{ 0 };
+	//time searching other queues for jobs
+	unsigned long long spinningNanoseconds{ 0 };
+	unsigned long long queueHighWater{ 0 };
+	unsigned long long wakeUps{ 0 };
+
+	WorkerStatistics& operator+=(const WorkerStatistics& other)
+	{
+		executedTasks += other.executedTasks;
+		stolenTasks += other.stolenTasks;
+		failedSteals += other.failedSteals;
+		parkedNanoseconds += other.parkedNanoseconds;
+		spinningNanoseconds += other.spinningNanoseconds;
+		queueHighWater = queueHighWater > other.queueHighWater ? queueHighWater : other.queueHighWater;
+		wakeUps += other.wakeUps;
+		return *this;
+	}
+};
+
+struct SchedulerStatistics
+{
+	std::vector<WorkerStatistics> workers;
+
+	//sums of all workers, high water is the maximum
+	WorkerStatistics Total() const
+	{
+		WorkerStatistics total;
+		for (const auto& worker : workers)
+		{
+			total += worker;
+		}
+		return total;
+	}
+};
+
+//queue lengths at one moment, taken by QueueMonitor while graph runs
+struct QueueDepthSample
+{
+	//steady clock nanoseconds
+	long long time{ 0 };
+	//jobs waiting in every worker queue
+	std::vector<size_t> workerJobs;
+	//tasks coordinator did not hand to workers yet
+	size_t pendingTasks{ 0 };
+	//tasks added to graph and not done, includes tasks waiting for parents
+	size_t unfinishedTasks{ 0 };
+	//completions and signals coordinator did not process yet
+	size_t readyTasks{ 0 };
+
+	size_t MaxWorkerJobs() const
+	{
+		return workerJobs.empty() ? 0 : *std::max_element(workerJobs.begin(), workerJobs.end());
+	}
+
+	//deepest worker queue / mean depth, 1 is balanced, 0 when all queues are empty
+	double Imbalance() const
+	{
+		size_t total = 0;
+		for (auto jobs : workerJobs)
+		{
+			total += jobs;
+		}
+		return total ? static_cast<double>(MaxWorkerJobs()) * workerJobs.size() / total : 0;
+	}
+};
+
+//counter with single writer, relaxed load and store instead of read modify write
+class StatisticsCounter
+{
+	std::atomic<unsigned long long> _value{ 0 };
+public:
+	void Add(unsigned long long value)
+	{
+		_value.store(_value.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+	}
+
+	void Max(unsigned long long value)
+	{
+		if (value > _value.load(std::memory_order_relaxed))
+		{
+			_value.store(value, std::memory_order_relaxed);
+		}
+	}
+
+	unsigned long long Get() const
+	{
+		return _value.load(std::memory_order_relaxed);
+	}
+
+	void Reset()
+	{
+		_value.store(0, std::memory_order_relaxed);
+	}
+};
+
+//cost model key of task, its name or node type when it has no name
+inline std::string_view GetTaskCostKey(const TaskBase& task)
+{
+	return task.GetName().empty() ? std::string_view(task.GetTypeName()) : std::string_view(task.GetName());
+}
+
+//one run of a task on a worker, suspended tasks have a record per resumption
+struct TaskExecutionRecord
+{
+	TaskId taskId{ 0 };
+	//steady clock nanoseconds
+	long long begin{ 0 };
+	long long end{ 0 };
+	//zero unless hardware counters are enabled
+	PerfCounterValues counters;
+};
+
+//scheduler state of one worker, kept on its own cache lines so workers do not bounce them
+struct alignas(CacheLineSize) WorkerState
+{
+	std::mutex mutexJobs;
+	std::condition_variable cvJobs;
+	std::deque<TaskRef> jobs;
+	bool parked{ false };
+
+	//queue size readable without lock, used to pick steal victim
+	std::atomic<size_t> jobsCount{ 0 };
+
+	CompletionBuffer completions;
+
+	//written by worker itself, high water by coordinator under mutexJobs
+	StatisticsCounter executedTasks;
+	StatisticsCounter stolenTasks;
+	StatisticsCounter failedSteals;
+	StatisticsCounter parkedNanoseconds;
+	StatisticsCounter spinningNanoseconds;
+	StatisticsCounter queueHighWater;
+	StatisticsCounter wakeUps;
+
+	//filled by worker while profiling, collected after workers are joined
+	std::vector<TaskExecutionRecord> executions;
+
+	//execution times not yet merged into cost model, written by worker only
+	LatencyHistograms costSamples;
+};
+
+inline unsigned long long ElapsedNanoseconds(std::chrono::steady_clock::time_point begin)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+}
+
 class TaskController
 {
 	unsigned int _numThreads{ 1 };
-	unsigned int _threadNumberToAddTask{ 0 };
+	std::unique_ptr<WorkerState[]> _workers;
 
-	std::condition_variable _cvReadyTasks;
-	std::mutex _mutexReadyTasks;
-	
-	std::condition_variable _cvJobs;
-	std::mutex _mutexJobs;
+	//written by coordinator only
+	alignas(CacheLineSize) unsigned int _threadNumberToAddTask{ 0 };
+	std::vector<std::vector<TaskRef>> _jobsToAdd;
 
+	alignas(CacheLineSize) std::mutex _mutexReadyTasks;
+	std::condition_variable _cvReadyTasks;
 	std::vector<TaskId> _readyTasks;
-	std::atomic<bool> _readyToExit{ false };
-		
-	std::vector<std::deque<TaskId>> _taskJobs;	
-	std::queue<unsigned int> _threadsLookingForJob;
+	std::vector<TaskId> _resumedTasks;
+	std::vector<TaskRef> _spawnedTasks;
+	bool _wakeUp{ false };
+
+	alignas(CacheLineSize) std::atomic<bool> _coordinatorWaiting{ false };
+
+	//coordinator queues published for QueueMonitor, written by coordinator only
+	alignas(CacheLineSize) std::atomic<size_t> _pendingTasksCount{ 0 };
+	std::atomic<size_t> _unfinishedTasksCount{ 0 };
+	alignas(CacheLineSize) std::atomic<bool> _readyToExit{ false };
+
+	//set only while workers are not running
+	std::unique_ptr<TaskTracer> _tracer;
+
+	bool _profiling{ false };
+	bool _perfCounters{ false };
+	std::shared_ptr<TaskCostModel> _costModel;
+
+	//coordinator wakes up at least this often when set, zero waits without timeout
+	std::chrono::steady_clock::duration _wakeUpPeriod{ 0 };
+
+	alignas(CacheLineSize) std::atomic<unsigned long long> _completionBatches{ 0 };
+	std::atomic<unsigned long long> _completedTasksCount{ 0 };
+	std::array<std::atomic<unsigned long long>, CompletionBatchStatistics::HistogramSize> _batchSizeHistogram{};
 
 public:
 	explicit TaskController(unsigned int NumThreads):
-		_numThreads(NumThreads)
+		_numThreads(NumThreads),
+		_workers(new WorkerState[NumThreads]),
+		_jobsToAdd(NumThreads)
 	{
-		_taskJobs.resize(NumThreads);
 	}
 
-	std::vector<TaskId> WaitTillReadyTask()
+	//controller of the worker thread running on the calling thread
+	static TaskController*& Current()
 	{
-		std::unique_lock<std::mutex> guard(_mutexReadyTasks);
-		
-		_cvReadyTasks.wait(guard, [&]() {return _readyTasks.size() > 0;});
+		static thread_local TaskController* current = nullptr;
+		return current;
+	}
+
+	unsigned int GetNumThreads() const
+	{
+		return _numThreads;
+	}
+
+	std::vector<TaskId> WaitTillReadyTask(std::vector<TaskId>& resumedTasks, std::vector<TaskRef>& spawnedTasks)
+	{
+		std::vector<TaskId> resultTasks;
+		std::unique_lock<std::mutex> guard(_mutexReadyTasks, std::defer_lock);
+
+		while (true)
+		{
+			//drain completions first, tasks spawned before them are in the list by then
+			DrainCompletionBuffers(resultTasks);
+
+			guard.lock();
+			if (!resultTasks.empty() || HasSignals())
+			{
+				break;
+			}
+
+			_coordinatorWaiting = true;
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const long long idleBegin = _tracer ? _tracer->Now() : 0;
+			auto hasWork = [&]() {return HasSignals() || HasCompletedTasks();};
+			bool timedOut = false;
+			if (_wakeUpPeriod.count() > 0)
+			{
+				timedOut = !_cvReadyTasks.wait_for(guard, _wakeUpPeriod, hasWork);
+			}
+			else
+			{
+				_cvReadyTasks.wait(guard, hasWork);
+			}
+			_coordinatorWaiting = false;
+
+			if (_tracer)
+			{
+				_tracer->RecordIdle(_tracer->GetCoordinatorThread(), idleBegin, _tracer->Now());
+			}
+
+			if (timedOut)
+			{
+				//let caller do its periodic work
+				break;
+			}
+
+			guard.unlock();
+		}
+
+		_wakeUp = false;
 				
 		//clear ready tasks
-		std::vector<TaskId> resultTasks;
-		resultTasks.swap(_readyTasks);
+		std::move(_readyTasks.begin(), _readyTasks.end(), std::back_inserter(resultTasks));
+		_readyTasks.clear();
+		resumedTasks.swap(_resumedTasks);
+		spawnedTasks.swap(_spawnedTasks);
+
+		RecordCompletionBatch(resultTasks.size());
 
 		return resultTasks;
 	}
 
+	//publish tasks completed by worker, coordinator is woken up once per batch
+	void PublishCompletedTasks(unsigned int threadNumber, const std::vector<TaskId>& tasks)
+	{
+		if (tasks.empty())
+		{
+			return;
+		}
+
+		auto& buffer = _workers[threadNumber].completions;
+		size_t published = 0;
+
+		while (true)
+		{
+			published += buffer.Push(tasks.data() + published, tasks.size() - published);
+
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (_coordinatorWaiting.load(std::memory_order_relaxed))
+			{
+				{
+					//coordinator is either before its check or waiting
+					std::unique_lock<std::mutex> lock(_mutexReadyTasks);
+				}
+				_cvReadyTasks.notify_one();
+			}
+
+			if (published == tasks.size())
+			{
+				break;
+			}
+
+			//buffer is full, let coordinator drain it
+			std::this_thread::yield();
+		}
+	}
+
+	//tracing is switched only outside of WaitAll, workers read the pointer without lock
+	void EnableTracing(size_t eventsPerThread)
+	{
+		_tracer = std::make_unique<TaskTracer>(_numThreads, eventsPerThread);
+	}
+
+	void DisableTracing()
+	{
+		_tracer.reset();
+	}
+
+	TaskTracer* GetTracer() const
+	{
+		return _tracer.get();
+	}
+
+	//called outside of WaitAll
+	void SetProfiling(bool profiling)
+	{
+		_profiling = profiling;
+	}
+
+	bool IsProfiling() const
+	{
+		return _profiling;
+	}
+
+	//called outside of WaitAll, counters are recorded with profile only
+	void SetPerfCounters(bool perfCounters)
+	{
+		_perfCounters = perfCounters;
+	}
+
+	bool IsCountingPerfCounters() const
+	{
+		return _perfCounters && _profiling;
+	}
+
+	//called outside of WaitAll
+	void SetCostModel(std::shared_ptr<TaskCostModel> costModel)
+	{
+		_costModel = std::move(costModel);
+	}
+
+	TaskCostModel* GetCostModel() const
+	{
+		return _costModel.get();
+	}
+
+	//sample stays in worker until it flushes them, so workers do not contend on model
+	void RecordCost(unsigned int threadNumber, std::string_view key, unsigned long long nanoseconds)
+	{
+		auto& samples = _workers[threadNumber].costSamples;
+		auto histogram = samples.find(key);
+		if (histogram == samples.end())
+		{
+			histogram = samples.emplace(std::string(key), LatencyHistogram()).first;
+		}
+		histogram->second.Record(nanoseconds);
+	}
+
+	//called by worker before it waits for jobs
+	void FlushCostSamples(unsigned int threadNumber)
+	{
+		auto& samples = _workers[threadNumber].costSamples;
+		if (_costModel && !samples.empty())
+		{
+			_costModel->Merge(samples);
+		}
+	}
+
+	void RecordExecution(unsigned int threadNumber, const TaskExecutionRecord& record)
+	{
+		_workers[threadNumber].executions.push_back(record);
+	}
+
+	//called when workers are joined
+	std::vector<TaskExecutionRecord> TakeExecutions(unsigned int threadNumber)
+	{
+		return std::exchange(_workers[threadNumber].executions, {});
+	}
+
+	//called outside of WaitAll
+	void SetWakeUpPeriod(std::chrono::steady_clock::duration period)
+	{
+		_wakeUpPeriod = period;
+	}
+
+	void RecordExecutedTasks(unsigned int threadNumber, size_t count)
+	{
+		_workers[threadNumber].executedTasks.Add(count);
+	}
+
+	//counters are read while workers run, every value is consistent but not the snapshot as whole
+	SchedulerStatistics GetStatistics() const
+	{
+		SchedulerStatistics statistics;
+		statistics.workers.resize(_numThreads);
+		for (unsigned int threadNumber = 0; threadNumber < _numThreads; ++threadNumber)
+		{
+			const auto& worker = _workers[threadNumber];
+			auto& workerStatistics = statistics.workers[threadNumber];
+			workerStatistics.executedTasks = worker.executedTasks.Get();
+			workerStatistics.stolenTasks = worker.stolenTasks.Get();
+			workerStatistics.failedSteals = worker.failedSteals.Get();
+			workerStatistics.parkedNanoseconds = worker.parkedNanoseconds.Get();
+			workerStatistics.spinningNanoseconds = worker.spinningNanoseconds.Get();
+			workerStatistics.queueHighWater = worker.queueHighWater.Get();
+			workerStatistics.wakeUps = worker.wakeUps.Get();
+		}
+		return statistics;
+	}
+
+	//called outside of WaitAll
+	void ResetStatistics()
+	{
+		for (unsigned int threadNumber = 0; threadNumber < _numThreads; ++threadNumber)
+		{
+			auto& worker = _workers[threadNumber];
+			worker.executedTasks.Reset();
+			worker.stolenTasks.Reset();
+			worker.failedSteals.Reset();
+			worker.parkedNanoseconds.Reset();
+			worker.spinningNanoseconds.Reset();
+			worker.queueHighWater.Reset();
+			worker.wakeUps.Reset();
+		}
+	}
+
+	CompletionBatchStatistics GetCompletionBatchStatistics() const
+	{
+		CompletionBatchStatistics statistics;
+		statistics.batches = _completionBatches.load(std::memory_order_relaxed);
+		statistics.completedTasks = _completedTasksCount.load(std::memory_order_relaxed);
+		for (size_t bucket = 0; bucket < statistics.batchSizeHistogram.size(); ++bucket)
+		{
+			statistics.batchSizeHistogram[bucket] = _batchSizeHistogram[bucket].load(std::memory_order_relaxed);
+		}
+		return statistics;
+	}
+
 	bool WaitForTaskOrDone(unsigned int threadNumber)
 	{
-		std::unique_lock<std::mutex> guard(_mutexJobs);
+		auto& worker = _workers[threadNumber];
+		std::unique_lock<std::mutex> guard(worker.mutexJobs);
 		
-		_cvJobs.wait(guard, [&]() { return _taskJobs[threadNumber].size() > 0 || _readyToExit;});
+		auto hasJobOrDone = [&]() { return worker.jobs.size() > 0 || _readyToExit;};
+		if (hasJobOrDone())
+		{
+			return _readyToExit;
+		}
+
+		const long long idleBegin = _tracer ? _tracer->Now() : 0;
+		const auto parkBegin = std::chrono::steady_clock::now();
+
+		worker.parked = true;
+		worker.cvJobs.wait(guard, hasJobOrDone);
+		worker.parked = false;
+
+		worker.parkedNanoseconds.Add(ElapsedNanoseconds(parkBegin));
+		worker.wakeUps.Add(1);
+
+		if (_tracer)
+		{
+			_tracer->RecordIdle(threadNumber, idleBegin, _tracer->Now());
+		}
 
 		return _readyToExit;
 	}
 
-	std::queue<TaskId> StealSomeTaskJobs(unsigned int lookingThreadId)
+	std::queue<TaskRef> StealSomeTaskJobs(unsigned int lookingThreadId)
 	{
-		//locked from outside
-		std::queue<TaskId> tasks;
+		std::queue<TaskRef> tasks;
+		if (_numThreads < 2)
+		{
+			return tasks;
+		}
+
+		auto& thief = _workers[lookingThreadId];
+		const auto stealBegin = std::chrono::steady_clock::now();
 
-		for (unsigned int threadId = 0; threadId < _taskJobs.size(); ++threadId)
+		//start from neighbour so all threads do not pick the same victim
+		for (unsigned int offset = 1; offset < _numThreads; ++offset)
 		{
-			auto&  tasksCollection = _taskJobs[threadId];
+			const unsigned int threadId = (lookingThreadId + offset) % _numThreads;
+			auto& victim = _workers[threadId];
 
-			if (threadId != lookingThreadId && tasksCollection.size() > 1)
+			if (victim.jobsCount.load(std::memory_order_relaxed) <= 1)
 			{
-				std::cout << "\n\nThread:" << lookingThreadId << " steals from Thread:" << threadId << "\n\n";
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(victim.mutexJobs);
+			auto&  tasksCollection = victim.jobs;
 
+			if (tasksCollection.size() > 1)
+			{
 				//give thread some tasks ;) ( not matter the affinity)
 
 				//steal half of the tasks
@@ -240,20 +840,35 @@ public:
 				}
 
 				tasksCollection.erase(itMiddle, tasksCollection.end());
+				victim.jobsCount.store(tasksCollection.size(), std::memory_order_relaxed);
+
+				if (_tracer)
+				{
+					_tracer->RecordSteal(lookingThreadId, threadId, static_cast<unsigned int>(tasks.size()), _tracer->Now());
+				}
 
 				break;
 			}
 		}
+
+		if (tasks.empty())
+		{
+			thief.failedSteals.Add(1);
+		}
+		thief.stolenTasks.Add(tasks.size());
+		thief.spinningNanoseconds.Add(ElapsedNanoseconds(stealBegin));
+
 		return tasks;
 	}
 
-	std::queue<TaskId> GetSomeTaskJobs(unsigned int threadNumber)
+	std::queue<TaskRef> GetSomeTaskJobs(unsigned int threadNumber)
 	{
-		std::queue<TaskId> tasks;
+		std::queue<TaskRef> tasks;
 		
 		{
-			std::unique_lock<std::mutex> lock(_mutexJobs);
-			auto& threadJobs = _taskJobs[threadNumber];
+			auto& worker = _workers[threadNumber];
+			std::unique_lock<std::mutex> lock(worker.mutexJobs);
+			auto& threadJobs = worker.jobs;
 			if (threadJobs.size() > 0)
 			{
 
@@ -268,54 +883,85 @@ public:
 				}
 					
 				threadJobs.erase(threadJobs.begin(), itMiddle);
-			}
-			else
-			{
-				//steal some tasks if available
-				tasks.swap(StealSomeTaskJobs(threadNumber));
+				worker.jobsCount.store(threadJobs.size(), std::memory_order_relaxed);
+
+				return tasks;
 			}
 		}
-		
 
-		return move(tasks);
+		//steal some tasks if available
+		return StealSomeTaskJobs(threadNumber);
 	}
 
 	void AddTaskJobs(std::vector<TaskId>&& taskIds, const TasksCollection& tasks)
 	{
+		//distribute first, then touch every worker queue once
+		for (const auto taskId:taskIds)
 		{
-			std::unique_lock<std::mutex> lock(_mutexJobs);
+			const auto task = tasks.find(taskId);
 
-			for (const auto taskId:taskIds)
+			//no affinity add to next thread
+			if (!task->second->GetAffinity().HasAffinity())
 			{
-				const auto task = tasks.find(taskId);
-
-				//no affinity add to next thread
-				if (!task->second->GetAffinity().HasAffinity())
-				{
-					_taskJobs[_threadNumberToAddTask++].emplace_back(taskId);
-				}
-				//get affinity of task
-				else
-				{
-					unsigned int Affinity = task->second->GetAffinity().GetFirstAffinity();
-					Affinity = Affinity < _numThreads ? Affinity : _threadNumberToAddTask++;
+				_jobsToAdd[_threadNumberToAddTask++].emplace_back(task->second);
+			}
+			//get affinity of task
+			else
+			{
+				unsigned int Affinity = task->second->GetAffinity().GetFirstAffinity();
+				Affinity = Affinity < _numThreads ? Affinity : _threadNumberToAddTask++;
 					
-					_taskJobs[Affinity].emplace_back(taskId);
-				}
+				_jobsToAdd[Affinity].emplace_back(task->second);
+			}
 				
-				if (_threadNumberToAddTask >= _numThreads)
-				{
-					_threadNumberToAddTask = 0;
-				}
+			if (_threadNumberToAddTask >= _numThreads)
+			{
+				_threadNumberToAddTask = 0;
+			}
+		}
+
+		for (unsigned int threadNumber = 0; threadNumber < _numThreads; ++threadNumber)
+		{
+			auto& jobs = _jobsToAdd[threadNumber];
+			if (jobs.empty())
+			{
+				continue;
+			}
+
+			auto& worker = _workers[threadNumber];
+			bool parked = false;
+			{
+				std::unique_lock<std::mutex> lock(worker.mutexJobs);
+				std::move(jobs.begin(), jobs.end(), std::back_inserter(worker.jobs));
+				worker.jobsCount.store(worker.jobs.size(), std::memory_order_relaxed);
+				worker.queueHighWater.Max(worker.jobs.size());
+				parked = worker.parked;
+			}
+			jobs.clear();
+
+			if (parked)
+			{
+				worker.cvJobs.notify_one();
 			}
 		}
-		_cvJobs.notify_all();
 	}
 
 	void SignalReadyToExit()
 	{
+		_readyToExit = true;
+
+		//wake up workers waiting for jobs so they can exit
+		for (unsigned int threadNumber = 0; threadNumber < _numThreads; ++threadNumber)
 		{
-			_readyToExit = true;
+			auto& worker = _workers[threadNumber];
+			{
+				std::unique_lock<std::mutex> lock(worker.mutexJobs);
+			}
+			worker.cvJobs.notify_all();
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(_mutexReadyTasks);
 		}
 		_cvReadyTasks.notify_all();
 	}
@@ -339,15 +985,112 @@ public:
 		_cvReadyTasks.notify_one();
 	}
 
-	void Clear()
+	void PublishCoordinatorQueues(size_t pendingTasks, size_t unfinishedTasks)
 	{
-		//all threads are done no need of locks
-		while (!_threadsLookingForJob.empty())
+		_pendingTasksCount.store(pendingTasks, std::memory_order_relaxed);
+		_unfinishedTasksCount.store(unfinishedTasks, std::memory_order_relaxed);
+	}
+
+	//callable from any thread, worker queues are read without locking them
+	QueueDepthSample SampleQueueDepths()
+	{
+		QueueDepthSample sample;
+		sample.time = SteadyClockNanoseconds();
+		sample.workerJobs.resize(_numThreads);
+		for (unsigned int threadNumber = 0; threadNumber < _numThreads; ++threadNumber)
 		{
-			_threadsLookingForJob.pop();
+			sample.workerJobs[threadNumber] = _workers[threadNumber].jobsCount.load(std::memory_order_relaxed);
+			sample.readyTasks += _workers[threadNumber].completions.Size();
 		}
+		sample.pendingTasks = _pendingTasksCount.load(std::memory_order_relaxed);
+		sample.unfinishedTasks = _unfinishedTasksCount.load(std::memory_order_relaxed);
 
+		std::unique_lock<std::mutex> lock(_mutexReadyTasks);
+		sample.readyTasks += _readyTasks.size() + _resumedTasks.size() + _spawnedTasks.size();
+		return sample;
+	}
+
+	//suspended task is ready to continue, schedule it again
+	//may be called from thread outside of graph, notify under lock
+	//as coordinator can return and destroy controller right after the push
+	void SignalTaskResumed(TaskId taskId)
+	{
+		std::unique_lock<std::mutex> lock(_mutexReadyTasks);
+		_resumedTasks.push_back(taskId);
+		_cvReadyTasks.notify_one();
+	}
+
+	//new task was created while graph is running
+	void SignalTaskSpawned(TaskRef task)
+	{
+		std::unique_lock<std::mutex> lock(_mutexReadyTasks);
+		_spawnedTasks.push_back(std::move(task));
+		_cvReadyTasks.notify_one();
+	}
+
+	//wake up coordinator without any task, it rechecks its state
+	void SignalWakeUp()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutexReadyTasks);
+			_wakeUp = true;
+		}
+		_cvReadyTasks.notify_one();
+	}
+
+private:
+	//locked from outside
+	bool HasSignals() const
+	{
+		return _readyTasks.size() > 0 || _resumedTasks.size() > 0 || _spawnedTasks.size() > 0 || _wakeUp;
+	}
+
+	bool HasCompletedTasks() const
+	{
+		for (unsigned int threadNumber = 0; threadNumber < _numThreads; ++threadNumber)
+		{
+			if (!_workers[threadNumber].completions.Empty())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void DrainCompletionBuffers(std::vector<TaskId>& tasks)
+	{
+		for (unsigned int threadNumber = 0; threadNumber < _numThreads; ++threadNumber)
+		{
+			_workers[threadNumber].completions.Drain(tasks);
+		}
+	}
+
+	void RecordCompletionBatch(size_t batchSize)
+	{
+		if (batchSize == 0)
+		{
+			return;
+		}
+
+		size_t bucket = 0;
+		while ((batchSize >> (bucket + 1)) > 0 && bucket + 1 < CompletionBatchStatistics::HistogramSize)
+		{
+			++bucket;
+		}
+
+		_completionBatches.fetch_add(1, std::memory_order_relaxed);
+		_completedTasksCount.fetch_add(batchSize, std::memory_order_relaxed);
+		_batchSizeHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+
+public:
+	void Clear()
+	{
+		//all threads are done no need of locks
 		_readyTasks.clear();
+		_resumedTasks.clear();
+		_spawnedTasks.clear();
+		_wakeUp = false;
 		_readyToExit = false;		
 	}
 };
@@ -0,0 +1,170 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+//vectors recycled by size class, for streaming stages that need buffer of the same size for every frame
+//released buffer keeps its capacity and pages, so next frame gets it without allocation and page faults
+//big buffers are advised to use transparent huge pages, which cuts TLB misses of passes over whole image
+template <typename T>
+class BufferPool
+{
+public:
+	static const size_t HugePageSize = 2 * 1024 * 1024;
+
+	struct Stats
+	{
+		//acquires served by recycled buffer
+		unsigned long long hits{ 0 };
+		//acquires that allocated
+		unsigned long long misses{ 0 };
+		//released buffers freed because pool was full
+		unsigned long long dropped{ 0 };
+		size_t retainedBytes{ 0 };
+	};
+
+private:
+	struct State
+	{
+		std::mutex mutex;
+		//size class in bytes to free buffers of that class
+		std::map<size_t, std::vector<std::vector<T>>> classes;
+		size_t maxRetainedBytes{ 0 };
+		Stats stats;
+	};
+
+	//buffers handed out as shared pointers keep state alive, so they may outlive pool
+	std::shared_ptr<State> _state{ std::make_shared<State>() };
+
+public:
+	explicit BufferPool(size_t maxRetainedBytes = size_t(256) * 1024 * 1024)
+	{
+		_state->maxRetainedBytes = maxRetainedBytes;
+	}
+
+	BufferPool(const BufferPool&) = delete;
+	BufferPool& operator=(const BufferPool&) = delete;
+
+	//powers of two up to huge page, multiples of huge page above, so frames of one size share class
+	static size_t SizeClass(size_t bytes)
+	{
+		if (bytes >= HugePageSize)
+		{
+			return (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+		}
+		size_t sizeClass = 64;
+		while (sizeClass < bytes)
+		{
+			sizeClass <<= 1;
+		}
+		return sizeClass;
+	}
+
+	//buffer of count elements, recycled one keeps its old content
+	std::vector<T> Acquire(size_t count)
+	{
+		const size_t sizeClass = SizeClass(count * sizeof(T));
+		std::vector<T> buffer;
+		{
+			std::lock_guard<std::mutex> lock(_state->mutex);
+			auto found = _state->classes.find(sizeClass);
+			if (found != _state->classes.end() && !found->second.empty())
+			{
+				buffer = std::move(found->second.back());
+				found->second.pop_back();
+				_state->stats.retainedBytes -= sizeClass;
+				++_state->stats.hits;
+			}
+			else
+			{
+				++_state->stats.misses;
+			}
+		}
+
+		if (buffer.capacity() == 0)
+		{
+			buffer.reserve(sizeClass / sizeof(T));
+			AdviseHugePages(buffer.data(), buffer.capacity() * sizeof(T));
+		}
+		buffer.resize(count);
+		return buffer;
+	}
+
+	//buffer goes back to its class, or is freed when pool holds maxRetainedBytes already
+	void Release(std::vector<T>&& buffer)
+	{
+		Release(*_state, std::move(buffer));
+	}
+
+	//shared buffer that goes back to pool when last owner releases it
+	std::shared_ptr<std::vector<T>> AcquireShared(size_t count)
+	{
+		std::shared_ptr<State> state = _state;
+		return std::shared_ptr<std::vector<T>>(new std::vector<T>(Acquire(count)), [state](std::vector<T>* buffer)
+		{
+			Release(*state, std::move(*buffer));
+			delete buffer;
+		});
+	}
+
+	Stats GetStats() const
+	{
+		std::lock_guard<std::mutex> lock(_state->mutex);
+		return _state->stats;
+	}
+
+	//frees all retained buffers
+	void Trim()
+	{
+		std::map<size_t, std::vector<std::vector<T>>> classes;
+		{
+			std::lock_guard<std::mutex> lock(_state->mutex);
+			classes.swap(_state->classes);
+			_state->stats.retainedBytes = 0;
+		}
+	}
+
+private:
+	static void Release(State& state, std::vector<T>&& buffer)
+	{
+		//capacity that is not class size came from outside of pool, it does not fit any class exactly
+		const size_t bytes = buffer.capacity() * sizeof(T);
+		if (bytes == 0 || SizeClass(bytes) != bytes)
+		{
+			return;
+		}
+
+		std::vector<T> freed;
+		std::lock_guard<std::mutex> lock(state.mutex);
+		if (state.stats.retainedBytes + bytes > state.maxRetainedBytes)
+		{
+			++state.stats.dropped;
+			freed = std::move(buffer);
+			return;
+		}
+		state.classes[bytes].push_back(std::move(buffer));
+		state.stats.retainedBytes += bytes;
+	}
+
+	static void AdviseHugePages(void* data, size_t bytes)
+	{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+		//only whole huge pages inside of buffer can be backed by them
+		const uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + HugePageSize - 1) & ~(uintptr_t(HugePageSize) - 1);
+		const uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes) & ~(uintptr_t(HugePageSize) - 1);
+		if (end > begin)
+		{
+			madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE);
+		}
+#else
+		(void)data;
+		(void)bytes;
+#endif
+	}
+};
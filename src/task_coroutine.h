@@ -0,0 +1,509 @@
+#pragma once
+#include "task_graph.h"
+#include "task_graph_utils.h"
+#include "task_io.h"
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define TASKGRAPH_HAS_COROUTINES 1
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+//state shared by all coroutine promises, used by awaiters to suspend the task
+class CoroutinePromiseBase
+{
+	TaskController* _controller{ nullptr };
+	TaskId _taskId{ 0 };
+	bool* _suspended{ nullptr };
+
+public:
+	void Bind(TaskController* controller, TaskId taskId, bool* suspended)
+	{
+		_controller = controller;
+		_taskId = taskId;
+		_suspended = suspended;
+	}
+
+	//mark task as suspended and return callback that reschedules it
+	//after the callback is handed over the coroutine may be resumed on other thread
+	std::function<void()> Suspend()
+	{
+		*_suspended = true;
+
+		auto controller = _controller;
+		auto taskId = _taskId;
+		return [controller, taskId]()
+		{
+			controller->SignalTaskResumed(taskId);
+		};
+	}
+
+	//awaited work was already done, continue without suspending
+	void CancelSuspend()
+	{
+		*_suspended = false;
+	}
+
+	//controller of graph running the coroutine, awaited work is spawned into it
+	TaskController& GetController() const
+	{
+		return *_controller;
+	}
+};
+
+template<typename OutputType>
+class TaskCoroutine
+{
+public:
+	struct promise_type : CoroutinePromiseBase
+	{
+		std::optional<OutputType> _result;
+
+		TaskCoroutine get_return_object()
+		{
+			return TaskCoroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+
+		void return_value(OutputType value)
+		{
+			_result.emplace(std::move(value));
+		}
+
+		void unhandled_exception()
+		{
+			std::terminate();
+		}
+	};
+
+	using Handle = std::coroutine_handle<promise_type>;
+
+	TaskCoroutine() = default;
+
+	TaskCoroutine(const TaskCoroutine&) = delete;
+	TaskCoroutine& operator=(const TaskCoroutine&) = delete;
+
+	TaskCoroutine(TaskCoroutine&& other) noexcept :
+		_handle(std::exchange(other._handle, {}))
+	{
+	}
+
+	TaskCoroutine& operator=(TaskCoroutine&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Destroy();
+			_handle = std::exchange(other._handle, {});
+		}
+		return *this;
+	}
+
+	~TaskCoroutine()
+	{
+		Destroy();
+	}
+
+	explicit operator bool() const
+	{
+		return static_cast<bool>(_handle);
+	}
+
+	promise_type& Promise() const
+	{
+		return _handle.promise();
+	}
+
+	void Resume() const
+	{
+		_handle.resume();
+	}
+
+	OutputType GetResult() const
+	{
+		return *_handle.promise()._result;
+	}
+
+private:
+	explicit TaskCoroutine(Handle handle) :
+		_handle(handle)
+	{
+	}
+
+	void Destroy()
+	{
+		if (_handle)
+		{
+			_handle.destroy();
+			_handle = {};
+		}
+	}
+
+	Handle _handle;
+};
+
+template<>
+struct TaskCoroutine<void>::promise_type : CoroutinePromiseBase
+{
+	TaskCoroutine get_return_object()
+	{
+		return TaskCoroutine(std::coroutine_handle<promise_type>::from_promise(*this));
+	}
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	std::suspend_always final_suspend() noexcept { return {}; }
+
+	void return_void()
+	{
+	}
+
+	void unhandled_exception()
+	{
+		std::terminate();
+	}
+};
+
+template<>
+inline void TaskCoroutine<void>::GetResult() const
+{
+}
+
+//task which body is a coroutine, it gives its worker back while co_awaiting
+template<typename OutputType>
+class CoroutineTaskNode :
+	public TaskBase,
+	public TaskResult<OutputType>,
+	public TaskFactory<CoroutineTaskNode<OutputType>>
+{
+	using TaskCallable = std::function<TaskCoroutine<OutputType>()>;
+
+	template<typename T, typename ...Args>
+	friend struct shared_enabler;
+
+	TaskCallable _callable;
+	TaskCoroutine<OutputType> _coroutine;
+
+	explicit CoroutineTaskNode(TaskCallable callable) :
+		_callable(callable)
+	{
+	}
+public:
+	CoroutineTaskNode(const CoroutineTaskNode&) = delete;
+	CoroutineTaskNode& operator = (const CoroutineTaskNode&) = delete;
+
+	OutputType GetResult() const override
+	{
+		return _coroutine.GetResult();
+	}
+
+	void ExecuteInt() override
+	{
+		ResumeInt();
+	}
+
+	const char* GetTypeName() const override
+	{
+		return "CoroutineTaskNode";
+	}
+
+protected:
+	bool ResumeInt() override
+	{
+		if (!_coroutine)
+		{
+			//coroutine starts suspended, first run starts it
+			_coroutine = _callable();
+		}
+
+		bool suspended = false;
+		_coroutine.Promise().Bind(TaskController::Current(), GetTaskId(), &suspended);
+		_coroutine.Resume();
+
+		return !suspended;
+	}
+};
+
+template<>
+class CoroutineTaskNode<void> :
+	public TaskBase,
+	public TaskFactory<CoroutineTaskNode<void>>
+{
+	using TaskCallable = std::function<TaskCoroutine<void>()>;
+
+	template<typename T, typename ...Args>
+	friend struct shared_enabler;
+
+	TaskCallable _callable;
+	TaskCoroutine<void> _coroutine;
+
+	explicit CoroutineTaskNode(TaskCallable callable) :
+		_callable(callable)
+	{
+	}
+public:
+	CoroutineTaskNode(const CoroutineTaskNode&) = delete;
+	CoroutineTaskNode& operator = (const CoroutineTaskNode&) = delete;
+
+	void ExecuteInt() override
+	{
+		ResumeInt();
+	}
+
+	const char* GetTypeName() const override
+	{
+		return "CoroutineTaskNode";
+	}
+
+protected:
+	bool ResumeInt() override
+	{
+		if (!_coroutine)
+		{
+			_coroutine = _callable();
+		}
+
+		bool suspended = false;
+		_coroutine.Promise().Bind(TaskController::Current(), GetTaskId(), &suspended);
+		_coroutine.Resume();
+
+		return !suspended;
+	}
+};
+
+//suspends until given task completes, task has to run in some graph
+template<typename OutputType>
+class TaskAwaiter
+{
+	TaskRef _task;
+
+public:
+	explicit TaskAwaiter(TaskRef task) :
+		_task(std::move(task))
+	{
+	}
+
+	bool await_ready()
+	{
+		return _task->IsCompleted();
+	}
+
+	template<typename Promise>
+	bool await_suspend(std::coroutine_handle<Promise> handle)
+	{
+		CoroutinePromiseBase& promise = handle.promise();
+		if (!_task->AddCompletionCallback(promise.Suspend()))
+		{
+			//completed meanwhile
+			promise.CancelSuspend();
+			return false;
+		}
+		return true;
+	}
+
+	OutputType await_resume()
+	{
+		if constexpr (!std::is_void<OutputType>::value)
+		{
+			auto resultGetter = std::dynamic_pointer_cast<TaskResult<OutputType>>(_task);
+			return resultGetter->GetResult();
+		}
+	}
+};
+
+//suspends until all tasks of sub graph are executed, they run as tasks spawned into graph running the coroutine
+//so no thread waits for them, sub graph is only container of tasks and edges, its WaitAll is not called
+class GraphAwaiter
+{
+	TaskGraph& _graph;
+
+public:
+	explicit GraphAwaiter(TaskGraph& graph) :
+		_graph(graph)
+	{
+	}
+
+	bool await_ready()
+	{
+		return false;
+	}
+
+	template<typename Promise>
+	bool await_suspend(std::coroutine_handle<Promise> handle)
+	{
+		CoroutinePromiseBase& promise = handle.promise();
+		TaskController& controller = promise.GetController();
+		if (!_graph.SpawnInto(controller, promise.Suspend()))
+		{
+			//empty graph
+			promise.CancelSuspend();
+			return false;
+		}
+		return true;
+	}
+
+	void await_resume()
+	{
+	}
+};
+
+//suspends until blocking call ( I/O, decoding ) is done on thread of bounded pool
+template<typename OutputType>
+class BlockingCallAwaiter
+{
+	IoThreadPool& _threads;
+	std::function<OutputType()> _callable;
+	std::optional<OutputType> _result;
+
+public:
+	BlockingCallAwaiter(IoThreadPool& threads, std::function<OutputType()> callable) :
+		_threads(threads),
+		_callable(std::move(callable))
+	{
+	}
+
+	bool await_ready()
+	{
+		return false;
+	}
+
+	template<typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> handle)
+	{
+		CoroutinePromiseBase& promise = handle.promise();
+		auto resume = promise.Suspend();
+
+		_threads.Post([this, resume]()
+		{
+			_result.emplace(_callable());
+			resume();
+		});
+	}
+
+	OutputType await_resume()
+	{
+		return std::move(*_result);
+	}
+};
+
+template<>
+class BlockingCallAwaiter<void>
+{
+	IoThreadPool& _threads;
+	std::function<void()> _callable;
+
+public:
+	BlockingCallAwaiter(IoThreadPool& threads, std::function<void()> callable) :
+		_threads(threads),
+		_callable(std::move(callable))
+	{
+	}
+
+	bool await_ready()
+	{
+		return false;
+	}
+
+	template<typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> handle)
+	{
+		CoroutinePromiseBase& promise = handle.promise();
+		auto resume = promise.Suspend();
+
+		_threads.Post([this, resume]()
+		{
+			_callable();
+			resume();
+		});
+	}
+
+	void await_resume()
+	{
+	}
+};
+
+//ParallelFor chunks spawned into graph running the coroutine, last chunk done resumes it
+template<typename OutputType>
+class ParallelForAwaiter
+{
+	unsigned int _chunksCount;
+	std::function<OutputType(unsigned int)> _callable;
+
+public:
+	template<typename CallableType>
+	ParallelForAwaiter(unsigned int chunksCount, CallableType&& callable) :
+		_chunksCount(chunksCount),
+		_callable(std::forward<CallableType>(callable))
+	{
+	}
+
+	bool await_ready()
+	{
+		return _chunksCount == 0;
+	}
+
+	template<typename Promise>
+	void await_suspend(std::coroutine_handle<Promise> handle)
+	{
+		CoroutinePromiseBase& promise = handle.promise();
+		TaskController& controller = promise.GetController();
+		auto remaining = std::make_shared<std::atomic<unsigned int>>(_chunksCount);
+		auto resume = std::make_shared<std::function<void()>>(promise.Suspend());
+
+		//coroutine may be resumed before loop ends, awaiter members are not used then
+		const unsigned int chunksCount = _chunksCount;
+		auto callable = _callable;
+		for (unsigned int chunk = 0; chunk < chunksCount; ++chunk)
+		{
+			auto task = ParallelTaskNode<OutputType>::create(chunk, callable);
+			task->AddCompletionCallback([remaining, resume]()
+			{
+				if (--*remaining == 0)
+				{
+					(*resume)();
+				}
+			});
+			controller.SignalTaskSpawned(std::move(task));
+		}
+	}
+
+	void await_resume()
+	{
+	}
+};
+
+template<typename OutputType = void>
+TaskAwaiter<OutputType> AwaitTask(TaskRef task)
+{
+	return TaskAwaiter<OutputType>(std::move(task));
+}
+
+inline GraphAwaiter AwaitGraph(TaskGraph& graph)
+{
+	return GraphAwaiter(graph);
+}
+
+//call runs on given pool, e.g. threads of IoExecutor
+template<typename CallableType>
+auto AwaitBlockingCall(IoThreadPool& threads, CallableType&& callable)
+{
+	using OutputType = decltype(callable());
+	return BlockingCallAwaiter<OutputType>(threads, std::forward<CallableType>(callable));
+}
+
+//call runs on shared pool of GetBlockingCallThreads
+template<typename CallableType>
+auto AwaitBlockingCall(CallableType&& callable)
+{
+	return AwaitBlockingCall(GetBlockingCallThreads(), std::forward<CallableType>(callable));
+}
+
+template <typename OutputType, typename CallableType>
+ParallelForAwaiter<OutputType> ParallelForAsync(unsigned int chunksCount, CallableType&& callable)
+{
+	return ParallelForAwaiter<OutputType>(chunksCount, std::forward<CallableType>(callable));
+}
+
+#endif
@@ -0,0 +1,250 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+//log linear histogram of non negative values, every power of two is split into 16 buckets
+//so any recorded value is known with relative error below 1/16
+class LatencyHistogram
+{
+	static const unsigned int SubBucketBits = 4;
+	static const unsigned long long SubBucketCount = 1ull << SubBucketBits;
+	static const size_t BucketsCount = (64 - SubBucketBits + 1) * SubBucketCount;
+
+	std::array<unsigned long long, BucketsCount> _counts{};
+	unsigned long long _totalCount{ 0 };
+	unsigned long long _min{ ~0ull };
+	unsigned long long _max{ 0 };
+	long double _sum{ 0 };
+
+public:
+	void Record(unsigned long long value, unsigned long long count = 1)
+	{
+		_counts[GetBucket(value)] += count;
+		_totalCount += count;
+		_min = std::min(_min, value);
+		_max = std::max(_max, value);
+		_sum += static_cast<long double>(value) * count;
+	}
+
+	void Merge(const LatencyHistogram& other)
+	{
+		for (size_t bucket = 0; bucket < BucketsCount; ++bucket)
+		{
+			_counts[bucket] += other._counts[bucket];
+		}
+		_totalCount += other._totalCount;
+		_min = std::min(_min, other._min);
+		_max = std::max(_max, other._max);
+		_sum += other._sum;
+	}
+
+	void Clear()
+	{
+		*this = LatencyHistogram();
+	}
+
+	unsigned long long GetCount() const
+	{
+		return _totalCount;
+	}
+
+	unsigned long long GetMin() const
+	{
+		return _totalCount ? _min : 0;
+	}
+
+	unsigned long long GetMax() const
+	{
+		return _max;
+	}
+
+	double GetMean() const
+	{
+		return _totalCount ? static_cast<double>(_sum / _totalCount) : 0;
+	}
+
+	//percentile in range 0 - 100, middle of bucket holding it
+	unsigned long long GetValueAtPercentile(double percentile) const
+	{
+		if (_totalCount == 0)
+		{
+			return 0;
+		}
+
+		const double clamped = std::min(100.0, std::max(0.0, percentile));
+		const unsigned long long rank = std::max(1ull, static_cast<unsigned long long>(clamped / 100.0 * _totalCount + 0.5));
+
+		unsigned long long seen = 0;
+		for (size_t bucket = 0; bucket < BucketsCount; ++bucket)
+		{
+			seen += _counts[bucket];
+			if (seen >= rank)
+			{
+				const auto value = GetBucketLowerBound(bucket) + GetBucketWidth(bucket) / 2;
+				return std::min(std::max(value, _min), _max);
+			}
+		}
+		return _max;
+	}
+
+	//calls visitor with lower bound, upper bound and count of non empty buckets
+	template<typename VisitorType>
+	void ForEachBucket(VisitorType&& visitor) const
+	{
+		for (size_t bucket = 0; bucket < BucketsCount; ++bucket)
+		{
+			if (_counts[bucket])
+			{
+				visitor(GetBucketLowerBound(bucket), GetBucketLowerBound(bucket) + GetBucketWidth(bucket) - 1, _counts[bucket]);
+			}
+		}
+	}
+
+private:
+	static size_t GetBucket(unsigned long long value)
+	{
+		if (value < SubBucketCount)
+		{
+			return static_cast<size_t>(value);
+		}
+
+		unsigned int highestBit = 63;
+		while (!(value >> highestBit))
+		{
+			--highestBit;
+		}
+
+		const unsigned int shift = highestBit - SubBucketBits;
+		return static_cast<size_t>((shift + 1) * SubBucketCount + ((value >> shift) - SubBucketCount));
+	}
+
+	static unsigned long long GetBucketLowerBound(size_t bucket)
+	{
+		if (bucket < SubBucketCount)
+		{
+			return bucket;
+		}
+
+		const unsigned int shift = static_cast<unsigned int>(bucket / SubBucketCount - 1);
+		return (SubBucketCount + bucket % SubBucketCount) << shift;
+	}
+
+	static unsigned long long GetBucketWidth(size_t bucket)
+	{
+		return bucket < 2 * SubBucketCount ? 1 : 1ull << (bucket / SubBucketCount - 1);
+	}
+};
+
+using LatencyHistograms = std::map<std::string, LatencyHistogram, std::less<>>;
+
+//execution times learned from previous runs, keyed by task name or node type when task has no name
+//can be shared by many graphs, all methods are thread safe
+class TaskCostModel
+{
+	struct ItemsCost
+	{
+		long double nanoseconds{ 0 };
+		unsigned long long items{ 0 };
+	};
+
+	mutable std::mutex _mutex;
+	LatencyHistograms _histograms;
+	std::map<std::string, ItemsCost, std::less<>> _itemsCosts;
+
+public:
+	void Record(std::string_view key, unsigned long long nanoseconds)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		GetHistogram(key).Record(nanoseconds);
+	}
+
+	//merge samples collected by worker, they are cleared
+	void Merge(LatencyHistograms& samples)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		for (auto& sample : samples)
+		{
+			GetHistogram(sample.first).Merge(sample.second);
+		}
+		samples.clear();
+	}
+
+	//copy of histogram, empty one when key is unknown
+	LatencyHistogram GetLatencyHistogram(std::string_view key) const
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		auto histogram = _histograms.find(key);
+		return histogram != _histograms.end() ? histogram->second : LatencyHistogram();
+	}
+
+	LatencyHistograms GetLatencyHistograms() const
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		return _histograms;
+	}
+
+	//mean execution time, fallback when nothing was recorded
+	double EstimateNanoseconds(std::string_view key, double fallback) const
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		auto histogram = _histograms.find(key);
+		return histogram != _histograms.end() && histogram->second.GetCount() ? histogram->second.GetMean() : fallback;
+	}
+
+	//time of work split into chunks of items, used for grain size selection
+	void RecordItems(std::string_view key, unsigned long long nanoseconds, unsigned long long items)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		auto cost = _itemsCosts.find(key);
+		if (cost == _itemsCosts.end())
+		{
+			cost = _itemsCosts.emplace(std::string(key), ItemsCost{}).first;
+		}
+		cost->second.nanoseconds += nanoseconds;
+		cost->second.items += items;
+	}
+
+	//zero when unknown
+	double EstimateItemNanoseconds(std::string_view key) const
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		auto cost = _itemsCosts.find(key);
+		return cost != _itemsCosts.end() && cost->second.items ? static_cast<double>(cost->second.nanoseconds / cost->second.items) : 0;
+	}
+
+	//chunks count so every chunk runs about targetChunkNanoseconds, scheduling cost is amortized
+	//without history every thread gets defaultChunksPerThread chunks
+	unsigned int SuggestChunksCount(std::string_view key, unsigned int itemsCount, unsigned int numThreads,
+		double targetChunkNanoseconds = 50000, unsigned int defaultChunksPerThread = 4) const
+	{
+		if (itemsCount == 0)
+		{
+			return 0;
+		}
+
+		const double itemNanoseconds = EstimateItemNanoseconds(key);
+		double chunksCount = itemNanoseconds > 0 ?
+			itemNanoseconds * itemsCount / targetChunkNanoseconds :
+			static_cast<double>(numThreads) * defaultChunksPerThread;
+
+		chunksCount = std::max(1.0, std::min(chunksCount, static_cast<double>(itemsCount)));
+		return static_cast<unsigned int>(chunksCount);
+	}
+
+private:
+	//locked from outside
+	LatencyHistogram& GetHistogram(std::string_view key)
+	{
+		auto histogram = _histograms.find(key);
+		if (histogram == _histograms.end())
+		{
+			histogram = _histograms.emplace(std::string(key), LatencyHistogram()).first;
+		}
+		return histogram->second;
+	}
+};
@@ -1,19 +1,25 @@
 #pragma once
 #include "task_base.h"
+#include "task_profile.h"
+#include "task_graph_export.h"
+#include "task_monitor.h"
 #include <set>
 #include <queue>
 #include <unordered_set>
+#include <unordered_map>
+#include <map>
+#include <iostream>
+#include <stdexcept>
 
 class WorkerThread
 {
 	unsigned int _threadNumber{ 0 };
-	const TasksCollection& _tasksData;
-	std::queue<TaskId>  _tasks{};
+	std::queue<TaskRef>  _tasks{};
 	std::shared_ptr<TaskController> _controller;
+	std::thread _thread;
 public:
-	explicit WorkerThread(TasksCollection& tasksData, unsigned int threadNumber) :
-		_threadNumber(threadNumber),
-		_tasksData(tasksData)
+	explicit WorkerThread(unsigned int threadNumber) :
+		_threadNumber(threadNumber)
 	{
 	}
 
@@ -24,12 +30,12 @@ public:
 	WorkerThread&  operator=(WorkerThread&& other) = delete;
 
 	WorkerThread(WorkerThread&& other):
-		_threadNumber(other._threadNumber),
-		_tasksData(other._tasksData)
+		_threadNumber(other._threadNumber)
 	{		
 		_tasks.swap(other._tasks);
 		
 		_controller.swap(other._controller);		
+		_thread.swap(other._thread);
 	}
 
 	void SetController(std::shared_ptr<TaskController>& controller)
@@ -39,16 +45,41 @@ public:
 
 	void Start()
 	{
-		std::thread th(&WorkerThread::DoJobs, this);
+		_thread = std::thread(&WorkerThread::DoJobs, this);
 		//Some OS specific code here that sets thread to concrete CPU
-		th.detach();
+	}
+
+	void Join()
+	{
+		if (_thread.joinable())
+		{
+			_thread.join();
+		}
 	}
 
 private:
 	void DoJobs()
 	{
+		TaskController::Current() = _controller.get();
+		TaskTracer* tracer = _controller->GetTracer();
+		const bool profiling = _controller->IsProfiling();
+		TaskCostModel* costModel = _controller->GetCostModel();
+
+		//counters are per thread, every worker opens its own
+		std::unique_ptr<PerfCounterGroup> perfCounters;
+		if (_controller->IsCountingPerfCounters())
+		{
+			perfCounters = std::make_unique<PerfCounterGroup>();
+			if (!perfCounters->IsValid())
+			{
+				perfCounters.reset();
+			}
+		}
+
 		while (true)
 		{
+			_controller->FlushCostSamples(_threadNumber);
+
 			//wait for more tasks or if done
 			bool readyToExit = _controller->WaitForTaskOrDone(_threadNumber);
 			if (readyToExit)
@@ -59,7 +90,7 @@ private:
 
 			while (true)
 			{
-				_tasks.swap(_controller->GetSomeTaskJobs(_threadNumber));
+				_tasks = _controller->GetSomeTaskJobs(_threadNumber);
 				if (_tasks.empty())
 				{
 					//no tasks available wait for more
@@ -67,22 +98,48 @@ private:
 				}
 
 				//process tasks
+				const size_t tasksCount = _tasks.size();
 				std::vector<TaskId> readyTasks;
 				while (!_tasks.empty())
 				{
 					//get next task
-					TaskId taskId = _tasks.front();
+					TaskRef task = std::move(_tasks.front());
 					_tasks.pop();
 
-					auto it = _tasksData.find(taskId);
-					if (it != _tasksData.end())
+					const bool timed = tracer || profiling || costModel;
+					const long long begin = timed ? SteadyClockNanoseconds() : 0;
+					const PerfCounterValues countersBegin = perfCounters ? perfCounters->Read() : PerfCounterValues{};
+					const bool completed = task->Run();
+
+					if (timed)
+					{
+						const long long end = SteadyClockNanoseconds();
+						if (tracer)
+						{
+							tracer->RecordTask(_threadNumber, task->GetTaskId(), tracer->FromSteadyClock(begin), tracer->FromSteadyClock(end));
+						}
+						if (costModel)
+						{
+							_controller->RecordCost(_threadNumber, GetTaskCostKey(*task), end - begin);
+						}
+						if (profiling)
+						{
+							const PerfCounterValues counters = perfCounters ? perfCounters->Read() - countersBegin : PerfCounterValues{};
+							_controller->RecordExecution(_threadNumber, { task->GetTaskId(), begin, end, counters });
+						}
+					}
+
+					if (!completed)
 					{
-						it->second->Run();
+						//suspended, it will be resumed by whatever it waits for
+						continue;
 					}
+					task->Complete();
 								
-					readyTasks.push_back(taskId);
+					readyTasks.push_back(task->GetTaskId());
 				}
-				_controller->SignalTasksReady(std::move(readyTasks));
+				_controller->RecordExecutedTasks(_threadNumber, tasksCount);
+				_controller->PublishCompletedTasks(_threadNumber, readyTasks);
 			}
 	
 		}
@@ -90,7 +147,7 @@ private:
 	}
 };
 
-unsigned int GetNumberOfCPUs()
+inline unsigned int GetNumberOfCPUs()
 {
 	auto hardwareConcurrency = std::thread::hardware_concurrency();
 	//hardware_concurrency returns zero sometimes handle it 
@@ -106,7 +163,22 @@ class TaskGraph
 	std::vector<TaskId> _pendingTasks;
 	std::vector<TaskId> _completedTasks;
 	std::map<TaskId, std::vector<TaskId>> _taskChildren;
+	std::unordered_set<TaskId> _spawnedTasks;
 	std::vector<WorkerThread> _workerThreads;
+	std::atomic<unsigned int> _retainCount{ 0 };
+
+	std::function<void(const SchedulerStatistics&)> _statisticsCallback;
+	std::chrono::steady_clock::duration _statisticsPeriod{ 0 };
+	std::chrono::steady_clock::time_point _nextStatisticsSnapshot;
+
+	ExecutionProfile _profile;
+
+	//off by default, samples queue depths on its own thread while WaitAll runs
+	std::unique_ptr<QueueMonitor> _queueMonitor;
+
+	//remaining critical path of every task estimated by cost model
+	std::shared_ptr<TaskCostModel> _costModel;
+	std::unordered_map<TaskId, double> _priorities;
 	
 public:
 	TaskGraph(unsigned int runningTasks = GetNumberOfCPUs()):
@@ -145,6 +217,113 @@ public:
 		}
 	}
 
+	//add task while graph is running, can be called from any task of this graph
+	//before WaitAll use AddTask
+	void SpawnTask(TaskRef task)
+	{
+		_taskController->SignalTaskSpawned(std::move(task));
+	}
+
+	//run tasks of this graph inside of other running graph, as tasks spawned there, instead of own workers and WaitAll
+	//child is spawned by worker completing its parent once CanRun allows it, onDone is called after last task completes
+	//returns false when there is nothing to run, onDone is not called then
+	bool SpawnInto(TaskController& controller, std::function<void()> onDone)
+	{
+		if (_tasks.empty())
+		{
+			return false;
+		}
+
+		struct SpawnState
+		{
+			std::mutex mutex;
+			TasksCollection tasks;
+			std::map<TaskId, std::vector<TaskId>> children;
+			size_t remaining{ 0 };
+			std::function<void()> onDone;
+		};
+
+		for (const auto& task : _tasks)
+		{
+			if (task.second->IsCompleted())
+			{
+				throw std::invalid_argument("Graph spawned into other graph was already run");
+			}
+		}
+
+		auto state = std::make_shared<SpawnState>();
+		state->tasks = _tasks;
+		state->children = _taskChildren;
+		state->remaining = _tasks.size();
+		state->onDone = std::move(onDone);
+
+		TaskController* target = &controller;
+		for (const auto& task : _tasks)
+		{
+			const TaskId taskId = task.first;
+			task.second->AddCompletionCallback([state, target, taskId]()
+			{
+				std::vector<TaskRef> readyTasks;
+				bool done = false;
+				{
+					//CanRun of join tasks is not thread safe, parents may complete on different workers
+					std::unique_lock<std::mutex> lock(state->mutex);
+					auto children = state->children.find(taskId);
+					if (children != state->children.end())
+					{
+						for (auto childId : children->second)
+						{
+							const TaskRef& child = state->tasks.at(childId);
+							if (child->CanRun(taskId))
+							{
+								readyTasks.push_back(child);
+							}
+						}
+					}
+					done = --state->remaining == 0;
+				}
+
+				for (auto& readyTask : readyTasks)
+				{
+					target->SignalTaskSpawned(std::move(readyTask));
+				}
+				if (done)
+				{
+					state->onDone();
+				}
+			});
+		}
+
+		//first root may complete whole graph and resume owner, which can destroy this graph, so roots are copied first
+		std::vector<TaskRef> roots;
+		roots.reserve(_pendingTasks.size());
+		for (auto taskId : _pendingTasks)
+		{
+			roots.push_back(_tasks.at(taskId));
+		}
+		for (auto& root : roots)
+		{
+			controller.SignalTaskSpawned(std::move(root));
+		}
+		return true;
+	}
+
+	//keep WaitAll running even when all tasks are done, tasks can be spawned meanwhile
+	//calls nest, every Retain needs its Release
+	void Retain()
+	{
+		++_retainCount;
+	}
+
+	//let WaitAll return once all tasks are done and nobody else retains graph
+	void Release()
+	{
+		if (--_retainCount == 0)
+		{
+			_taskController->SignalWakeUp();
+		}
+	}
+
 	void PrintTasksExecution()
 	{
 		std::queue<TaskId> tasksOrder;
@@ -177,12 +356,171 @@ public:
 		}
 	}
 
+	CompletionBatchStatistics GetCompletionBatchStatistics() const
+	{
+		return _taskController->GetCompletionBatchStatistics();
+	}
+
+	//per worker counters, they are collected all the time and accumulate over WaitAll calls
+	SchedulerStatistics GetStatistics() const
+	{
+		return _taskController->GetStatistics();
+	}
+
+	void ResetStatistics()
+	{
+		_taskController->ResetStatistics();
+	}
+
+	//callback gets statistics snapshot on coordinator thread every period while WaitAll runs
+	//empty callback disables it, call it outside of WaitAll
+	void SetStatisticsCallback(std::function<void(const SchedulerStatistics&)> callback, std::chrono::milliseconds period)
+	{
+		_statisticsCallback = std::move(callback);
+		_statisticsPeriod = _statisticsCallback ? period : std::chrono::milliseconds(0);
+		_taskController->SetWakeUpPeriod(_statisticsPeriod);
+	}
+
+	//sample worker queues, pending and ready tasks every period of next WaitAll calls
+	//samples accumulate over calls, oldest are dropped above maxSamples
+	//call it outside of WaitAll
+	QueueMonitor& EnableQueueMonitor(std::chrono::milliseconds period, size_t maxSamples = 1 << 16)
+	{
+		_queueMonitor = std::make_unique<QueueMonitor>(*_taskController, period, maxSamples);
+		return *_queueMonitor;
+	}
+
+	void DisableQueueMonitor()
+	{
+		_queueMonitor.reset();
+	}
+
+	//null when monitor is disabled
+	const QueueMonitor* GetQueueMonitor() const
+	{
+		return _queueMonitor.get();
+	}
+
+	//record task durations and graph of next WaitAll calls for AnalyzeExecution
+	//call it outside of WaitAll
+	void EnableProfiling(bool enable = true)
+	{
+		_taskController->SetProfiling(enable);
+	}
+
+	//profile of last WaitAll, empty when profiling was disabled
+	const ExecutionProfile& GetExecutionProfile() const
+	{
+		return _profile;
+	}
+
+	ExecutionReport AnalyzeLastExecution() const
+	{
+		return AnalyzeExecution(_profile);
+	}
+
+	//count cycles, instructions, LLC and branch misses of every task, enables profiling too
+	//returns false when hardware counters are not available ( not Linux, no permission, VM )
+	bool EnablePerfCounters(bool enable = true)
+	{
+		_taskController->SetPerfCounters(enable);
+		if (enable)
+		{
+			_taskController->SetProfiling(true);
+		}
+		return enable && PerfCountersAvailable();
+	}
+
+	PerfCounterReport AnalyzePerfCounters() const
+	{
+		return AggregatePerfCounters(_profile);
+	}
+
+	//learn execution times of tasks by name or type into model, model can be shared by graphs
+	//pending tasks are then scheduled by longest estimated remaining critical path first
+	//call it outside of WaitAll, nullptr disables it
+	void SetCostModel(std::shared_ptr<TaskCostModel> costModel)
+	{
+		_costModel = costModel;
+		_taskController->SetCostModel(std::move(costModel));
+	}
+
+	std::shared_ptr<TaskCostModel> GetCostModel() const
+	{
+		return _costModel;
+	}
+
+	//structure of graph before WaitAll, use DescribeExecution for graph after run
+	GraphDescription DescribeGraph() const
+	{
+		GraphDescription description;
+		for (const auto& task : _tasks)
+		{
+			auto& node = description.nodes[task.first];
+			node.taskId = task.first;
+			node.name = task.second->GetName();
+			node.typeName = task.second->GetTypeName();
+		}
+		description.children = _taskChildren;
+		return description;
+	}
+
+	//record timeline of next WaitAll calls, call it outside of WaitAll
+	//every worker keeps last eventsPerThread events
+	void EnableTracing(size_t eventsPerThread = 1 << 16)
+	{
+		_taskController->EnableTracing(eventsPerThread);
+	}
+
+	void DisableTracing()
+	{
+		_taskController->DisableTracing();
+	}
+
+	//nullptr when tracing is disabled
+	const TaskTracer* GetTracer() const
+	{
+		return _taskController->GetTracer();
+	}
+
+	//tasks are named when profiling was enabled too
+	bool SaveChromeTrace(const std::string& fileName) const
+	{
+		auto tracer = _taskController->GetTracer();
+		return tracer && tracer->SaveChromeTrace(fileName, [this](TaskId taskId)
+		{
+			auto task = _profile.tasks.find(taskId);
+			return task != _profile.tasks.end() ? task->second.name : std::string();
+		});
+	}
+
 	void WaitAll()
 	{		
+		_profile.Clear();
+		if (_taskController->IsProfiling())
+		{
+			_profile.numThreads = _maxRunningTasks;
+			_profile.begin = SteadyClockNanoseconds();
+		}
+
+		ComputeTaskPriorities();
+
 		StartWorkerThreads();
 
-		while (!AllTasksDone())
+		if (_queueMonitor)
+		{
+			_queueMonitor->Start();
+		}
+
+		_nextStatisticsSnapshot = std::chrono::steady_clock::now() + _statisticsPeriod;
+
+		while (!AllTasksDone() || _retainCount > 0)
 		{
+			if (_queueMonitor)
+			{
+				_taskController->PublishCoordinatorQueues(_pendingTasks.size(), _tasks.size() - _completedTasks.size());
+			}
+
 			if (HasPendingTasks())
 			{
 				SchedulePendingTasks();
@@ -191,6 +529,8 @@ public:
 			{
 				WaitForReadyTasks();
 			}
+
+			ReportStatistics();
 		}
 
 		//shutdown threads
@@ -206,25 +546,83 @@ private:
 		_pendingTasks.clear();
 		_completedTasks.clear();
 		_taskChildren.clear();
+		_spawnedTasks.clear();
 		_workerThreads.clear();
+		_priorities.clear();
+	}
+
+	void ReportStatistics()
+	{
+		if (!_statisticsCallback)
+		{
+			return;
+		}
+
+		const auto now = std::chrono::steady_clock::now();
+		if (now < _nextStatisticsSnapshot)
+		{
+			return;
+		}
+
+		_nextStatisticsSnapshot = now + _statisticsPeriod;
+		_statisticsCallback(_taskController->GetStatistics());
 	}
 
 	void DoneAndExit()
 	{
 		_taskController->SignalReadyToExit();
-		//wait some time for worker threads to exit
-		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+		for (auto& wt : _workerThreads)
+		{
+			wt.Join();
+		}
+
+		if (_queueMonitor)
+		{
+			_queueMonitor->Stop();
+			_taskController->PublishCoordinatorQueues(0, 0);
+		}
+
+		CollectProfile();
 
 		CleanUp();		
 	}
 
+	//graph is gone after CleanUp, keep what analysis needs
+	void CollectProfile()
+	{
+		if (!_taskController->IsProfiling())
+		{
+			return;
+		}
+
+		_profile.end = SteadyClockNanoseconds();
+		for (unsigned int threadNumber = 0; threadNumber < _maxRunningTasks; ++threadNumber)
+		{
+			for (const auto& record : _taskController->TakeExecutions(threadNumber))
+			{
+				_profile.AddExecution(threadNumber, record);
+			}
+		}
+
+		for (const auto& task : _tasks)
+		{
+			_profile.AddTaskDescription(*task.second);
+		}
+
+		for (const auto& children : _taskChildren)
+		{
+			_profile.children.insert(children);
+		}
+	}
+
 	void StartWorkerThreads()
 	{		
 		_workerThreads.clear();
 
 		for (unsigned threadIndex = 0; threadIndex < _maxRunningTasks; ++threadIndex)
 		{				
-			WorkerThread wth(_tasks, threadIndex);
+			WorkerThread wth(threadIndex);
 			wth.SetController(_taskController);
 
 			_workerThreads.push_back(std::move(wth));
@@ -277,7 +675,13 @@ private:
 	{
 		//fetch ready task children
 		//actualy do BFS kind traversal of graph
-		for (auto taskChildId : _taskChildren[taskId])
+		auto children = _taskChildren.find(taskId);
+		if (children == _taskChildren.end())
+		{
+			return;
+		}
+
+		for (auto taskChildId : children->second)
 		{
 			if (_tasks[taskChildId]->CanRun(taskId))
 			{
@@ -288,19 +692,128 @@ private:
 
 	void WaitForReadyTasks()
 	{
-		auto readyTasks = move(_taskController->WaitTillReadyTask());
+		std::vector<TaskId> resumedTasks;
+		std::vector<TaskRef> spawnedTasks;
+		auto readyTasks = move(_taskController->WaitTillReadyTask(resumedTasks, spawnedTasks));
+
+		//tasks spawned by running tasks, register them before their parents complete
+		for (auto& spawnedTask : spawnedTasks)
+		{
+			_spawnedTasks.emplace(spawnedTask->GetTaskId());
+			AddTask(spawnedTask);
+		}
 
 		//fetch next tasks
 		for(auto readyTaskId:readyTasks)
 		{
 			FetchTaskChildren(readyTaskId);
 
+			if (_spawnedTasks.erase(readyTaskId))
+			{
+				//spawned tasks are dropped once done so long running graphs do not grow
+				if (_taskController->IsProfiling())
+				{
+					_profile.AddTaskDescription(*_tasks[readyTaskId]);
+
+					auto children = _taskChildren.find(readyTaskId);
+					if (children != _taskChildren.end())
+					{
+						_profile.children.insert(*children);
+					}
+				}
+				_tasks.erase(readyTaskId);
+				_taskChildren.erase(readyTaskId);
+				continue;
+			}
+
 			CompleteTask(readyTaskId);
-		}		
+		}
+
+		//suspended tasks waiting to continue
+		for (auto resumedTaskId : resumedTasks)
+		{
+			AddToPendingTasks(resumedTaskId);
+		}
+	}
+
+	double EstimateTaskCost(TaskId taskId) const
+	{
+		auto task = _tasks.find(taskId);
+		return task != _tasks.end() ? _costModel->EstimateNanoseconds(GetTaskCostKey(*task->second), 1.0) : 1.0;
+	}
+
+	//bottom level of every task, its cost plus longest path of children
+	void ComputeTaskPriorities()
+	{
+		_priorities.clear();
+		if (!_costModel)
+		{
+			return;
+		}
+
+		//iterative post order, long chains would overflow stack
+		std::vector<std::pair<TaskId, bool>> stack;
+		for (const auto& task : _tasks)
+		{
+			stack.emplace_back(task.first, false);
+			while (!stack.empty())
+			{
+				const auto taskId = stack.back().first;
+				if (_priorities.count(taskId))
+				{
+					stack.pop_back();
+					continue;
+				}
+
+				auto children = _taskChildren.find(taskId);
+				if (!stack.back().second)
+				{
+					stack.back().second = true;
+					if (children != _taskChildren.end())
+					{
+						for (auto childId : children->second)
+						{
+							if (!_priorities.count(childId))
+							{
+								stack.emplace_back(childId, false);
+							}
+						}
+					}
+					continue;
+				}
+
+				stack.pop_back();
+				double longestChildPath = 0;
+				if (children != _taskChildren.end())
+				{
+					for (auto childId : children->second)
+					{
+						longestChildPath = std::max(longestChildPath, _priorities[childId]);
+					}
+				}
+				_priorities[taskId] = EstimateTaskCost(taskId) + longestChildPath;
+			}
+		}
+	}
+
+	double GetTaskPriority(TaskId taskId) const
+	{
+		auto priority = _priorities.find(taskId);
+		//spawned tasks are not known up front
+		return priority != _priorities.end() ? priority->second : EstimateTaskCost(taskId);
 	}
 
 	void SchedulePendingTasks()
 	{		
+		if (_costModel)
+		{
+			//workers take jobs from front of their queues
+			std::stable_sort(_pendingTasks.begin(), _pendingTasks.end(), [this](TaskId first, TaskId second)
+			{
+				return GetTaskPriority(first) > GetTaskPriority(second);
+			});
+		}
+
 		_taskController->AddTaskJobs(move(_pendingTasks), _tasks);
 
 		_pendingTasks.clear();
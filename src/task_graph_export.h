@@ -0,0 +1,286 @@
+#pragma once
+#include "task_profile.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <locale>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct GraphNodeDescription
+{
+	TaskId taskId{ 0 };
+	std::string name;
+	std::string typeName;
+	//nanoseconds, negative when not measured
+	long long duration{ -1 };
+	unsigned int worker{ 0 };
+};
+
+//graph structure with optional runtime data, input of exporters
+struct GraphDescription
+{
+	std::map<TaskId, GraphNodeDescription> nodes;
+	std::map<TaskId, std::vector<TaskId>> children;
+	std::vector<TaskId> criticalPath;
+};
+
+//executed graph with durations and critical path
+inline GraphDescription DescribeExecution(const ExecutionProfile& profile)
+{
+	GraphDescription description;
+	for (const auto& task : profile.tasks)
+	{
+		auto& node = description.nodes[task.first];
+		node.taskId = task.first;
+		node.name = task.second.name;
+		node.typeName = task.second.typeName;
+		node.duration = task.second.runs > 0 ? task.second.duration : -1;
+		node.worker = task.second.worker;
+	}
+	description.children = profile.children;
+	description.criticalPath = AnalyzeExecution(profile).criticalPath;
+	return description;
+}
+
+class GraphExporter
+{
+	const GraphDescription& _description;
+	std::map<TaskId, unsigned int> _parentsCount;
+	std::set<std::pair<TaskId, TaskId>> _criticalEdges;
+	std::set<TaskId> _criticalNodes;
+	long long _maxDuration{ 0 };
+
+public:
+	explicit GraphExporter(const GraphDescription& description) :
+		_description(description)
+	{
+		for (const auto& edges : _description.children)
+		{
+			for (auto child : edges.second)
+			{
+				++_parentsCount[child];
+			}
+		}
+
+		for (size_t index = 0; index < _description.criticalPath.size(); ++index)
+		{
+			_criticalNodes.insert(_description.criticalPath[index]);
+			if (index > 0)
+			{
+				_criticalEdges.emplace(_description.criticalPath[index - 1], _description.criticalPath[index]);
+			}
+		}
+
+		for (const auto& node : _description.nodes)
+		{
+			_maxDuration = std::max(_maxDuration, node.second.duration);
+		}
+	}
+
+	//graphviz, nodes colored from green to red by duration, critical path drawn bold
+	void WriteDot(std::ostream& out) const
+	{
+		//numbers are written in classic locale, so ids and durations get no grouping separators
+		const auto locale = out.imbue(std::locale::classic());
+		out << "digraph TaskGraph {\n";
+		out << "\tnode [shape=box, style=filled, fontname=\"Helvetica\"];\n";
+
+		for (const auto& node : _description.nodes)
+		{
+			out << "\tt" << node.first << " [label=\"" << EscapeDot(GetLabel(node.second)) << "\"";
+			out << ", fillcolor=\"" << GetColor(node.second) << "\"";
+			if (_criticalNodes.count(node.first))
+			{
+				out << ", penwidth=3";
+			}
+			out << "];\n";
+		}
+
+		ForEachEdge([&](TaskId parent, TaskId child)
+		{
+			out << "\tt" << parent << " -> t" << child;
+			if (_criticalEdges.count({ parent, child }))
+			{
+				out << " [color=\"red\", penwidth=3]";
+			}
+			out << ";\n";
+		});
+
+		out << "}\n";
+		out.imbue(locale);
+	}
+
+	void WriteGraphML(std::ostream& out) const
+	{
+		const auto locale = out.imbue(std::locale::classic());
+		out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+		out << "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n";
+		out << "\t<key id=\"name\" for=\"node\" attr.name=\"name\" attr.type=\"string\"/>\n";
+		out << "\t<key id=\"type\" for=\"node\" attr.name=\"type\" attr.type=\"string\"/>\n";
+		out << "\t<key id=\"duration\" for=\"node\" attr.name=\"duration_ns\" attr.type=\"long\"/>\n";
+		out << "\t<key id=\"worker\" for=\"node\" attr.name=\"worker\" attr.type=\"int\"/>\n";
+		out << "\t<key id=\"fanin\" for=\"node\" attr.name=\"fan_in\" attr.type=\"int\"/>\n";
+		out << "\t<key id=\"color\" for=\"node\" attr.name=\"color\" attr.type=\"string\"/>\n";
+		out << "\t<key id=\"critical\" for=\"all\" attr.name=\"critical\" attr.type=\"boolean\"/>\n";
+		out << "\t<graph id=\"TaskGraph\" edgedefault=\"directed\">\n";
+
+		for (const auto& node : _description.nodes)
+		{
+			out << "\t\t<node id=\"t" << node.first << "\">\n";
+			out << "\t\t\t<data key=\"name\">" << EscapeXml(GetDisplayName(node.second)) << "</data>\n";
+			out << "\t\t\t<data key=\"type\">" << EscapeXml(node.second.typeName) << "</data>\n";
+			if (node.second.duration >= 0)
+			{
+				out << "\t\t\t<data key=\"duration\">" << node.second.duration << "</data>\n";
+				out << "\t\t\t<data key=\"worker\">" << node.second.worker << "</data>\n";
+			}
+			out << "\t\t\t<data key=\"fanin\">" << GetParentsCount(node.first) << "</data>\n";
+			out << "\t\t\t<data key=\"color\">" << GetColor(node.second) << "</data>\n";
+			out << "\t\t\t<data key=\"critical\">" << (_criticalNodes.count(node.first) ? "true" : "false") << "</data>\n";
+			out << "\t\t</node>\n";
+		}
+
+		ForEachEdge([&](TaskId parent, TaskId child)
+		{
+			out << "\t\t<edge source=\"t" << parent << "\" target=\"t" << child << "\">\n";
+			out << "\t\t\t<data key=\"critical\">" << (_criticalEdges.count({ parent, child }) ? "true" : "false") << "</data>\n";
+			out << "\t\t</edge>\n";
+		});
+
+		out << "\t</graph>\n";
+		out << "</graphml>\n";
+		out.imbue(locale);
+	}
+
+private:
+	//edges between known nodes only
+	template<typename VisitorType>
+	void ForEachEdge(VisitorType&& visitor) const
+	{
+		for (const auto& edges : _description.children)
+		{
+			if (_description.nodes.find(edges.first) == _description.nodes.end())
+			{
+				continue;
+			}
+			for (auto child : edges.second)
+			{
+				if (_description.nodes.find(child) != _description.nodes.end())
+				{
+					visitor(edges.first, child);
+				}
+			}
+		}
+	}
+
+	unsigned int GetParentsCount(TaskId taskId) const
+	{
+		auto count = _parentsCount.find(taskId);
+		return count != _parentsCount.end() ? count->second : 0;
+	}
+
+	static std::string GetDisplayName(const GraphNodeDescription& node)
+	{
+		return node.name.empty() ? "task " + std::to_string(node.taskId) : node.name;
+	}
+
+	std::string GetLabel(const GraphNodeDescription& node) const
+	{
+		std::string label = GetDisplayName(node) + "\n" + node.typeName;
+		if (node.duration >= 0)
+		{
+			std::ostringstream duration;
+			duration.imbue(std::locale::classic());
+			duration << std::fixed << std::setprecision(1) << node.duration / 1000.0 << " us";
+			label += "\n" + duration.str();
+		}
+
+		const auto parentsCount = GetParentsCount(node.taskId);
+		if (parentsCount > 1)
+		{
+			label += "\nfan-in " + std::to_string(parentsCount);
+		}
+		return label;
+	}
+
+	//hsv color, green for short red for the longest task, white when not measured
+	std::string GetColor(const GraphNodeDescription& node) const
+	{
+		if (node.duration < 0 || _maxDuration <= 0)
+		{
+			return "#ffffff";
+		}
+
+		const double ratio = static_cast<double>(node.duration) / _maxDuration;
+		const double hue = 0.333 * (1.0 - ratio);
+		//std::to_string follows C locale, which may use decimal comma
+		std::ostringstream color;
+		color.imbue(std::locale::classic());
+		color << std::fixed << std::setprecision(3) << hue << " 0.600 1.000";
+		return color.str();
+	}
+
+	static std::string EscapeDot(const std::string& text)
+	{
+		std::string escaped;
+		for (auto character : text)
+		{
+			if (character == '\n')
+			{
+				escaped += "\\n";
+				continue;
+			}
+			if (character == '"' || character == '\\')
+			{
+				escaped += '\\';
+			}
+			escaped += character;
+		}
+		return escaped;
+	}
+
+	static std::string EscapeXml(const std::string& text)
+	{
+		std::string escaped;
+		for (auto character : text)
+		{
+			switch (character)
+			{
+			case '&': escaped += "&amp;"; break;
+			case '<': escaped += "&lt;"; break;
+			case '>': escaped += "&gt;"; break;
+			case '"': escaped += "&quot;"; break;
+			case '\'': escaped += "&apos;"; break;
+			default: escaped += character; break;
+			}
+		}
+		return escaped;
+	}
+};
+
+inline bool SaveDot(const GraphDescription& description, const std::string& fileName)
+{
+	std::ofstream out(fileName, std::ios::out | std::ios::binary);
+	if (!out)
+	{
+		return false;
+	}
+	GraphExporter(description).WriteDot(out);
+	return static_cast<bool>(out);
+}
+
+inline bool SaveGraphML(const GraphDescription& description, const std::string& fileName)
+{
+	std::ofstream out(fileName, std::ios::out | std::ios::binary);
+	if (!out)
+	{
+		return false;
+	}
+	GraphExporter(description).WriteGraphML(out);
+	return static_cast<bool>(out);
+}
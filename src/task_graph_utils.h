@@ -48,10 +48,11 @@ void ParallelFor(TaskGraph& graph, unsigned int chunksCount, CallableType&& call
 
 	for (unsigned int taskNumber = 0; taskNumber < chunksCount; ++taskNumber)
 	{
+		//every chunk gets its own copy, forwarding would leave later chunks with moved from callable
 		auto task = ParallelTaskNode<OutputType>::create
 			(
 				taskNumber,
-				std::forward<CallableType>(callable)
+				callable
 		);
 		
 		if (affinity.HasAffinity())
@@ -68,6 +69,44 @@ void ParallelFor(TaskGraph& graph, unsigned int chunksCount, CallableType&& call
 	}
 }
 
+//items are split into chunks sized by item cost learned in model under given name
+//callable gets range of items [begin, end), returns chunks count used
+template <typename CallableType>
+unsigned int ParallelForAdaptive(TaskGraph& graph, TaskCostModel& model, const std::string& name, unsigned int itemsCount,
+	CallableType&& callable, unsigned int numThreads = GetNumberOfCPUs(), double targetChunkNanoseconds = 50000)
+{
+	const unsigned int chunksCount = model.SuggestChunksCount(name, itemsCount, numThreads, targetChunkNanoseconds);
+	if (chunksCount == 0)
+	{
+		return 0;
+	}
+
+	std::function<void(unsigned int, unsigned int)> rangeCallable = std::forward<CallableType>(callable);
+
+	for (unsigned int chunk = 0; chunk < chunksCount; ++chunk)
+	{
+		const unsigned int begin = static_cast<unsigned int>(static_cast<unsigned long long>(itemsCount) * chunk / chunksCount);
+		const unsigned int end = static_cast<unsigned int>(static_cast<unsigned long long>(itemsCount) * (chunk + 1) / chunksCount);
+
+		auto task = ParallelTaskNode<int>::create
+			(
+				chunk,
+				[&model, name, rangeCallable, begin, end](unsigned int)
+				{
+					const long long start = SteadyClockNanoseconds();
+					rangeCallable(begin, end);
+					model.RecordItems(name, SteadyClockNanoseconds() - start, end - begin);
+					return 0;
+				}
+			);
+		task->SetName(name);
+
+		graph.AddTask(task);
+	}
+
+	return chunksCount;
+}
+
 template <typename OutputType, int numThreads = 5, typename CallableType>
 void ParallelFor(unsigned int chunksCount, CallableType&& callable, TaskAffinity&& affinity = {})
 {
@@ -91,7 +130,7 @@ TaskRef ParallelReduce(TaskGraph& graph, TaskRef& parent, unsigned int chnksCoun
 		auto task = ParallelTaskNode<OutputType>::create
 			(
 				taskNumber,
-				std::forward<CallableType>(callable)
+				callable
 				);
 
 		if (affinity.HasAffinity())
@@ -127,6 +166,177 @@ TaskRef ParallelReduce(TaskGraph& graph, TaskRef& parent, unsigned int chnksCoun
 	return reduceTask;
 }
 
+//rectangle [x0, x1) x [y0, y1) of 2D range
+struct TileRange
+{
+	unsigned int x0{ 0 };
+	unsigned int y0{ 0 };
+	unsigned int x1{ 0 };
+	unsigned int y1{ 0 };
+};
+
+//2D range split into tiles, tasksCount tasks take next tile from shared counter when done with previous one
+//so regions of uneven cost ( e.g. fractal ) are balanced without knowing the cost up front
+//callable gets TileRange, returns join task done after all tiles, chained after parent when given
+template <typename CallableType>
+TaskRef ParallelForTiles(TaskGraph& graph, TaskRef& parent, unsigned int width, unsigned int height,
+	unsigned int tileWidth, unsigned int tileHeight, CallableType&& callable, unsigned int tasksCount = GetNumberOfCPUs())
+{
+	tileWidth = std::max(1u, tileWidth);
+	tileHeight = std::max(1u, tileHeight);
+	const unsigned int tilesInRow = (width + tileWidth - 1) / tileWidth;
+	const unsigned int tilesCount = tilesInRow * ((height + tileHeight - 1) / tileHeight);
+	tasksCount = std::max(1u, std::min(tasksCount, tilesCount));
+
+	auto nextTile = std::make_shared<std::atomic<unsigned int>>(0);
+	std::function<void(const TileRange&)> tileCallable = std::forward<CallableType>(callable);
+
+	return ParallelReduce<int>(graph, parent, tasksCount,
+		[=](unsigned int)
+		{
+			for (unsigned int tile = (*nextTile)++; tile < tilesCount; tile = (*nextTile)++)
+			{
+				TileRange range;
+				range.x0 = tile % tilesInRow * tileWidth;
+				range.y0 = tile / tilesInRow * tileHeight;
+				range.x1 = std::min(width, range.x0 + tileWidth);
+				range.y1 = std::min(height, range.y0 + tileHeight);
+				tileCallable(range);
+			}
+			return 0;
+		},
+		[]() { return 0; });
+}
+
+//chunk tasks of first stage of chunked pipeline, chained after parent when given
+//returned tasks are used as previous chunks of ParallelForAfter, no join is added
+template <typename OutputType, typename CallableType>
+std::vector<TaskRef> ParallelForChunks(TaskGraph& graph, TaskRef& parent, unsigned int chunksCount, CallableType&& callable)
+{
+	std::vector<TaskRef> chunkTasks;
+	for (unsigned int chunk = 0; chunk < chunksCount; ++chunk)
+	{
+		auto task = ParallelTaskNode<OutputType>::create(chunk, callable);
+		if (parent)
+		{
+			graph.AddTaskEdge(parent, task);
+		}
+		else
+		{
+			graph.AddTask(task);
+		}
+		chunkTasks.push_back(task);
+	}
+	return chunkTasks;
+}
+
+//chunks of previous stage covering same items as chunk, widened by radius chunks of previous stage on both sides
+//chunk i of n chunks covers items in fractions ( i / n, ( i + 1 ) / n ], as rows split as n * i / chunksCount do,
+//so stages with different chunk counts still wait for every previous chunk they may read
+inline std::vector<unsigned int> OverlappingChunks(unsigned int chunk, unsigned int chunksCount, unsigned int previousChunksCount,
+	unsigned int radius = 0)
+{
+	const unsigned long long count = chunksCount;
+	const unsigned long long previousCount = previousChunksCount;
+	const unsigned long long firstOverlap = chunk * previousCount / count;
+	const unsigned long long lastOverlap = std::min(((chunk + 1) * previousCount + count - 1) / count - 1, previousCount - 1);
+
+	std::vector<unsigned int> chunks;
+	const unsigned long long first = firstOverlap > radius ? firstOverlap - radius : 0;
+	const unsigned long long last = std::min(lastOverlap + radius, previousCount - 1);
+	for (unsigned long long previous = first; previous <= last; ++previous)
+	{
+		chunks.push_back(static_cast<unsigned int>(previous));
+	}
+	return chunks;
+}
+
+//chunk of next stage needs chunks of previous stage covering same items, same chunk when counts are equal
+struct ChunkOneToOne
+{
+	std::vector<unsigned int> operator()(unsigned int chunk, unsigned int chunksCount, unsigned int previousChunksCount) const
+	{
+		return OverlappingChunks(chunk, chunksCount, previousChunksCount);
+	}
+};
+
+//chunk of next stage needs chunks within radius of its chunks of previous stage, e.g. rows of blur
+struct ChunkStencil
+{
+	unsigned int radius{ 1 };
+
+	std::vector<unsigned int> operator()(unsigned int chunk, unsigned int chunksCount, unsigned int previousChunksCount) const
+	{
+		return OverlappingChunks(chunk, chunksCount, previousChunksCount, radius);
+	}
+};
+
+//next stage of chunked pipeline, chunk starts as soon as chunks of previous stage it reads are done
+//dependencies(chunk, chunksCount, previousChunksCount) gives those chunks, so stages overlap instead of meeting at global join
+//each of previousStages ( e.g. two images merged ) is a vector of chunk tasks, returns chunk tasks of new stage
+template <typename OutputType, typename CallableType, typename DependenciesType = ChunkOneToOne>
+std::vector<TaskRef> ParallelForAfter(TaskGraph& graph, const std::vector<std::vector<TaskRef>>& previousStages,
+	unsigned int chunksCount, CallableType&& callable, DependenciesType&& dependencies = {})
+{
+	std::function<OutputType(unsigned int)> chunkCallable = std::forward<CallableType>(callable);
+
+	std::vector<TaskRef> chunkTasks;
+	for (unsigned int chunk = 0; chunk < chunksCount; ++chunk)
+	{
+		std::vector<TaskRef> previousChunks;
+		for (const auto& previousStage : previousStages)
+		{
+			if (previousStage.empty())
+			{
+				continue;
+			}
+
+			for (unsigned int previous : dependencies(chunk, chunksCount, static_cast<unsigned int>(previousStage.size())))
+			{
+				if (previous >= previousStage.size())
+				{
+					throw std::invalid_argument("Chunk dependency out of range of previous stage");
+				}
+				//same stage given twice or chunk listed twice would add edge twice
+				if (std::find(previousChunks.begin(), previousChunks.end(), previousStage[previous]) == previousChunks.end())
+				{
+					previousChunks.push_back(previousStage[previous]);
+				}
+			}
+		}
+
+		//join node waits for all its parents, chunk without dependencies starts right away
+		auto task = MultiJoinTaskNode<OutputType>::create([chunkCallable, chunk]() { return chunkCallable(chunk); }, previousChunks);
+		if (previousChunks.empty())
+		{
+			graph.AddTask(task);
+		}
+		else
+		{
+			graph.AddTaskEdges(previousChunks, task);
+		}
+		chunkTasks.push_back(task);
+	}
+	return chunkTasks;
+}
+
+template <typename OutputType, typename CallableType, typename DependenciesType = ChunkOneToOne>
+std::vector<TaskRef> ParallelForAfter(TaskGraph& graph, const std::vector<TaskRef>& previousChunks,
+	unsigned int chunksCount, CallableType&& callable, DependenciesType&& dependencies = {})
+{
+	return ParallelForAfter<OutputType>(graph, std::vector<std::vector<TaskRef>>{ previousChunks }, chunksCount,
+		std::forward<CallableType>(callable), std::forward<DependenciesType>(dependencies));
+}
+
+//join of last stage of chunked pipeline
+template <typename OutputType, typename ReduceCallableType>
+TaskRef JoinChunks(TaskGraph& graph, const std::vector<TaskRef>& chunkTasks, ReduceCallableType&& reduceCallable)
+{
+	auto joinTask = MultiJoinTaskNode<OutputType>::create(std::forward<ReduceCallableType>(reduceCallable), chunkTasks);
+	graph.AddTaskEdges(chunkTasks, joinTask);
+	return joinTask;
+}
+
 template <typename OutputType, unsigned int numThreads = 5, typename CallableType, typename ReduceCallableType>
 void ParallelReduce(unsigned int chunksCount, 
 	CallableType&& callable,
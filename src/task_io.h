@@ -0,0 +1,294 @@
+#pragma once
+#include "task_graph.h"
+#include "task_items.h"
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+//fixed number of threads running posted requests in order of posting, for blocking calls that must not occupy graph workers
+//requests still queued when pool is destroyed are run before its threads are joined
+class IoThreadPool
+{
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _cvRequests;
+	std::deque<std::function<void()>> _requests;
+	bool _stop{ false };
+
+public:
+	explicit IoThreadPool(unsigned int numThreads = 2)
+	{
+		numThreads = numThreads > 0 ? numThreads : 1;
+		for (unsigned int thread = 0; thread < numThreads; ++thread)
+		{
+			_threads.emplace_back([this]() { Run(); });
+		}
+	}
+
+	IoThreadPool(const IoThreadPool&) = delete;
+	IoThreadPool& operator=(const IoThreadPool&) = delete;
+
+	~IoThreadPool()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_cvRequests.notify_all();
+
+		for (auto& thread : _threads)
+		{
+			thread.join();
+		}
+	}
+
+	void Post(std::function<void()> request)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_requests.push_back(std::move(request));
+		}
+		_cvRequests.notify_one();
+	}
+
+private:
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (true)
+		{
+			_cvRequests.wait(lock, [this]() { return _stop || !_requests.empty(); });
+			if (_requests.empty())
+			{
+				return;
+			}
+
+			auto request = std::move(_requests.front());
+			_requests.pop_front();
+
+			lock.unlock();
+			request();
+			lock.lock();
+		}
+	}
+};
+
+//shared pool for blocking calls awaited by coroutines, its threads are joined at exit
+inline IoThreadPool& GetBlockingCallThreads()
+{
+	static IoThreadPool threads(std::max(2u, std::thread::hardware_concurrency()));
+	return threads;
+}
+
+//own threads for blocking I/O ( file reads and writes, decode, encode ) so graph workers never wait on disk
+//completions come back to graph as spawned tasks, graph is retained while requests are in flight
+//so WaitAll returns only after every request and its completion is done
+class IoExecutor
+{
+	TaskGraph& _graph;
+
+	std::mutex _mutex;
+	std::condition_variable _cvIdle;
+	size_t _requestsInFlight{ 0 };
+	size_t _writesInFlight{ 0 };
+	size_t _maxWritesInFlight;
+
+	//last member, its threads are joined before state they use is gone
+	IoThreadPool _threads;
+
+public:
+	//maxWritesInFlight bounds write behind, writer waits when that many writes are not done
+	explicit IoExecutor(TaskGraph& graph, unsigned int numThreads = 2, size_t maxWritesInFlight = 8) :
+		_graph(graph),
+		_maxWritesInFlight(maxWritesInFlight > 0 ? maxWritesInFlight : 1),
+		_threads(numThreads)
+	{
+	}
+
+	IoExecutor(const IoExecutor&) = delete;
+	IoExecutor& operator=(const IoExecutor&) = delete;
+
+	~IoExecutor()
+	{
+		WaitIdle();
+	}
+
+	//io runs on I/O thread, completion gets its result ( if any ) in task spawned into graph
+	template <typename IoCallable, typename CompletionCallable>
+	void Submit(IoCallable&& io, CompletionCallable&& completion)
+	{
+		using ResultType = std::invoke_result_t<IoCallable>;
+
+		_graph.Retain();
+		Enqueue([this, io = std::forward<IoCallable>(io), completion = std::forward<CompletionCallable>(completion)]() mutable
+		{
+			if constexpr (std::is_void<ResultType>::value)
+			{
+				io();
+				SpawnCompletion([completion]() mutable { completion(); });
+			}
+			else
+			{
+				auto result = std::make_shared<ResultType>(io());
+				SpawnCompletion([completion, result]() mutable { completion(std::move(*result)); });
+			}
+		}, false);
+	}
+
+	//write behind, caller continues while io runs, it waits only when too many writes are in flight
+	template <typename IoCallable>
+	void SubmitWrite(IoCallable&& io)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cvIdle.wait(lock, [this]() { return _writesInFlight < _maxWritesInFlight; });
+			++_writesInFlight;
+		}
+
+		_graph.Retain();
+		Enqueue([this, io = std::forward<IoCallable>(io)]() mutable
+		{
+			io();
+			SpawnCompletion([]() {});
+		}, true);
+	}
+
+	//wait till no request is queued or running, completions may still be pending in graph
+	void WaitIdle()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_cvIdle.wait(lock, [this]() { return _requestsInFlight == 0; });
+	}
+
+	//threads of executor, e.g. for AwaitBlockingCall
+	IoThreadPool& GetThreads()
+	{
+		return _threads;
+	}
+
+private:
+	void Enqueue(std::function<void()> request, bool write)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			++_requestsInFlight;
+		}
+		_threads.Post([this, request = std::move(request), write]()
+		{
+			request();
+
+			std::unique_lock<std::mutex> lock(_mutex);
+			--_requestsInFlight;
+			if (write)
+			{
+				--_writesInFlight;
+			}
+			_cvIdle.notify_all();
+		});
+	}
+
+	//graph is released from within spawned task, so it stays alive until release is done
+	template <typename CompletionCallable>
+	void SpawnCompletion(CompletionCallable&& completion)
+	{
+		TaskGraph& graph = _graph;
+		_graph.SpawnTask(InitialTaskNode<void>::create([&graph, completion = std::forward<CompletionCallable>(completion)]() mutable
+		{
+			completion();
+			graph.Release();
+		}));
+	}
+};
+
+//keeps up to depth items loading or loaded ahead of consumer, e.g. next frames of video
+//load(number) runs on I/O thread and returns false when there is no such item,
+//consume(number, item) runs as graph task, once it returns next item is loaded in its place
+template <typename ItemType>
+class IoPrefetcher : public std::enable_shared_from_this<IoPrefetcher<ItemType>>
+{
+	IoExecutor& _executor;
+	std::function<bool(unsigned long long, ItemType&)> _load;
+	std::function<void(unsigned long long, ItemType)> _consume;
+	unsigned int _depth;
+
+	std::mutex _mutex;
+	unsigned long long _nextNumber{ 0 };
+	unsigned int _inFlight{ 0 };
+	bool _finished{ false };
+
+public:
+	IoPrefetcher(IoExecutor& executor, unsigned int depth,
+		std::function<bool(unsigned long long, ItemType&)> load,
+		std::function<void(unsigned long long, ItemType)> consume) :
+		_executor(executor),
+		_load(std::move(load)),
+		_consume(std::move(consume)),
+		_depth(depth > 0 ? depth : 1)
+	{
+	}
+
+	//start loading first depth items
+	void Start(unsigned long long firstNumber = 0)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_nextNumber = firstNumber;
+		}
+		Fill();
+	}
+
+private:
+	void Fill()
+	{
+		auto self = this->shared_from_this();
+		while (true)
+		{
+			unsigned long long number = 0;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				if (_finished || _inFlight >= _depth)
+				{
+					return;
+				}
+				++_inFlight;
+				number = _nextNumber++;
+			}
+
+			_executor.Submit(
+				[self, number]()
+				{
+					auto item = std::make_shared<ItemType>();
+					if (!self->_load(number, *item))
+					{
+						item.reset();
+					}
+					return item;
+				},
+				[self, number](std::shared_ptr<ItemType> item)
+				{
+					if (!item)
+					{
+						//past last item, nothing else is loaded
+						{
+							std::unique_lock<std::mutex> lock(self->_mutex);
+							self->_finished = true;
+							--self->_inFlight;
+						}
+						return;
+					}
+					self->_consume(number, std::move(*item));
+
+					{
+						std::unique_lock<std::mutex> lock(self->_mutex);
+						--self->_inFlight;
+					}
+					self->Fill();
+				});
+		}
+	}
+};
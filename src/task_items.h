@@ -59,6 +59,11 @@ public:
 	{
 		return _result;
 	}
+
+	const char* GetTypeName() const override
+	{
+		return "TaskNode";
+	}
 };
 
 template<typename OutputType>
@@ -92,6 +97,11 @@ public:
 	{
 		_caller();
 	}
+
+	const char* GetTypeName() const override
+	{
+		return "InitialTaskNode";
+	}
 private:
 
 };
@@ -116,6 +126,11 @@ public:
 	{
 		_callable();
 	}
+
+	const char* GetTypeName() const override
+	{
+		return "InitialTaskNode";
+	}
 };
 
 template<typename OutputType>
@@ -147,6 +162,11 @@ public:
 	{
 		_result = _callable(_chunk);
 	}
+
+	const char* GetTypeName() const override
+	{
+		return "ParallelTaskNode";
+	}
 };
 
 template<typename OutputType>
@@ -187,6 +207,11 @@ public:
 	{
 		_result = _callable();
 	}
+
+	const char* GetTypeName() const override
+	{
+		return "MultiJoinTaskNode";
+	}
 };
 
 template<>
@@ -221,4 +246,9 @@ public:
 	{
 		_callable();
 	}
+
+	const char* GetTypeName() const override
+	{
+		return "MultiJoinTaskNode";
+	}
 };
@@ -0,0 +1,276 @@
+#pragma once
+#include "task_base.h"
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <locale>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+//thread sampling queue depths of a running graph every period
+//keeps last maxSamples samples, optionally exports latest one in Prometheus text format
+//to a file ( replaced atomically, fits node exporter textfile collector ) or a Unix socket
+class QueueMonitor
+{
+	TaskController& _controller;
+	std::chrono::steady_clock::duration _period;
+	size_t _maxSamples;
+
+	std::thread _thread;
+	mutable std::mutex _mutex;
+	std::condition_variable _cvStop;
+	bool _stop{ false };
+
+	std::deque<QueueDepthSample> _samples;
+	std::string _prometheusFile;
+	std::string _prometheusSocket;
+	int _socket{ -1 };
+
+public:
+	QueueMonitor(TaskController& controller, std::chrono::steady_clock::duration period, size_t maxSamples) :
+		_controller(controller),
+		_period(period),
+		_maxSamples(maxSamples > 0 ? maxSamples : 1)
+	{
+	}
+
+	QueueMonitor(const QueueMonitor&) = delete;
+	QueueMonitor& operator=(const QueueMonitor&) = delete;
+
+	~QueueMonitor()
+	{
+		Stop();
+	}
+
+	//empty name disables output, call them while monitor is stopped
+	void SetPrometheusFile(std::string fileName)
+	{
+		_prometheusFile = std::move(fileName);
+	}
+
+	//socket answers every connection with latest sample, curl --unix-socket path http://localhost/metrics
+	//connections are served once per period, supported on Linux only
+	//path is checked here, Start runs inside of WaitAll when workers are already running
+	void SetPrometheusSocket(std::string socketPath)
+	{
+#ifdef __linux__
+		if (socketPath.size() >= sizeof(sockaddr_un::sun_path))
+		{
+			throw std::invalid_argument("Unix socket path is too long");
+		}
+#endif
+		_prometheusSocket = std::move(socketPath);
+	}
+
+	void Start()
+	{
+		if (_thread.joinable())
+		{
+			return;
+		}
+
+		_stop = false;
+		OpenSocket();
+		_thread = std::thread([this]() { Run(); });
+	}
+
+	void Stop()
+	{
+		if (!_thread.joinable())
+		{
+			return;
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_cvStop.notify_one();
+		_thread.join();
+
+		CloseSocket();
+	}
+
+	std::vector<QueueDepthSample> GetSamples() const
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		return std::vector<QueueDepthSample>(_samples.begin(), _samples.end());
+	}
+
+	void Clear()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_samples.clear();
+	}
+
+	//one gauge per queue, worker queues are labeled by worker number
+	static void WritePrometheus(std::ostream& out, const QueueDepthSample& sample)
+	{
+		//exposition format needs plain numbers, whatever locale stream has
+		const auto locale = out.imbue(std::locale::classic());
+		out << "# HELP taskgraph_worker_queue_depth Jobs waiting in worker queue.\n";
+		out << "# TYPE taskgraph_worker_queue_depth gauge\n";
+		for (size_t worker = 0; worker < sample.workerJobs.size(); ++worker)
+		{
+			out << "taskgraph_worker_queue_depth{worker=\"" << worker << "\"} " << sample.workerJobs[worker] << "\n";
+		}
+
+		WriteGauge(out, "taskgraph_pending_tasks", "Tasks not handed to workers yet.", sample.pendingTasks);
+		WriteGauge(out, "taskgraph_unfinished_tasks", "Tasks added and not done.", sample.unfinishedTasks);
+		WriteGauge(out, "taskgraph_ready_queue_length", "Completions and signals waiting for coordinator.", sample.readyTasks);
+		WriteGauge(out, "taskgraph_queue_imbalance", "Deepest worker queue divided by mean depth.", sample.Imbalance());
+		out.imbue(locale);
+	}
+
+private:
+	template<typename ValueType>
+	static void WriteGauge(std::ostream& out, const char* name, const char* help, ValueType value)
+	{
+		out << "# HELP " << name << " " << help << "\n";
+		out << "# TYPE " << name << " gauge\n";
+		out << name << " " << value << "\n";
+	}
+
+	void Run()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (!_stop)
+		{
+			lock.unlock();
+			auto sample = _controller.SampleQueueDepths();
+			Export(sample);
+			lock.lock();
+
+			_samples.push_back(std::move(sample));
+			if (_samples.size() > _maxSamples)
+			{
+				_samples.pop_front();
+			}
+
+			_cvStop.wait_for(lock, _period, [this]() { return _stop; });
+		}
+	}
+
+	void Export(const QueueDepthSample& sample)
+	{
+		if (_prometheusFile.empty() && _socket < 0)
+		{
+			return;
+		}
+
+		std::ostringstream text;
+		WritePrometheus(text, sample);
+
+		if (!_prometheusFile.empty())
+		{
+			//readers never see partially written file
+			const std::string temporaryFile = _prometheusFile + ".tmp";
+			{
+				std::ofstream out(temporaryFile, std::ios::binary | std::ios::trunc);
+				out << text.str();
+			}
+			std::rename(temporaryFile.c_str(), _prometheusFile.c_str());
+		}
+
+		ServeSocket(text.str());
+	}
+
+	void OpenSocket()
+	{
+#ifdef __linux__
+		if (_prometheusSocket.empty())
+		{
+			return;
+		}
+
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		_prometheusSocket.copy(address.sun_path, _prometheusSocket.size());
+
+		_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if (_socket < 0)
+		{
+			return;
+		}
+
+		unlink(_prometheusSocket.c_str());
+		if (bind(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(_socket, 8) != 0)
+		{
+			CloseSocket();
+		}
+#endif
+	}
+
+	void CloseSocket()
+	{
+#ifdef __linux__
+		if (_socket >= 0)
+		{
+			close(_socket);
+			unlink(_prometheusSocket.c_str());
+			_socket = -1;
+		}
+#endif
+	}
+
+	//answers connections waiting since last sample with minimal HTTP response
+	void ServeSocket(const std::string& text)
+	{
+#ifdef __linux__
+		if (_socket < 0)
+		{
+			return;
+		}
+
+		const std::string response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+			std::to_string(text.size()) + "\r\n\r\n" + text;
+
+		while (true)
+		{
+			//client is non-blocking, so a scraper that does not read cannot stall the sampling thread
+			const int client = accept4(_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (client < 0)
+			{
+				break;
+			}
+
+			//request is not parsed, read what already arrived so close does not reset connection
+			char request[1024];
+			while (recv(client, request, sizeof(request), MSG_DONTWAIT) > 0)
+			{
+			}
+
+			size_t written = 0;
+			while (written < response.size())
+			{
+				const ssize_t count = send(client, response.data() + written, response.size() - written, MSG_NOSIGNAL);
+				if (count < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				//full send buffer ( EAGAIN ) or error drops client, it gets next sample on new connection
+				if (count <= 0)
+				{
+					break;
+				}
+				written += static_cast<size_t>(count);
+			}
+			shutdown(client, SHUT_WR);
+			close(client);
+		}
+#endif
+	}
+};
@@ -0,0 +1,219 @@
+#pragma once
+#include <array>
+#include <map>
+#include <ostream>
+#include <string>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct PerfCounterValues
+{
+	unsigned long long cycles{ 0 };
+	unsigned long long instructions{ 0 };
+	unsigned long long llcMisses{ 0 };
+	unsigned long long branchMisses{ 0 };
+
+	PerfCounterValues& operator+=(const PerfCounterValues& other)
+	{
+		cycles += other.cycles;
+		instructions += other.instructions;
+		llcMisses += other.llcMisses;
+		branchMisses += other.branchMisses;
+		return *this;
+	}
+
+	PerfCounterValues operator-(const PerfCounterValues& other) const
+	{
+		PerfCounterValues difference;
+		difference.cycles = cycles - other.cycles;
+		difference.instructions = instructions - other.instructions;
+		difference.llcMisses = llcMisses - other.llcMisses;
+		difference.branchMisses = branchMisses - other.branchMisses;
+		return difference;
+	}
+};
+
+//hardware counters of calling thread, user space only
+//counters the cpu or kernel does not provide stay zero, group is invalid without cycles
+//when kernel multiplexes more events than cpu has counters, values are scaled by enabled / running time
+class PerfCounterGroup
+{
+	static const size_t CountersCount = 4;
+
+	std::array<int, CountersCount> _fileDescriptors;
+	//index of every opened counter in group read
+	std::array<int, CountersCount> _readIndex;
+	size_t _openedCount{ 0 };
+
+public:
+	PerfCounterGroup()
+	{
+		_fileDescriptors.fill(-1);
+		_readIndex.fill(-1);
+
+#ifdef __linux__
+		const std::array<unsigned long long, CountersCount> configs
+		{
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_BRANCH_MISSES
+		};
+
+		for (size_t counter = 0; counter < CountersCount; ++counter)
+		{
+			perf_event_attr attributes;
+			std::memset(&attributes, 0, sizeof(attributes));
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = configs[counter];
+			attributes.disabled = counter == 0 ? 1 : 0;
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			const int groupLeader = counter == 0 ? -1 : _fileDescriptors[0];
+			const int fileDescriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, groupLeader, 0));
+			if (fileDescriptor < 0)
+			{
+				if (counter == 0)
+				{
+					//no cycles counter, nothing to group with
+					return;
+				}
+				continue;
+			}
+
+			_fileDescriptors[counter] = fileDescriptor;
+			_readIndex[counter] = static_cast<int>(_openedCount++);
+		}
+
+		ioctl(_fileDescriptors[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(_fileDescriptors[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	PerfCounterGroup(const PerfCounterGroup&) = delete;
+	PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+	~PerfCounterGroup()
+	{
+#ifdef __linux__
+		for (auto fileDescriptor : _fileDescriptors)
+		{
+			if (fileDescriptor >= 0)
+			{
+				close(fileDescriptor);
+			}
+		}
+#endif
+	}
+
+	bool IsValid() const
+	{
+		return _fileDescriptors[0] >= 0;
+	}
+
+	//running totals, difference of two reads gives counts of code between them
+	PerfCounterValues Read() const
+	{
+		PerfCounterValues values;
+#ifdef __linux__
+		if (!IsValid())
+		{
+			return values;
+		}
+
+		//number of counters, time enabled, time running and values of counters
+		std::array<unsigned long long, CountersCount + 3> buffer{};
+		if (read(_fileDescriptors[0], buffer.data(), sizeof(buffer)) <= 0)
+		{
+			return values;
+		}
+
+		values.cycles = GetValue(buffer, 0);
+		values.instructions = GetValue(buffer, 1);
+		values.llcMisses = GetValue(buffer, 2);
+		values.branchMisses = GetValue(buffer, 3);
+#endif
+		return values;
+	}
+
+private:
+	//estimate for whole enabled time, group was on cpu only for running part of it
+	unsigned long long GetValue(const std::array<unsigned long long, CountersCount + 3>& buffer, size_t counter) const
+	{
+		const int index = _readIndex[counter];
+		const unsigned long long enabled = buffer[1];
+		const unsigned long long running = buffer[2];
+		if (index < 0 || static_cast<unsigned long long>(index) >= buffer[0] || running == 0)
+		{
+			return 0;
+		}
+
+		const unsigned long long value = buffer[index + 3];
+		return running < enabled ? static_cast<unsigned long long>(static_cast<double>(value) * enabled / running) : value;
+	}
+};
+
+//whether this process may count hardware events of its threads
+inline bool PerfCountersAvailable()
+{
+	static const bool available = PerfCounterGroup().IsValid();
+	return available;
+}
+
+struct PerfCounterSummary
+{
+	unsigned long long tasks{ 0 };
+	PerfCounterValues values;
+
+	double InstructionsPerCycle() const
+	{
+		return values.cycles ? static_cast<double>(values.instructions) / values.cycles : 0;
+	}
+
+	//per thousand instructions
+	double LlcMissesPerKiloInstruction() const
+	{
+		return values.instructions ? 1000.0 * values.llcMisses / values.instructions : 0;
+	}
+
+	double BranchMissesPerKiloInstruction() const
+	{
+		return values.instructions ? 1000.0 * values.branchMisses / values.instructions : 0;
+	}
+};
+
+//counters of tasks grouped by task name and by node type
+struct PerfCounterReport
+{
+	std::map<std::string, PerfCounterSummary> byName;
+	std::map<std::string, PerfCounterSummary> byType;
+
+	void Print(std::ostream& out) const
+	{
+		out << "group,key,tasks,cycles,instructions,ipc,llc_misses,llc_mpki,branch_misses,branch_mpki\n";
+		PrintGroup(out, "name", byName);
+		PrintGroup(out, "type", byType);
+	}
+
+private:
+	static void PrintGroup(std::ostream& out, const char* group, const std::map<std::string, PerfCounterSummary>& summaries)
+	{
+		for (const auto& summary : summaries)
+		{
+			const auto& values = summary.second.values;
+			out << group << "," << summary.first << "," << summary.second.tasks << ","
+				<< values.cycles << "," << values.instructions << "," << summary.second.InstructionsPerCycle() << ","
+				<< values.llcMisses << "," << summary.second.LlcMissesPerKiloInstruction() << ","
+				<< values.branchMisses << "," << summary.second.BranchMissesPerKiloInstruction() << "\n";
+		}
+	}
+};
@@ -0,0 +1,343 @@
+#pragma once
+#include "task_graph.h"
+#include "task_items.h"
+#include <any>
+#include <map>
+
+enum class FilterMode
+{
+	Parallel,
+	SerialInOrder,
+	SerialOutOfOrder
+};
+
+//passed to the first filter, call Stop when there is no more input
+class FlowControl
+{
+	bool _stopped{ false };
+public:
+	void Stop()
+	{
+		_stopped = true;
+	}
+
+	bool IsStopped() const
+	{
+		return _stopped;
+	}
+};
+
+class PipelineFilterBase
+{
+	FilterMode _mode;
+public:
+	explicit PipelineFilterBase(FilterMode mode) :
+		_mode(mode)
+	{
+	}
+
+	virtual ~PipelineFilterBase() = default;
+
+	FilterMode GetMode() const
+	{
+		return _mode;
+	}
+
+	virtual std::any Process(std::any& input, FlowControl& flowControl) = 0;
+};
+
+template<typename InputType, typename OutputType>
+struct FilterCallableType
+{
+	using type = std::function<OutputType(InputType)>;
+};
+
+//first filter produces items, it gets flow control instead of input
+template<typename OutputType>
+struct FilterCallableType<void, OutputType>
+{
+	using type = std::function<OutputType(FlowControl&)>;
+};
+
+template<typename InputType, typename OutputType>
+class PipelineFilter : public PipelineFilterBase
+{
+	using FilterCallable = typename FilterCallableType<InputType, OutputType>::type;
+
+	FilterCallable _callable;
+public:
+	PipelineFilter(FilterMode mode, FilterCallable callable) :
+		PipelineFilterBase(mode),
+		_callable(std::move(callable))
+	{
+	}
+
+	std::any Process(std::any& input, FlowControl& flowControl) override
+	{
+		if constexpr (std::is_void<InputType>::value && std::is_void<OutputType>::value)
+		{
+			_callable(flowControl);
+			return {};
+		}
+		else if constexpr (std::is_void<InputType>::value)
+		{
+			return _callable(flowControl);
+		}
+		else if constexpr (std::is_void<OutputType>::value)
+		{
+			_callable(std::move(std::any_cast<InputType&>(input)));
+			return {};
+		}
+		else
+		{
+			return _callable(std::move(std::any_cast<InputType&>(input)));
+		}
+	}
+};
+
+//typed chain of filters, InputType of first and OutputType of last filter
+template<typename InputType, typename OutputType>
+class FilterChain
+{
+	template<typename In, typename Out>
+	friend class FilterChain;
+
+	std::vector<std::shared_ptr<PipelineFilterBase>> _filters;
+
+public:
+	FilterChain() = default;
+
+	explicit FilterChain(std::shared_ptr<PipelineFilterBase> filter)
+	{
+		_filters.push_back(std::move(filter));
+	}
+
+	template<typename NextOutputType>
+	FilterChain<InputType, NextOutputType> operator&(const FilterChain<OutputType, NextOutputType>& next) const
+	{
+		FilterChain<InputType, NextOutputType> chain;
+		chain._filters = _filters;
+		chain._filters.insert(chain._filters.end(), next._filters.begin(), next._filters.end());
+		return chain;
+	}
+
+	const std::vector<std::shared_ptr<PipelineFilterBase>>& GetFilters() const
+	{
+		return _filters;
+	}
+};
+
+template<typename InputType, typename OutputType, typename CallableType>
+FilterChain<InputType, OutputType> MakeFilter(FilterMode mode, CallableType&& callable)
+{
+	return FilterChain<InputType, OutputType>(
+		std::make_shared<PipelineFilter<InputType, OutputType>>(mode, std::forward<CallableType>(callable)));
+}
+
+//runs items through filters, every item holds one token
+//items are carried through stages by spawned graph tasks
+class Pipeline : public std::enable_shared_from_this<Pipeline>
+{
+	struct Item
+	{
+		unsigned long long sequence{ 0 };
+		std::any value;
+	};
+
+	struct StageState
+	{
+		bool busy{ false };
+		unsigned long long nextSequence{ 0 };
+		std::map<unsigned long long, Item> waitingItems;
+	};
+
+	TaskGraph& _graph;
+	std::vector<std::shared_ptr<PipelineFilterBase>> _filters;
+	std::vector<StageState> _stages;
+	unsigned int _maxTokens{ 1 };
+
+	std::mutex _mutex;
+	unsigned int _tokensInFlight{ 0 };
+	unsigned long long _nextSequence{ 0 };
+	bool _inputBusy{ false };
+	bool _stopped{ false };
+
+public:
+	Pipeline(TaskGraph& graph, unsigned int maxTokens, const std::vector<std::shared_ptr<PipelineFilterBase>>& filters) :
+		_graph(graph),
+		_filters(filters),
+		_stages(filters.size()),
+		_maxTokens(maxTokens > 0 ? maxTokens : 1)
+	{
+	}
+
+	Pipeline(const Pipeline&) = delete;
+	Pipeline& operator=(const Pipeline&) = delete;
+
+	//task reading first item, it spawns the rest of the pipeline
+	TaskRef CreateStartTask()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_inputBusy = true;
+			++_tokensInFlight;
+		}
+
+		auto self = shared_from_this();
+		return InitialTaskNode<void>::create([self]()
+		{
+			self->RunInput();
+		});
+	}
+
+private:
+	//first filter always runs serially in order, it numbers the items
+	void RunInput()
+	{
+		Item item;
+		FlowControl flowControl;
+		std::any noInput;
+		item.value = _filters.front()->Process(noInput, flowControl);
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_inputBusy = false;
+
+			if (flowControl.IsStopped())
+			{
+				_stopped = true;
+				--_tokensInFlight;
+				return;
+			}
+
+			item.sequence = _nextSequence++;
+		}
+
+		//next token can be read while this one is processed
+		TryStartInput();
+
+		ProcessItem(std::move(item), 1, false);
+	}
+
+	void TryStartInput()
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			if (_stopped || _inputBusy || _tokensInFlight >= _maxTokens)
+			{
+				return;
+			}
+			_inputBusy = true;
+			++_tokensInFlight;
+		}
+
+		auto self = shared_from_this();
+		_graph.SpawnTask(InitialTaskNode<void>::create([self]()
+		{
+			self->RunInput();
+		}));
+	}
+
+	//run item through stages starting from given one, stage may already be acquired for it
+	void ProcessItem(Item item, size_t stage, bool stageAcquired)
+	{
+		for (; stage < _filters.size(); ++stage)
+		{
+			auto& filter = _filters[stage];
+			const bool serial = filter->GetMode() != FilterMode::Parallel;
+
+			if (serial && !stageAcquired && !AcquireStage(item, stage))
+			{
+				//parked in stage, it is continued when stage is free
+				return;
+			}
+			stageAcquired = false;
+
+			FlowControl flowControl;
+			item.value = filter->Process(item.value, flowControl);
+
+			if (serial)
+			{
+				ReleaseStage(stage);
+			}
+		}
+
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			--_tokensInFlight;
+		}
+
+		//token is free read next item
+		TryStartInput();
+	}
+
+	bool AcquireStage(Item& item, size_t stage)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		auto& stageState = _stages[stage];
+		const bool inOrder = _filters[stage]->GetMode() == FilterMode::SerialInOrder;
+
+		if (stageState.busy || (inOrder && item.sequence != stageState.nextSequence))
+		{
+			const auto sequence = item.sequence;
+			stageState.waitingItems.emplace(sequence, std::move(item));
+			return false;
+		}
+
+		stageState.busy = true;
+		return true;
+	}
+
+	void ReleaseStage(size_t stage)
+	{
+		Item nextItem;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			auto& stageState = _stages[stage];
+			const bool inOrder = _filters[stage]->GetMode() == FilterMode::SerialInOrder;
+
+			stageState.busy = false;
+			++stageState.nextSequence;
+
+			auto it = stageState.waitingItems.begin();
+			if (it == stageState.waitingItems.end() || (inOrder && it->first != stageState.nextSequence))
+			{
+				return;
+			}
+
+			stageState.busy = true;
+			nextItem = std::move(it->second);
+			stageState.waitingItems.erase(it);
+		}
+
+		//continue parked item in its own task
+		auto self = shared_from_this();
+		auto item = std::make_shared<Item>(std::move(nextItem));
+		_graph.SpawnTask(InitialTaskNode<void>::create([self, item, stage]()
+		{
+			self->ProcessItem(std::move(*item), stage, true);
+		}));
+	}
+};
+
+template <typename OutputType>
+TaskRef ParallelPipeline(TaskGraph& graph, unsigned int maxTokens, const FilterChain<void, OutputType>& chain)
+{
+	static_assert(std::is_void<OutputType>::value, "Last filter must not return value");
+
+	auto pipeline = std::make_shared<Pipeline>(graph, maxTokens, chain.GetFilters());
+	auto startTask = pipeline->CreateStartTask();
+	graph.AddTask(startTask);
+
+	return startTask;
+}
+
+template <typename OutputType>
+void ParallelPipeline(unsigned int maxTokens, const FilterChain<void, OutputType>& chain, unsigned int numThreads = GetNumberOfCPUs())
+{
+	TaskGraph graph(numThreads);
+
+	ParallelPipeline(graph, maxTokens, chain);
+
+	graph.WaitAll();
+}
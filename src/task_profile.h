@@ -0,0 +1,256 @@
+#pragma once
+#include "task_base.h"
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct TaskProfile
+{
+	TaskId taskId{ 0 };
+	std::string name;
+	std::string typeName;
+	unsigned int runs{ 0 };
+	//worker of the last run
+	unsigned int worker{ 0 };
+	//steady clock nanoseconds of first start and last end
+	long long begin{ 0 };
+	long long end{ 0 };
+	//sum of all runs, suspended time is not included
+	long long duration{ 0 };
+	//hardware counters of all runs
+	PerfCounterValues counters;
+};
+
+//what happened during one WaitAll, filled only when profiling is enabled
+struct ExecutionProfile
+{
+	unsigned int numThreads{ 0 };
+	//steady clock nanoseconds of WaitAll start and end
+	long long begin{ 0 };
+	long long end{ 0 };
+	std::map<TaskId, TaskProfile> tasks;
+	//graph edges parent -> children, spawned tasks have no edge to their spawner
+	std::map<TaskId, std::vector<TaskId>> children;
+	//time each worker spent running tasks
+	std::vector<long long> workerBusyTime;
+
+	void AddExecution(unsigned int worker, const TaskExecutionRecord& record)
+	{
+		auto& task = tasks[record.taskId];
+		if (task.runs++ == 0 || record.begin < task.begin)
+		{
+			task.begin = record.begin;
+		}
+		if (record.end >= task.end)
+		{
+			task.end = record.end;
+			task.worker = worker;
+		}
+		task.taskId = record.taskId;
+		task.duration += record.end - record.begin;
+		task.counters += record.counters;
+
+		if (worker >= workerBusyTime.size())
+		{
+			workerBusyTime.resize(worker + 1, 0);
+		}
+		workerBusyTime[worker] += record.end - record.begin;
+	}
+
+	//names are taken while tasks are still in the graph
+	void AddTaskDescription(const TaskBase& taskBase)
+	{
+		auto& task = tasks[taskBase.GetTaskId()];
+		task.taskId = taskBase.GetTaskId();
+		task.name = taskBase.GetName();
+		task.typeName = taskBase.GetTypeName();
+	}
+
+	void Clear()
+	{
+		numThreads = 0;
+		begin = 0;
+		end = 0;
+		tasks.clear();
+		children.clear();
+		workerBusyTime.clear();
+	}
+};
+
+struct ExecutionReport
+{
+	//all durations in nanoseconds
+	long long wallTime{ 0 };
+	//sum of task durations
+	long long work{ 0 };
+	//longest dependency path weighted by task durations
+	long long span{ 0 };
+	//work / span, upper bound of speedup given by graph shape
+	double parallelism{ 0 };
+	//work / wall time, speedup actually reached
+	double achievedParallelism{ 0 };
+	//tasks of the longest path from first to last
+	std::vector<TaskId> criticalPath;
+	//busy time / wall time of each worker
+	std::vector<double> workerUtilization;
+
+	void Print(std::ostream& out) const
+	{
+		out << "wall time ms " << wallTime / 1e6 << "\n";
+		out << "work ms " << work / 1e6 << "\n";
+		out << "span ms " << span / 1e6 << "\n";
+		out << "parallelism " << parallelism << " achieved " << achievedParallelism << "\n";
+
+		out << "critical path";
+		for (auto taskId : criticalPath)
+		{
+			out << " " << taskId;
+		}
+		out << "\n";
+
+		for (size_t worker = 0; worker < workerUtilization.size(); ++worker)
+		{
+			out << "worker " << worker << " utilization " << workerUtilization[worker] << "\n";
+		}
+	}
+};
+
+//work, span and critical path of executed part of graph
+inline ExecutionReport AnalyzeExecution(const ExecutionProfile& profile)
+{
+	ExecutionReport report;
+	report.wallTime = profile.end - profile.begin;
+
+	std::map<TaskId, unsigned int> parentsCount;
+	for (const auto& task : profile.tasks)
+	{
+		report.work += task.second.duration;
+		parentsCount.emplace(task.first, 0);
+	}
+
+	for (const auto& edges : profile.children)
+	{
+		if (profile.tasks.find(edges.first) == profile.tasks.end())
+		{
+			continue;
+		}
+		for (auto child : edges.second)
+		{
+			auto count = parentsCount.find(child);
+			if (count != parentsCount.end())
+			{
+				++count->second;
+			}
+		}
+	}
+
+	//longest path in topological order, finish is path length ending with task
+	std::map<TaskId, long long> finish;
+	std::map<TaskId, TaskId> criticalParent;
+	std::vector<TaskId> ready;
+	for (const auto& count : parentsCount)
+	{
+		if (count.second == 0)
+		{
+			ready.push_back(count.first);
+			finish[count.first] = 0;
+		}
+	}
+
+	TaskId lastTask = 0;
+	bool hasLastTask = false;
+	while (!ready.empty())
+	{
+		const TaskId taskId = ready.back();
+		ready.pop_back();
+
+		const long long taskFinish = finish[taskId] + profile.tasks.at(taskId).duration;
+		finish[taskId] = taskFinish;
+
+		if (!hasLastTask || taskFinish > report.span)
+		{
+			report.span = taskFinish;
+			lastTask = taskId;
+			hasLastTask = true;
+		}
+
+		auto edges = profile.children.find(taskId);
+		if (edges == profile.children.end())
+		{
+			continue;
+		}
+
+		for (auto child : edges->second)
+		{
+			auto count = parentsCount.find(child);
+			if (count == parentsCount.end())
+			{
+				continue;
+			}
+
+			//finish of child holds longest path to its start until child is ready
+			auto childFinish = finish.emplace(child, taskFinish);
+			if (childFinish.second || taskFinish > childFinish.first->second)
+			{
+				childFinish.first->second = taskFinish;
+				criticalParent[child] = taskId;
+			}
+
+			if (--count->second == 0)
+			{
+				ready.push_back(child);
+			}
+		}
+	}
+
+	if (hasLastTask)
+	{
+		for (TaskId taskId = lastTask;;)
+		{
+			report.criticalPath.push_back(taskId);
+			auto parent = criticalParent.find(taskId);
+			if (parent == criticalParent.end())
+			{
+				break;
+			}
+			taskId = parent->second;
+		}
+		std::reverse(report.criticalPath.begin(), report.criticalPath.end());
+	}
+
+	report.parallelism = report.span > 0 ? static_cast<double>(report.work) / report.span : 0;
+	report.achievedParallelism = report.wallTime > 0 ? static_cast<double>(report.work) / report.wallTime : 0;
+
+	for (unsigned int worker = 0; worker < profile.numThreads; ++worker)
+	{
+		const long long busy = worker < profile.workerBusyTime.size() ? profile.workerBusyTime[worker] : 0;
+		report.workerUtilization.push_back(report.wallTime > 0 ? static_cast<double>(busy) / report.wallTime : 0);
+	}
+
+	return report;
+}
+
+//hardware counters of profiled tasks summed by task name and node type
+inline PerfCounterReport AggregatePerfCounters(const ExecutionProfile& profile)
+{
+	PerfCounterReport report;
+	for (const auto& task : profile.tasks)
+	{
+		if (task.second.runs == 0)
+		{
+			continue;
+		}
+
+		const std::string name = task.second.name.empty() ? "unnamed" : task.second.name;
+		const std::string typeName = task.second.typeName.empty() ? "unknown" : task.second.typeName;
+
+		for (auto summary : { &report.byName[name], &report.byType[typeName] })
+		{
+			++summary->tasks;
+			summary->values += task.second.counters;
+		}
+	}
+	return report;
+}
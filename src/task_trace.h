@@ -0,0 +1,267 @@
+#pragma once
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <locale>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//steady clock time in nanoseconds, shared time base of tracing and profiling
+inline long long SteadyClockNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+enum class TraceEventType : unsigned char
+{
+	Task,
+	Steal,
+	Idle
+};
+
+struct TraceEvent
+{
+	TraceEventType type{ TraceEventType::Task };
+	//task id for task events, victim thread for steals
+	unsigned int id{ 0 };
+	//stolen tasks count for steals
+	unsigned int count{ 0 };
+	//nanoseconds since tracing was enabled
+	long long begin{ 0 };
+	long long end{ 0 };
+};
+
+//events of one thread, written by its owner only
+//oldest events are overwritten when buffer is full
+class TraceBuffer
+{
+	std::vector<TraceEvent> _events;
+	unsigned long long _written{ 0 };
+
+public:
+	explicit TraceBuffer(size_t capacity) :
+		_events(capacity > 0 ? capacity : 1)
+	{
+	}
+
+	void Record(const TraceEvent& event)
+	{
+		_events[_written % _events.size()] = event;
+		++_written;
+	}
+
+	unsigned long long GetDropped() const
+	{
+		return _written > _events.size() ? _written - _events.size() : 0;
+	}
+
+	//oldest first
+	template<typename VisitorType>
+	void ForEach(VisitorType&& visitor) const
+	{
+		const unsigned long long first = GetDropped();
+		for (auto index = first; index < _written; ++index)
+		{
+			visitor(_events[index % _events.size()]);
+		}
+	}
+
+	void Clear()
+	{
+		_written = 0;
+	}
+};
+
+//collects timeline of workers and coordinator, exported as chrome trace json
+//buffers are read only while no worker is running ( outside of WaitAll )
+class TaskTracer
+{
+	long long _start;
+	unsigned int _numThreads;
+	//workers first, coordinator last
+	std::vector<std::unique_ptr<TraceBuffer>> _buffers;
+
+public:
+	TaskTracer(unsigned int numThreads, size_t eventsPerThread) :
+		_start(SteadyClockNanoseconds()),
+		_numThreads(numThreads)
+	{
+		for (unsigned int threadNumber = 0; threadNumber <= numThreads; ++threadNumber)
+		{
+			_buffers.push_back(std::make_unique<TraceBuffer>(eventsPerThread));
+		}
+	}
+
+	long long Now() const
+	{
+		return SteadyClockNanoseconds() - _start;
+	}
+
+	//steady clock nanoseconds to trace time
+	long long FromSteadyClock(long long nanoseconds) const
+	{
+		return nanoseconds - _start;
+	}
+
+	unsigned int GetCoordinatorThread() const
+	{
+		return _numThreads;
+	}
+
+	void RecordTask(unsigned int threadNumber, unsigned int taskId, long long begin, long long end)
+	{
+		_buffers[threadNumber]->Record({ TraceEventType::Task, taskId, 0, begin, end });
+	}
+
+	void RecordSteal(unsigned int threadNumber, unsigned int victimThread, unsigned int count, long long time)
+	{
+		_buffers[threadNumber]->Record({ TraceEventType::Steal, victimThread, count, time, time });
+	}
+
+	void RecordIdle(unsigned int threadNumber, long long begin, long long end)
+	{
+		_buffers[threadNumber]->Record({ TraceEventType::Idle, 0, 0, begin, end });
+	}
+
+	unsigned long long GetDroppedEvents() const
+	{
+		unsigned long long dropped = 0;
+		for (const auto& buffer : _buffers)
+		{
+			dropped += buffer->GetDropped();
+		}
+		return dropped;
+	}
+
+	void Clear()
+	{
+		for (auto& buffer : _buffers)
+		{
+			buffer->Clear();
+		}
+	}
+
+	//chrome trace event format, opens in chrome://tracing and Perfetto
+	//taskName gives slice names, task ids are used without it or when it returns empty name
+	void WriteChromeTrace(std::ostream& out, const std::function<std::string(unsigned int)>& taskName = {}) const
+	{
+		//json numbers need classic locale, no grouping and decimal point
+		const auto locale = out.imbue(std::locale::classic());
+		const auto flags = out.flags();
+		const auto precision = out.precision();
+		out << std::fixed << std::setprecision(3);
+
+		out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+
+		bool first = true;
+		auto separator = [&]()
+		{
+			if (!first)
+			{
+				out << ",";
+			}
+			first = false;
+			out << "\n";
+		};
+
+		for (unsigned int threadNumber = 0; threadNumber < _buffers.size(); ++threadNumber)
+		{
+			separator();
+			out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << threadNumber
+				<< ",\"args\":{\"name\":\"";
+			if (threadNumber == _numThreads)
+			{
+				out << "coordinator";
+			}
+			else
+			{
+				out << "worker " << threadNumber;
+			}
+			out << "\"}}";
+
+			_buffers[threadNumber]->ForEach([&](const TraceEvent& event)
+			{
+				separator();
+				switch (event.type)
+				{
+				case TraceEventType::Task:
+					out << "{\"name\":\"" << GetTaskName(taskName, event.id) << "\",\"cat\":\"task\",\"ph\":\"X\"";
+					WriteTimes(out, event);
+					out << ",\"pid\":0,\"tid\":" << threadNumber << ",\"args\":{\"id\":" << event.id << "}}";
+					break;
+				case TraceEventType::Steal:
+					out << "{\"name\":\"steal\",\"cat\":\"steal\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" << ToMicroseconds(event.begin)
+						<< ",\"pid\":0,\"tid\":" << threadNumber
+						<< ",\"args\":{\"victim\":" << event.id << ",\"count\":" << event.count << "}}";
+					break;
+				case TraceEventType::Idle:
+					out << "{\"name\":\"idle\",\"cat\":\"idle\",\"ph\":\"X\"";
+					WriteTimes(out, event);
+					out << ",\"pid\":0,\"tid\":" << threadNumber << "}";
+					break;
+				}
+			});
+		}
+
+		out << "\n]}\n";
+
+		out.flags(flags);
+		out.precision(precision);
+		out.imbue(locale);
+	}
+
+	bool SaveChromeTrace(const std::string& fileName, const std::function<std::string(unsigned int)>& taskName = {}) const
+	{
+		std::ofstream out(fileName, std::ios::out | std::ios::binary);
+		if (!out)
+		{
+			return false;
+		}
+		WriteChromeTrace(out, taskName);
+		return static_cast<bool>(out);
+	}
+
+private:
+	static std::string GetTaskName(const std::function<std::string(unsigned int)>& taskName, unsigned int taskId)
+	{
+		std::string name = taskName ? taskName(taskId) : std::string();
+		if (name.empty())
+		{
+			return "task " + std::to_string(taskId);
+		}
+
+		//json string needs control characters escaped too, they are written as \u00XX
+		static const char hexDigits[] = "0123456789abcdef";
+		std::string escaped;
+		for (auto character : name)
+		{
+			const auto code = static_cast<unsigned char>(character);
+			if (code < 0x20)
+			{
+				escaped += "\\u00";
+				escaped += hexDigits[code >> 4];
+				escaped += hexDigits[code & 0xf];
+				continue;
+			}
+			if (character == '"' || character == '\\')
+			{
+				escaped += '\\';
+			}
+			escaped += character;
+		}
+		return escaped;
+	}
+
+	static double ToMicroseconds(long long nanoseconds)
+	{
+		return nanoseconds / 1000.0;
+	}
+
+	static void WriteTimes(std::ostream& out, const TraceEvent& event)
+	{
+		out << ",\"ts\":" << ToMicroseconds(event.begin) << ",\"dur\":" << ToMicroseconds(event.end - event.begin);
+	}
+};
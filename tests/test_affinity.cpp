@@ -0,0 +1,73 @@
+#include "test_framework.h"
+#include "task_graph.h"
+#include "task_graph_utils.h"
+#include <atomic>
+
+TEST_CASE("affinity bits")
+{
+	TaskAffinity none;
+	CHECK(!none.HasAffinity());
+	CHECK_EQ(none.GetFirstAffinity(), 0u);
+
+	TaskAffinity affinity;
+	affinity.SetAffinity({ 1, 3, 40 });
+	CHECK(affinity.HasAffinity());
+	CHECK_EQ(affinity.GetFirstAffinity(), 1u);
+	CHECK_EQ(affinity.GetNextAffinity(1), 3u);
+	//wraps to first one, out of range affinity is ignored
+	CHECK_EQ(affinity.GetNextAffinity(3), 1u);
+}
+
+TEST_CASE("task runs on worker of its affinity")
+{
+	const unsigned int numThreads = 4;
+	TaskGraph graph(numThreads);
+	graph.EnableProfiling();
+
+	//one task per worker, nothing to steal
+	std::vector<TaskRef> tasks;
+	for (unsigned int worker = 0; worker < numThreads; ++worker)
+	{
+		TaskRef task = InitialTaskNode<void>::create([]() {});
+		task->SetAffinity({ numThreads - 1 - worker });
+		graph.AddTask(task);
+		tasks.push_back(task);
+	}
+	graph.WaitAll();
+
+	const auto& profile = graph.GetExecutionProfile();
+	for (unsigned int worker = 0; worker < numThreads; ++worker)
+	{
+		const auto& taskProfile = profile.tasks.at(tasks[worker]->GetTaskId());
+		CHECK_EQ(taskProfile.runs, 1u);
+		CHECK_EQ(taskProfile.worker, numThreads - 1 - worker);
+	}
+}
+
+TEST_CASE("affinity above thread count still runs")
+{
+	std::atomic<int> executed{ 0 };
+	TaskGraph graph(2);
+
+	TaskRef task = InitialTaskNode<void>::create([&executed]() { ++executed; });
+	task->SetAffinity({ 7 });
+	graph.AddTask(task);
+	graph.WaitAll();
+
+	CHECK_EQ(executed.load(), 1);
+}
+
+TEST_CASE("parallel for with affinity covers all chunks")
+{
+	const unsigned int chunks = 64;
+	std::vector<std::atomic<int>> hits(chunks);
+
+	TaskGraph graph(4);
+	ParallelFor<int>(graph, chunks, [&hits](unsigned int chunk) { ++hits[chunk]; return 0; }, TaskAffinity(0, 2));
+	graph.WaitAll();
+
+	for (auto& hit : hits)
+	{
+		CHECK_EQ(hit.load(), 1);
+	}
+}
@@ -0,0 +1,134 @@
+#include "test_framework.h"
+#include "task_buffer_pool.h"
+#include "../ext/ch1.h"
+#include "../ext/ch2.h"
+#include <cstdio>
+#include <thread>
+
+TEST_CASE("size classes round up to power of two or huge pages")
+{
+	using Pool = BufferPool<unsigned char>;
+	CHECK_EQ(Pool::SizeClass(0), size_t(64));
+	CHECK_EQ(Pool::SizeClass(65), size_t(128));
+	CHECK_EQ(Pool::SizeClass(1000000), size_t(1024 * 1024));
+	CHECK_EQ(Pool::SizeClass(Pool::HugePageSize), Pool::HugePageSize);
+	CHECK_EQ(Pool::SizeClass(Pool::HugePageSize + 1), 2 * Pool::HugePageSize);
+	CHECK_EQ(Pool::SizeClass(1464 * 2560 * 4), 8 * Pool::HugePageSize);
+}
+
+TEST_CASE("released buffer is reused by acquire of same class")
+{
+	BufferPool<int> pool;
+	auto first = pool.Acquire(1000);
+	CHECK_EQ(first.size(), size_t(1000));
+	first[999] = 7;
+	const int* storage = first.data();
+	pool.Release(std::move(first));
+
+	//same class, old content is kept
+	auto second = pool.Acquire(900);
+	CHECK(second.data() == storage);
+	CHECK_EQ(second.size(), size_t(900));
+
+	//other class allocates
+	auto third = pool.Acquire(100000);
+	CHECK(third.data() != storage);
+
+	const auto stats = pool.GetStats();
+	CHECK_EQ(stats.hits, 1ull);
+	CHECK_EQ(stats.misses, 2ull);
+}
+
+TEST_CASE("shared buffer goes back to pool when last owner is gone")
+{
+	auto pool = std::make_unique<BufferPool<unsigned char>>();
+	auto buffer = pool->AcquireShared(5000);
+	auto copy = buffer;
+	const unsigned char* storage = buffer->data();
+
+	buffer.reset();
+	CHECK_EQ(pool->GetStats().retainedBytes, size_t(0));
+	copy.reset();
+	CHECK_EQ(pool->GetStats().retainedBytes, size_t(8192));
+	CHECK(pool->AcquireShared(5000)->data() == storage);
+
+	//buffer may outlive its pool
+	auto survivor = pool->AcquireShared(100);
+	pool.reset();
+	survivor.reset();
+}
+
+TEST_CASE("pool frees buffers past retained limit")
+{
+	BufferPool<unsigned char> pool(10000);
+	auto first = pool.Acquire(8000);
+	auto second = pool.Acquire(8000);
+	pool.Release(std::move(first));
+	pool.Release(std::move(second));
+
+	const auto stats = pool.GetStats();
+	CHECK_EQ(stats.retainedBytes, size_t(8192));
+	CHECK_EQ(stats.dropped, 1ull);
+
+	pool.Trim();
+	CHECK_EQ(pool.GetStats().retainedBytes, size_t(0));
+}
+
+TEST_CASE("pool is shared between threads")
+{
+	BufferPool<unsigned char> pool;
+	std::vector<std::thread> threads;
+	for (int thread = 0; thread < 4; ++thread)
+	{
+		threads.emplace_back([&pool, thread]()
+		{
+			for (int i = 0; i < 200; ++i)
+			{
+				auto buffer = pool.AcquireShared(1000 + (i % 3) * 5000);
+				(*buffer)[0] = static_cast<unsigned char>(thread);
+			}
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	const auto stats = pool.GetStats();
+	CHECK_EQ(stats.hits + stats.misses, 800ull);
+	CHECK(stats.misses <= 12ull);
+}
+
+TEST_CASE("images of same size reuse raster and frame buffers")
+{
+	const ch01::Image::Pixel* pixels = nullptr;
+	{
+		ch01::Image image("first", 64, 48);
+		pixels = image.rows()[0];
+	}
+	{
+		ch01::Image image("second", 64, 48);
+		CHECK(image.rows()[0] == pixels);
+		CHECK(image.rows()[47] == pixels + 64 * 47);
+	}
+
+	std::vector<unsigned char> rgba(33 * 17 * 4);
+	for (size_t i = 0; i < rgba.size(); ++i)
+	{
+		rgba[i] = static_cast<unsigned char>(i * 7);
+	}
+	CHECK_EQ(lodepng::encode("test_pool_frame.png", rgba, 33, 17), 0u);
+
+	const unsigned char* frame = nullptr;
+	{
+		PNGImage image(0, "test_pool_frame.png");
+		CHECK(*image.buffer == rgba);
+		frame = image.buffer->data();
+	}
+	{
+		PNGImage image(1, "test_pool_frame.png");
+		CHECK(*image.buffer == rgba);
+		CHECK(image.buffer->data() == frame);
+	}
+	std::remove("test_pool_frame.png");
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//minimal test registry, every test executable links test_main.cpp
+//usage: test_binary [name filter]
+struct TestCase
+{
+	std::string name;
+	std::function<void()> body;
+};
+
+inline std::vector<TestCase>& GetTestCases()
+{
+	static std::vector<TestCase> testCases;
+	return testCases;
+}
+
+struct TestRegistration
+{
+	TestRegistration(const char* name, std::function<void()> body)
+	{
+		GetTestCases().push_back({ name, std::move(body) });
+	}
+};
+
+class TestFailure : public std::exception
+{
+	std::string _message;
+public:
+	explicit TestFailure(std::string message) :
+		_message(std::move(message))
+	{
+	}
+
+	const char* what() const noexcept override
+	{
+		return _message.c_str();
+	}
+};
+
+inline void FailTest(const char* file, int line, const std::string& message)
+{
+	std::ostringstream text;
+	text << file << ":" << line << ": " << message;
+	throw TestFailure(text.str());
+}
+
+inline int RunTests(int argc, char* argv[])
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	int failed = 0;
+	int executed = 0;
+
+	for (const auto& testCase : GetTestCases())
+	{
+		if (filter && testCase.name.find(filter) == std::string::npos)
+		{
+			continue;
+		}
+
+		++executed;
+		try
+		{
+			testCase.body();
+			std::cout << "[ OK ] " << testCase.name << "\n";
+		}
+		catch (const std::exception& exception)
+		{
+			++failed;
+			std::cout << "[FAIL] " << testCase.name << "\n       " << exception.what() << "\n";
+		}
+	}
+
+	std::cout << executed - failed << "/" << executed << " tests passed\n";
+	return failed == 0 && executed > 0 ? 0 : 1;
+}
+
+#define TEST_CONCAT_INNER(a, b) a##b
+#define TEST_CONCAT(a, b) TEST_CONCAT_INNER(a, b)
+
+#define TEST_CASE(name) \
+	static void TEST_CONCAT(TestBody, __LINE__)(); \
+	static TestRegistration TEST_CONCAT(testRegistration, __LINE__)(name, &TEST_CONCAT(TestBody, __LINE__)); \
+	static void TEST_CONCAT(TestBody, __LINE__)()
+
+#define CHECK(condition) \
+	do { if (!(condition)) FailTest(__FILE__, __LINE__, "CHECK(" #condition ") failed"); } while (false)
+
+#define CHECK_EQ(actual, expected) \
+	do { \
+		const auto& actualValue = (actual); \
+		const auto& expectedValue = (expected); \
+		if (!(actualValue == expectedValue)) \
+		{ \
+			std::ostringstream checkMessage; \
+			checkMessage << "CHECK_EQ(" #actual ", " #expected ") failed: " << actualValue << " != " << expectedValue; \
+			FailTest(__FILE__, __LINE__, checkMessage.str()); \
+		} \
+	} while (false)
+
+#define CHECK_THROWS(expression, exceptionType) \
+	do { \
+		bool thrown = false; \
+		try { expression; } catch (const exceptionType&) { thrown = true; } \
+		if (!thrown) FailTest(__FILE__, __LINE__, "CHECK_THROWS(" #expression ") did not throw " #exceptionType); \
+	} while (false)
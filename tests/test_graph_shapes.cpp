@@ -0,0 +1,277 @@
+#include "test_framework.h"
+#include "task_graph.h"
+#include "task_graph_utils.h"
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+
+//records completion order of tasks, checks parents finish before children
+class CompletionOrder
+{
+	std::mutex _mutex;
+	std::map<TaskId, size_t> _positions;
+public:
+	void Complete(TaskId taskId)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_positions.emplace(taskId, _positions.size());
+	}
+
+	size_t GetPosition(TaskId taskId)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		return _positions.at(taskId);
+	}
+
+	size_t GetCount()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		return _positions.size();
+	}
+};
+
+TEST_CASE("empty graph returns")
+{
+	TaskGraph graph(2);
+	graph.WaitAll();
+}
+
+TEST_CASE("single task result")
+{
+	TaskGraph graph(2);
+	auto task = InitialTaskNode<int>::create([]() { return 42; });
+	graph.AddTask(task);
+	graph.WaitAll();
+
+	CHECK_EQ(task->GetResult(), 42);
+}
+
+TEST_CASE("duplicate task is rejected")
+{
+	TaskGraph graph(1);
+	TaskRef task = InitialTaskNode<void>::create([]() {});
+	graph.AddTask(task);
+
+	CHECK_THROWS(graph.AddTask(task), std::invalid_argument);
+	graph.WaitAll();
+}
+
+TEST_CASE("task sequence passes results in order")
+{
+	int result = 0;
+	TaskGraph graph(4);
+	AddTaskSequence<int>(graph,
+		[&]() { result = 100; return 0; },
+		[&]() { result *= 2; return 0; },
+		[&]() { result += 1; return 0; });
+	graph.WaitAll();
+
+	CHECK_EQ(result, 201);
+}
+
+TEST_CASE("task node gets parent result")
+{
+	TaskGraph graph(3);
+	auto parent = InitialTaskNode<int>::create([]() { return 20; });
+	auto child = TaskNode<int, int>::create(parent, [](int input) { return input + 1; });
+	graph.AddTask(parent);
+	graph.AddTaskEdge(parent, child);
+	graph.WaitAll();
+
+	CHECK_EQ(child->GetResult(), 21);
+}
+
+TEST_CASE("long chain keeps order")
+{
+	const int length = 2000;
+	std::vector<int> order;
+	TaskGraph graph(4);
+
+	TaskRef previous;
+	for (int i = 0; i < length; ++i)
+	{
+		TaskRef task = InitialTaskNode<void>::create([&order, i]() { order.push_back(i); });
+		if (previous)
+		{
+			graph.AddTaskEdge(previous, task);
+		}
+		else
+		{
+			graph.AddTask(task);
+		}
+		previous = task;
+	}
+	graph.WaitAll();
+
+	CHECK_EQ(order.size(), static_cast<size_t>(length));
+	for (int i = 0; i < length; ++i)
+	{
+		CHECK_EQ(order[i], i);
+	}
+}
+
+TEST_CASE("fan out fan in reduces all chunks")
+{
+	const unsigned int chunks = 800;
+	std::vector<int> values(chunks, 0);
+
+	TaskGraph graph(4);
+	TaskRef root = InitialTaskNode<int>::create([]() { return 0; });
+	graph.AddTask(root);
+
+	auto reduce = ParallelReduce<int>(graph, root, chunks,
+		[&values](unsigned int chunk) { values[chunk] = static_cast<int>(chunk); return 0; },
+		[&values]()
+		{
+			int sum = 0;
+			for (auto value : values)
+			{
+				sum += value;
+			}
+			return sum;
+		});
+	graph.WaitAll();
+
+	auto result = std::dynamic_pointer_cast<TaskResult<int>>(reduce);
+	CHECK_EQ(result->GetResult(), static_cast<int>(chunks * (chunks - 1) / 2));
+}
+
+TEST_CASE("diamond join runs once after both branches")
+{
+	std::atomic<int> branches{ 0 };
+	int branchesSeenByJoin = -1;
+	int joinRuns = 0;
+
+	TaskGraph graph(4);
+	TaskRef top = InitialTaskNode<void>::create([]() {});
+	TaskRef left = InitialTaskNode<void>::create([&]() { ++branches; });
+	TaskRef right = InitialTaskNode<void>::create([&]() { ++branches; });
+	std::vector<TaskRef> parents{ left, right };
+	TaskRef join = MultiJoinTaskNode<void>::create([&]() { branchesSeenByJoin = branches; ++joinRuns; }, parents);
+
+	graph.AddTask(top);
+	graph.AddTaskEdge(top, left);
+	graph.AddTaskEdge(top, right);
+	graph.AddTaskEdges(parents, join);
+	graph.WaitAll();
+
+	CHECK_EQ(joinRuns, 1);
+	CHECK_EQ(branchesSeenByJoin, 2);
+}
+
+TEST_CASE("random dag respects dependencies")
+{
+	const size_t width = 32;
+	const size_t depth = 20;
+	std::mt19937 random(7);
+	CompletionOrder completionOrder;
+
+	TaskGraph graph(4);
+	std::vector<std::pair<TaskRef, std::vector<TaskRef>>> tasks;
+	std::vector<TaskRef> previousLayer;
+
+	for (size_t layer = 0; layer < depth; ++layer)
+	{
+		std::vector<TaskRef> currentLayer;
+		for (size_t i = 0; i < width; ++i)
+		{
+			std::vector<TaskRef> parents;
+			if (layer > 0)
+			{
+				const size_t parentsCount = 1 + random() % 3;
+				for (size_t parent = 0; parent < parentsCount; ++parent)
+				{
+					auto& candidate = previousLayer[random() % width];
+					if (std::find(parents.begin(), parents.end(), candidate) == parents.end())
+					{
+						parents.push_back(candidate);
+					}
+				}
+			}
+
+			auto taskId = std::make_shared<TaskId>(0);
+			auto body = [&completionOrder, taskId]() { completionOrder.Complete(*taskId); };
+
+			TaskRef task;
+			if (parents.empty())
+			{
+				task = InitialTaskNode<void>::create(body);
+				graph.AddTask(task);
+			}
+			else
+			{
+				task = MultiJoinTaskNode<void>::create(body, parents);
+				graph.AddTaskEdges(parents, task);
+			}
+			*taskId = task->GetTaskId();
+
+			tasks.emplace_back(task, parents);
+			currentLayer.push_back(task);
+		}
+		previousLayer.swap(currentLayer);
+	}
+
+	graph.WaitAll();
+
+	CHECK_EQ(completionOrder.GetCount(), width * depth);
+	for (auto& task : tasks)
+	{
+		for (auto& parent : task.second)
+		{
+			CHECK(completionOrder.GetPosition(parent->GetTaskId()) < completionOrder.GetPosition(task.first->GetTaskId()));
+		}
+	}
+}
+
+TEST_CASE("graph can be reused after WaitAll")
+{
+	TaskGraph graph(3);
+	for (int run = 0; run < 5; ++run)
+	{
+		std::atomic<int> executed{ 0 };
+		for (int i = 0; i < 100; ++i)
+		{
+			graph.AddTask(InitialTaskNode<void>::create([&executed]() { ++executed; }));
+		}
+		graph.WaitAll();
+
+		CHECK_EQ(executed.load(), 100);
+	}
+}
+
+TEST_CASE("nested graph inside task")
+{
+	TaskGraph graph(2);
+	auto outer = InitialTaskNode<int>::create([]()
+	{
+		TaskGraph subGraph(1);
+		auto node = InitialTaskNode<int>::create([]() { return 500; });
+		auto nodePlusOne = TaskNode<int, int>::create(node, [](int input) { return input + 1; });
+		subGraph.AddTask(node);
+		subGraph.AddTaskEdge(node, nodePlusOne);
+		subGraph.WaitAll();
+		return nodePlusOne->GetResult();
+	});
+	graph.AddTask(outer);
+	graph.WaitAll();
+
+	CHECK_EQ(outer->GetResult(), 501);
+}
+
+TEST_CASE("spawned tasks run before WaitAll returns")
+{
+	std::atomic<int> executed{ 0 };
+	TaskGraph graph(4);
+
+	graph.AddTask(InitialTaskNode<void>::create([&]()
+	{
+		for (int i = 0; i < 50; ++i)
+		{
+			graph.SpawnTask(InitialTaskNode<void>::create([&executed]() { ++executed; }));
+		}
+	}));
+	graph.WaitAll();
+
+	CHECK_EQ(executed.load(), 50);
+}
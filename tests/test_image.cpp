@@ -0,0 +1,400 @@
+#include "test_framework.h"
+#include "task_graph.h"
+#include "../ext/ch1_tasks.h"
+#include "../ext/pixel_kernels.h"
+#include "../ext/ch2_tasks.h"
+#include "../ext/bmp_writer.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+TEST_CASE("tiles cover range once")
+{
+	const unsigned int width = 100;
+	const unsigned int height = 37;
+	std::vector<std::atomic<int>> hits(width * height);
+
+	TaskGraph graph(4);
+	TaskRef noParent;
+	TaskRef join = ParallelForTiles(graph, noParent, width, height, 16, 8, [&hits](const TileRange& tile)
+	{
+		for (unsigned int y = tile.y0; y < tile.y1; ++y)
+		{
+			for (unsigned int x = tile.x0; x < tile.x1; ++x)
+			{
+				++hits[y * width + x];
+			}
+		}
+	}, 3);
+
+	bool joinedAfterTiles = false;
+	TaskRef after = InitialTaskNode<void>::create([&]()
+	{
+		joinedAfterTiles = true;
+		for (auto& hit : hits)
+		{
+			joinedAfterTiles = joinedAfterTiles && hit == 1;
+		}
+	});
+	graph.AddTaskEdge(join, after);
+	graph.WaitAll();
+
+	CHECK(joinedAfterTiles);
+}
+
+TEST_CASE("tiled fractal matches serial")
+{
+	const int width = 96;
+	const int height = 80;
+	auto serial = ch01::makeFractalImage(2000000, width, height);
+	auto tiled = ch01::makeFractalImageParallel(2000000, width, height, 4, 16, ch01::FractalKernel::Scalar);
+	auto vectorized = ch01::makeFractalImageParallel(2000000, width, height, 4, 16);
+
+	for (int row = 0; row < height; ++row)
+	{
+		for (int column = 0; column < width; ++column)
+		{
+			CHECK_EQ(tiled->rows()[row][column].value, serial->rows()[row][column].value);
+			//vector exp may move value across integer boundary
+			const int expected = serial->rows()[row][column].bgra[0];
+			CHECK(std::abs(vectorized->rows()[row][column].bgra[0] - expected) <= 1);
+		}
+	}
+}
+
+TEST_CASE("fractal kernels match scalar pixels")
+{
+	const int width = 64;
+	const int height = 61;
+	const ch01::Fractal fractal(width, height);
+
+	for (auto kernel : { ch01::FractalKernel::Scalar, ch01::FractalKernel::Avx2, ch01::FractalKernel::Avx512 })
+	{
+		if (!ch01::fractalKernelSupported(kernel))
+		{
+			continue;
+		}
+
+		//odd count leaves partial vector at the end
+		//sum of positive terms keeps relative error of exp approximation, test is built without fp contraction
+		std::vector<double> values(height);
+		for (int row = 0; row < width; row += 3)
+		{
+			ch01::calcFractalPixels(fractal, row, 0, height, values.data(), kernel);
+			for (int column = 0; column < height; ++column)
+			{
+				const double expected = fractal.calcOnePixel(row, column);
+				CHECK(std::abs(values[column] - expected) <= 1e-14 * expected);
+			}
+		}
+	}
+}
+
+TEST_CASE("gamma lookup table matches pow")
+{
+	const int size = 67;
+	ch01::Image source("source", size, size);
+	source.fill([](int x, int y) { return (x * 7 + y * 13) % 256; });
+	//colored pixels exercise luma weights
+	for (int row = 0; row < size; ++row)
+	{
+		for (int column = 0; column < size; column += 2)
+		{
+			source.rows()[row][column] = ch01::Image::Pixel(row * 3 % 256, column * 5 % 256, (row + column) % 256);
+		}
+	}
+
+	for (double gamma : { 0.5, 1.0, 1.4 })
+	{
+		ch01::Image expected("expected", size, size);
+		ch01::Image actual("actual", size, size);
+		ch01::applyGammaToRows(source, expected, gamma, 0, size);
+		ch01::applyGammaLutToRows(source, actual, gamma, 0, size);
+
+		for (int row = 0; row < size; ++row)
+		{
+			for (int column = 0; column < size; ++column)
+			{
+				//luma is quantized to 1/16 of level, enough to stay within one output level
+				const int difference = actual.rows()[row][column].bgra[0] - expected.rows()[row][column].bgra[0];
+				CHECK(std::abs(difference) <= 1);
+				CHECK_EQ(actual.rows()[row][column].bgra[0], actual.rows()[row][column].bgra[2]);
+			}
+		}
+	}
+
+	CHECK(ch01::ToneCurve::gamma(1.4) == ch01::ToneCurve::gamma(1.4));
+}
+
+TEST_CASE("fused kernel matches separate stages")
+{
+	const int size = 53;
+	const double tints[] = { 0.75, 0.2, 0 };
+	ch01::Image source("source", size, size);
+	source.fill([](int x, int y) { return (x * 11 + y * 3) % 256; });
+
+	ch01::Image gamma("gamma", size, size);
+	ch01::Image expected("expected", size, size);
+	ch01::applyGammaLutToRows(source, gamma, 1.4, 0, size);
+	ch01::applyTintToRows(gamma, expected, tints, 0, size);
+
+	ch01::Image fusedGamma("fusedGamma", size, size);
+	ch01::Image fused("fused", size, size);
+	auto kernel = ch01::makeFusedKernel(
+		ch01::GammaOp(1.4),
+		ch01::MaterializeOp{ ch01::pixelView(fusedGamma) },
+		ch01::TintOp(tints));
+
+	TaskGraph graph(3);
+	TaskRef noParent;
+	ch01::applyFusedKernel(graph, noParent, kernel, ch01::pixelView(source), ch01::pixelView(fused), 7);
+	graph.WaitAll();
+
+	for (int row = 0; row < size; ++row)
+	{
+		for (int column = 0; column < size; ++column)
+		{
+			CHECK_EQ(fusedGamma.rows()[row][column].value, gamma.rows()[row][column].value);
+			CHECK_EQ(fused.rows()[row][column].value, expected.rows()[row][column].value);
+		}
+	}
+}
+
+TEST_CASE("fused kernel merges png images")
+{
+	auto makePNG = [](unsigned int size, unsigned char seed)
+	{
+		PNGImage image;
+		image.width = size;
+		image.height = size;
+		image.buffer = std::make_shared<std::vector<unsigned char>>(size * size * PNGImage::numChannels);
+		for (size_t i = 0; i < image.buffer->size(); ++i)
+		{
+			(*image.buffer)[i] = static_cast<unsigned char>(i * 29 + seed);
+		}
+		return image;
+	};
+
+	const unsigned int size = 31;
+	PNGImage right = makePNG(size, 2);
+	PNGImage expectedLeft = makePNG(size, 1);
+	PNGImage expectedRight = makePNG(size, 2);
+
+	increasePNGChannel(expectedLeft, PNGImage::redOffset, 10);
+	increasePNGChannel(expectedRight, PNGImage::blueOffset, 10);
+	mergePNGImages(expectedRight, expectedLeft);
+
+	//left boost is applied while reading left pixel, right image is changed in place
+	auto boostedLeft = makePNG(size, 1);
+	auto kernel = ch01::makeFusedKernel(
+		ch01::ChannelBoostOp{ PNGImage::blueOffset, 10 },
+		ch01::MergeOp{ ch01::pixelView(boostedLeft) });
+	increasePNGChannel(boostedLeft, PNGImage::redOffset, 10);
+	kernel.applyToRows(ch01::pixelView(right), ch01::pixelView(right), 0, size);
+
+	CHECK(*right.buffer == *expectedRight.buffer);
+}
+
+TEST_CASE("png channel kernels match scalar loops")
+{
+	//odd count leaves tail for scalar loop
+	const size_t count = 203;
+	std::vector<unsigned char> source(count * 4);
+	for (size_t i = 0; i < source.size(); ++i)
+	{
+		source[i] = static_cast<unsigned char>(i * 37 + 11);
+	}
+
+	for (int channel : { PNGImage::redOffset, PNGImage::greenOffset, PNGImage::blueOffset, 3 })
+	{
+		for (int increase : { 0, 10, 200, 255, 300, -5 })
+		{
+			std::vector<unsigned char> expected = source;
+			std::vector<unsigned char> actual = source;
+			for (size_t i = 0; i < count; ++i)
+			{
+				unsigned char& value = expected[i * 4 + channel];
+				value = static_cast<unsigned char>(std::min(value + increase, 255));
+			}
+			addToChannel(actual.data(), count, channel, increase);
+			CHECK(actual == expected);
+		}
+
+		std::vector<unsigned char> target(count * 4, 7);
+		std::vector<unsigned char> expected = target;
+		for (size_t i = 0; i < count; ++i)
+		{
+			expected[i * 4 + channel] = source[i * 4 + channel];
+		}
+		copyChannel(target.data(), source.data(), count, channel);
+		CHECK(target == expected);
+	}
+}
+
+TEST_CASE("parallel png stages match serial")
+{
+	auto makePNG = [](unsigned int width, unsigned int height, unsigned char seed)
+	{
+		PNGImage image;
+		image.width = width;
+		image.height = height;
+		image.buffer = std::make_shared<std::vector<unsigned char>>(width * height * PNGImage::numChannels);
+		for (size_t i = 0; i < image.buffer->size(); ++i)
+		{
+			(*image.buffer)[i] = static_cast<unsigned char>(i * 13 + seed);
+		}
+		return image;
+	};
+
+	PNGImage left = makePNG(45, 29, 3);
+	PNGImage right = makePNG(45, 29, 5);
+	PNGImage expectedLeft = makePNG(45, 29, 3);
+	PNGImage expectedRight = makePNG(45, 29, 5);
+	increasePNGChannel(expectedLeft, PNGImage::redOffset, 10);
+	mergePNGImages(expectedRight, expectedLeft);
+
+	TaskGraph graph(3);
+	TaskRef noParent;
+	TaskRef increaseTask = increasePNGChannelParallel(graph, noParent, left, PNGImage::redOffset, 10, 6);
+	mergePNGImagesParallel(graph, increaseTask, right, left, 5);
+	graph.WaitAll();
+
+	CHECK(*left.buffer == *expectedLeft.buffer);
+	CHECK(*right.buffer == *expectedRight.buffer);
+}
+
+TEST_CASE("adler32 of pieces combines to adler32 of whole")
+{
+	std::vector<unsigned char> data(20000);
+	for (size_t i = 0; i < data.size(); ++i)
+	{
+		data[i] = static_cast<unsigned char>((i * 7919) >> 3);
+	}
+
+	const unsigned int whole = png_encoder::adler32(data.data(), data.size());
+	for (size_t split : { size_t(0), size_t(1), size_t(5552), size_t(12345), data.size() })
+	{
+		const unsigned int first = png_encoder::adler32(data.data(), split);
+		const unsigned int second = png_encoder::adler32(data.data() + split, data.size() - split);
+		CHECK_EQ(png_encoder::adler32Combine(first, second, data.size() - split), whole);
+	}
+}
+
+TEST_CASE("parallel png encode decodes to same pixels")
+{
+	//noise, gradient and flat areas, so encoder emits literals, matches and long zero runs in code lengths
+	auto makePNG = [](unsigned int width, unsigned int height)
+	{
+		PNGImage image;
+		image.width = width;
+		image.height = height;
+		image.buffer = std::make_shared<std::vector<unsigned char>>(width * height * PNGImage::numChannels);
+		unsigned int noise = 12345;
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				unsigned char* pixel = image.buffer->data() + (size_t(y) * width + x) * PNGImage::numChannels;
+				noise = noise * 1103515245 + 12345;
+				pixel[0] = y < height / 3 ? static_cast<unsigned char>(noise >> 16) : static_cast<unsigned char>(x);
+				pixel[1] = static_cast<unsigned char>(x + y);
+				pixel[2] = x < width / 2 ? 40 : static_cast<unsigned char>(noise >> 24);
+				pixel[3] = 255;
+			}
+		}
+		return image;
+	};
+
+	for (auto size : { std::pair<unsigned int, unsigned int>{ 300, 290 }, { 17, 3 }, { 1, 1 } })
+	{
+		PNGImage image = makePNG(size.first, size.second);
+		for (auto compression : { PNGCompression::Fast, PNGCompression::Default })
+		{
+			for (unsigned int chunksCount : { 1u, 7u, 8u })
+			{
+				std::vector<unsigned char> encoded;
+				{
+					TaskGraph graph(3);
+					TaskRef noParent;
+					encodePNGParallel(graph, noParent, image, encoded, compression, chunksCount);
+					graph.WaitAll();
+				}
+
+				std::vector<unsigned char> decoded;
+				unsigned int width = 0, height = 0;
+				CHECK_EQ(lodepng::decode(decoded, width, height, encoded), 0u);
+				CHECK_EQ(width, image.width);
+				CHECK_EQ(height, image.height);
+				CHECK(decoded == *image.buffer);
+			}
+		}
+	}
+}
+
+TEST_CASE("image write stores bmp rows bottom-up")
+{
+	auto readFile = [](const char* fname)
+	{
+		std::ifstream stream(fname, std::ios::binary);
+		return std::vector<char>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	};
+
+	ch01::Image image("rows", 5, 3);
+	image.fill([](int x, int y) { return x * 50 + y * 10 + 10; });
+	image.write("test_rows.bmp");
+
+	const auto bytes = readFile("test_rows.bmp");
+	std::remove("test_rows.bmp");
+	CHECK_EQ(bytes.size(), image.bmpFileSize());
+	CHECK(bytes.size() > 54 && bytes[0] == 'B' && bytes[1] == 'M');
+	for (int row = 0; row < image.height(); ++row)
+	{
+		CHECK(std::memcmp(bytes.data() + image.bmpRowOffset(row), image.rows()[row], 5 * sizeof(ch01::Image::Pixel)) == 0);
+	}
+	//last image row is first in file
+	CHECK_EQ(image.bmpRowOffset(image.height() - 1), size_t(54));
+}
+
+TEST_CASE("streamed bmp matches image write")
+{
+	auto readFile = [](const char* fname)
+	{
+		std::ifstream stream(fname, std::ios::binary);
+		return std::vector<char>((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+	};
+
+	ch01::Image image("streamed", 37, 23);
+	image.fill([](int x, int y) { return (x * 7 + y * 3) % 256; });
+	image.write("test_whole.bmp");
+
+	{
+		//ranges out of order, one of them past last row
+		ch01::BmpFileWriter writer(image, "test_ranges.bmp");
+		CHECK(writer.good());
+		writer.writeRows(20, 30);
+		writer.writeRows(0, 7);
+		writer.writeRows(7, 20);
+	}
+
+	{
+		TaskGraph graph(3);
+		TaskRef noParent;
+		ch01::BmpFileWriter writer(image, "test_chunks.bmp");
+		auto chunks = ParallelForChunks<int>(graph, noParent, 6, [](unsigned int) { return 0; });
+		ch01::writeBmpChunks(graph, chunks, writer, image);
+		graph.WaitAll();
+	}
+
+	const auto whole = readFile("test_whole.bmp");
+	CHECK_EQ(whole.size(), image.bmpFileSize());
+	CHECK(readFile("test_ranges.bmp") == whole);
+	CHECK(readFile("test_chunks.bmp") == whole);
+	for (const char* fname : { "test_whole.bmp", "test_ranges.bmp", "test_chunks.bmp" })
+	{
+		std::remove(fname);
+	}
+}
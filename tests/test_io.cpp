@@ -0,0 +1,150 @@
+#include "test_framework.h"
+#include "task_graph.h"
+#include "task_graph_utils.h"
+#include "task_io.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST_CASE("io completion runs as graph task after io")
+{
+	std::atomic<bool> ioDone{ false };
+	bool completionSawIo = false;
+	int result = 0;
+	std::thread::id ioThread;
+	std::thread::id completionThread;
+
+	{
+		TaskGraph graph(2);
+		IoExecutor io(graph, 1);
+
+		io.Submit([&]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			ioThread = std::this_thread::get_id();
+			ioDone = true;
+			return 42;
+		},
+		[&](int value)
+		{
+			completionSawIo = ioDone;
+			completionThread = std::this_thread::get_id();
+			result = value;
+		});
+
+		//nothing else is in graph, it is kept running by request in flight
+		graph.WaitAll();
+	}
+
+	CHECK(completionSawIo);
+	CHECK_EQ(result, 42);
+	CHECK(ioThread != completionThread);
+}
+
+TEST_CASE("prefetcher keeps depth and consumes every item once")
+{
+	const unsigned long long itemsCount = 40;
+	const unsigned int depth = 3;
+	std::vector<std::atomic<int>> consumed(itemsCount);
+	std::atomic<int> ahead{ 0 };
+	std::atomic<int> maxAhead{ 0 };
+
+	{
+		TaskGraph graph(2);
+		IoExecutor io(graph, 2);
+
+		auto prefetcher = std::make_shared<IoPrefetcher<unsigned long long>>(io, depth,
+			[&](unsigned long long number, unsigned long long& item)
+			{
+				if (number >= itemsCount)
+				{
+					return false;
+				}
+				item = number;
+				const int current = ++ahead;
+				int previous = maxAhead;
+				while (current > previous && !maxAhead.compare_exchange_weak(previous, current))
+				{
+				}
+				return true;
+			},
+			[&](unsigned long long number, unsigned long long item)
+			{
+				CHECK_EQ(number, item);
+				++consumed[item];
+				--ahead;
+			});
+		prefetcher->Start();
+
+		graph.WaitAll();
+	}
+
+	for (const auto& count : consumed)
+	{
+		CHECK_EQ(count.load(), 1);
+	}
+	CHECK(maxAhead.load() <= static_cast<int>(depth));
+}
+
+TEST_CASE("write behind is done when graph is done")
+{
+	const int writesCount = 30;
+	const size_t maxWrites = 2;
+	std::atomic<int> written{ 0 };
+	std::atomic<int> writing{ 0 };
+	std::atomic<int> maxWriting{ 0 };
+
+	{
+		TaskGraph graph(2);
+		IoExecutor io(graph, 4, maxWrites);
+
+		ParallelFor<int>(graph, writesCount, [&](unsigned int)
+		{
+			io.SubmitWrite([&]()
+			{
+				const int current = ++writing;
+				int previous = maxWriting;
+				while (current > previous && !maxWriting.compare_exchange_weak(previous, current))
+				{
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				--writing;
+				++written;
+			});
+			return 0;
+		});
+		graph.WaitAll();
+
+		CHECK_EQ(written.load(), writesCount);
+	}
+
+	CHECK(maxWriting.load() <= static_cast<int>(maxWrites));
+}
+
+TEST_CASE("retain nests")
+{
+	std::atomic<bool> spawnedDone{ false };
+	std::thread spawner;
+	TaskGraph graph(2);
+
+	graph.Retain();
+	graph.Retain();
+	graph.AddTask(InitialTaskNode<void>::create([&]()
+	{
+		graph.Release();
+		//still retained once, spawned task after this one finishes is run before WaitAll returns
+		spawner = std::thread([&]()
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+			graph.SpawnTask(InitialTaskNode<void>::create([&]()
+			{
+				spawnedDone = true;
+				graph.Release();
+			}));
+		});
+	}));
+	graph.WaitAll();
+	spawner.join();
+
+	CHECK(spawnedDone);
+}
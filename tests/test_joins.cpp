@@ -0,0 +1,553 @@
+#include "test_framework.h"
+#include "task_graph.h"
+#include "task_graph_utils.h"
+#include "task_coroutine.h"
+#include "task_io.h"
+#include "flow_graph.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST_CASE("multi join gets all parents done")
+{
+	const int parentsCount = 16;
+	std::atomic<int> done{ 0 };
+	int doneSeenByJoin = -1;
+
+	TaskGraph graph(4);
+	std::vector<TaskRef> parents;
+	for (int i = 0; i < parentsCount; ++i)
+	{
+		TaskRef parent = InitialTaskNode<void>::create([&done]() { ++done; });
+		graph.AddTask(parent);
+		parents.push_back(parent);
+	}
+
+	auto join = MultiJoinTaskNode<int>::create([&]() { doneSeenByJoin = done; return doneSeenByJoin; }, parents);
+	graph.AddTaskEdges(parents, join);
+	graph.WaitAll();
+
+	CHECK_EQ(doneSeenByJoin, parentsCount);
+	CHECK_EQ(join->GetResult(), parentsCount);
+}
+
+TEST_CASE("chained joins")
+{
+	std::vector<int> order;
+	TaskGraph graph(3);
+
+	TaskRef a = InitialTaskNode<void>::create([&]() { order.push_back(0); });
+	TaskRef b = InitialTaskNode<void>::create([&]() {});
+	std::vector<TaskRef> firstParents{ a, b };
+	TaskRef firstJoin = MultiJoinTaskNode<void>::create([&]() { order.push_back(1); }, firstParents);
+
+	TaskRef c = InitialTaskNode<void>::create([&]() {});
+	std::vector<TaskRef> secondParents{ firstJoin, c };
+	TaskRef secondJoin = MultiJoinTaskNode<void>::create([&]() { order.push_back(2); }, secondParents);
+
+	graph.AddTask(a);
+	graph.AddTask(b);
+	graph.AddTask(c);
+	graph.AddTaskEdges(firstParents, firstJoin);
+	graph.AddTaskEdges(secondParents, secondJoin);
+	graph.WaitAll();
+
+	CHECK_EQ(order.size(), 3u);
+	CHECK_EQ(order[0], 0);
+	CHECK_EQ(order[1], 1);
+	CHECK_EQ(order[2], 2);
+}
+
+TEST_CASE("chunk stages wait only for chunks they read")
+{
+	const unsigned int chunksCount = 32;
+	std::vector<std::atomic<int>> first(chunksCount);
+	std::vector<std::atomic<int>> second(chunksCount);
+	std::atomic<int> violations{ 0 };
+
+	TaskGraph graph(4);
+	TaskRef noParent;
+	auto firstStage = ParallelForChunks<int>(graph, noParent, chunksCount, [&](unsigned int chunk)
+	{
+		first[chunk] = 1;
+		return 0;
+	});
+
+	auto secondStage = ParallelForAfter<int>(graph, firstStage, chunksCount, [&](unsigned int chunk)
+	{
+		for (unsigned int previous = chunk > 0 ? chunk - 1 : 0; previous <= std::min(chunk + 1, chunksCount - 1); ++previous)
+		{
+			violations += first[previous] == 0;
+		}
+		second[chunk] = 1;
+		return 0;
+	}, ChunkStencil{ 1 });
+
+	//two previous stages, chunk waits for its chunk of both
+	auto thirdStage = ParallelForAfter<void>(graph, { firstStage, secondStage }, chunksCount, [&](unsigned int chunk)
+	{
+		violations += first[chunk] == 0 || second[chunk] == 0;
+	});
+
+	int joined = 0;
+	JoinChunks<void>(graph, thirdStage, [&]() { joined = 1; });
+	graph.WaitAll();
+
+	CHECK_EQ(violations.load(), 0);
+	CHECK_EQ(joined, 1);
+}
+
+TEST_CASE("chunk stages overlap")
+{
+	const unsigned int chunksCount = 8;
+	std::atomic<bool> secondStarted{ false };
+	bool overlapped = false;
+
+	TaskGraph graph(4);
+	TaskRef noParent;
+	auto firstStage = ParallelForChunks<int>(graph, noParent, chunksCount, [&](unsigned int chunk)
+	{
+		//with global join last chunk would wait here until timeout
+		if (chunk == chunksCount - 1)
+		{
+			const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+			while (!secondStarted && std::chrono::steady_clock::now() < deadline)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			overlapped = secondStarted;
+		}
+		return 0;
+	});
+
+	ParallelForAfter<int>(graph, firstStage, chunksCount, [&](unsigned int)
+	{
+		secondStarted = true;
+		return 0;
+	});
+	graph.WaitAll();
+
+	CHECK(overlapped);
+}
+
+TEST_CASE("chunk stages with different chunk counts wait for rows they read")
+{
+	const unsigned int rows = 1000;
+	const unsigned int firstChunksCount = 16;
+	auto chunkRows = [rows](unsigned int chunk, unsigned int chunksCount)
+	{
+		return std::make_pair(rows * chunk / chunksCount, rows * (chunk + 1) / chunksCount);
+	};
+
+	for (unsigned int chunksCount : { 4u, 5u, 16u, 32u, 33u })
+	{
+		std::vector<std::atomic<int>> done(rows);
+		std::atomic<int> violations{ 0 };
+		std::atomic<int> runs{ 0 };
+
+		TaskGraph graph(4);
+		TaskRef noParent;
+		auto firstStage = ParallelForChunks<int>(graph, noParent, firstChunksCount, [&](unsigned int chunk)
+		{
+			//late chunks finish last, so missing dependency is visible
+			std::this_thread::sleep_for(std::chrono::microseconds(200 * chunk));
+			const auto range = chunkRows(chunk, firstChunksCount);
+			for (unsigned int row = range.first; row < range.second; ++row)
+			{
+				done[row] = 1;
+			}
+			return 0;
+		});
+
+		ParallelForAfter<int>(graph, firstStage, chunksCount, [&](unsigned int chunk)
+		{
+			const auto range = chunkRows(chunk, chunksCount);
+			for (unsigned int row = range.first; row < range.second; ++row)
+			{
+				violations += done[row] == 0;
+			}
+			++runs;
+			return 0;
+		});
+		graph.WaitAll();
+
+		CHECK_EQ(violations.load(), 0);
+		CHECK_EQ(runs.load(), static_cast<int>(chunksCount));
+	}
+
+	CHECK(OverlappingChunks(0, 4, 16) == std::vector<unsigned int>({ 0, 1, 2, 3 }));
+	CHECK(OverlappingChunks(20, 32, 16) == std::vector<unsigned int>({ 10 }));
+	CHECK(OverlappingChunks(1, 3, 2) == std::vector<unsigned int>({ 0, 1 }));
+	CHECK(OverlappingChunks(5, 8, 8, 1) == std::vector<unsigned int>({ 4, 5, 6 }));
+}
+
+TEST_CASE("duplicate chunk dependencies add one edge")
+{
+	std::atomic<int> runs{ 0 };
+
+	TaskGraph graph(2);
+	TaskRef noParent;
+	auto firstStage = ParallelForChunks<int>(graph, noParent, 4, [](unsigned int) { return 0; });
+	auto twice = [](unsigned int chunk, unsigned int, unsigned int) { return std::vector<unsigned int>{ chunk, chunk }; };
+	auto secondStage = ParallelForAfter<int>(graph, { firstStage, firstStage }, 4, [&](unsigned int)
+	{
+		++runs;
+		return 0;
+	}, twice);
+
+	graph.WaitAll();
+
+	//edge added twice would notify chunk twice and run it again
+	CHECK_EQ(secondStage.size(), size_t(4));
+	CHECK_EQ(runs.load(), 4);
+}
+
+TEST_CASE("chunk dependency out of range throws")
+{
+	TaskGraph graph(2);
+	TaskRef noParent;
+	auto firstStage = ParallelForChunks<int>(graph, noParent, 2, [](unsigned int) { return 0; });
+	auto outOfRange = [](unsigned int chunk, unsigned int, unsigned int) { return std::vector<unsigned int>{ chunk + 5 }; };
+	CHECK_THROWS(ParallelForAfter<int>(graph, firstStage, 2, [](unsigned int) { return 0; }, outOfRange), std::invalid_argument);
+	graph.WaitAll();
+}
+
+TEST_CASE("flow graph queueing join pairs in order")
+{
+	const int count = 200;
+	std::vector<int> sums;
+	{
+		FlowGraph flowGraph(4);
+
+		JoinNode<QueueingJoin, int, int> join(flowGraph);
+		FunctionNode<std::tuple<int, int>, ContinueMsg> collect(flowGraph, 1,
+			[&sums](const std::tuple<int, int>& pair)
+			{
+				sums.push_back(std::get<0>(pair) + std::get<1>(pair));
+				return ContinueMsg{};
+			});
+		MakeEdge(join, collect);
+
+		for (int i = 0; i < count; ++i)
+		{
+			join.InputPort<0>().TryPut(i);
+			join.InputPort<1>().TryPut(i * 10);
+		}
+		flowGraph.WaitForAll();
+	}
+
+	CHECK_EQ(sums.size(), static_cast<size_t>(count));
+	std::sort(sums.begin(), sums.end());
+	for (int i = 0; i < count; ++i)
+	{
+		CHECK_EQ(sums[i], i * 11);
+	}
+}
+
+TEST_CASE("flow graph tag matching join")
+{
+	const int count = 100;
+	std::vector<long long> products;
+	{
+		FlowGraph flowGraph(4);
+
+		auto tag = [](const int& value) { return static_cast<JoinTag>(value); };
+		JoinNode<TagMatchingJoin, int, int> join(flowGraph, tag, tag);
+		FunctionNode<std::tuple<int, int>, ContinueMsg> collect(flowGraph, 1,
+			[&products](const std::tuple<int, int>& pair)
+			{
+				products.push_back(static_cast<long long>(std::get<0>(pair)) * std::get<1>(pair));
+				return ContinueMsg{};
+			});
+		MakeEdge(join, collect);
+
+		//second port gets tags in reverse order
+		for (int i = 0; i < count; ++i)
+		{
+			join.InputPort<0>().TryPut(i);
+			join.InputPort<1>().TryPut(count - 1 - i);
+		}
+		flowGraph.WaitForAll();
+	}
+
+	CHECK_EQ(products.size(), static_cast<size_t>(count));
+	std::sort(products.begin(), products.end());
+	for (int i = 0; i < count; ++i)
+	{
+		CHECK_EQ(products[i], static_cast<long long>(i) * i);
+	}
+}
+
+//counts body in, keeps highest count seen
+static void RecordRunning(std::atomic<int>& running, std::atomic<int>& maxRunning)
+{
+	const int now = ++running;
+	int seen = maxRunning.load();
+	while (now > seen && !maxRunning.compare_exchange_weak(seen, now))
+	{
+	}
+}
+
+TEST_CASE("flow graph buffer keeps rejected messages in order")
+{
+	FlowGraph flowGraph(2);
+	BufferNode<int> buffer(flowGraph);
+
+	//no successor, everything stays buffered
+	for (int i = 0; i < 5; ++i)
+	{
+		CHECK(buffer.TryPut(i));
+	}
+	CHECK_EQ(buffer.Size(), 5u);
+
+	int message = -1;
+	for (int i = 0; i < 5; ++i)
+	{
+		CHECK(buffer.TryGet(message));
+		CHECK_EQ(message, i);
+	}
+	CHECK(!buffer.TryGet(message));
+	CHECK_EQ(buffer.Size(), 0u);
+}
+
+TEST_CASE("flow graph rejecting node pulls messages from buffer")
+{
+	const int count = 30;
+	std::vector<int> processed;
+	std::atomic<bool> release{ false };
+	std::atomic<int> running{ 0 };
+	std::atomic<int> maxRunning{ 0 };
+	{
+		FlowGraph flowGraph(2);
+		BufferNode<int> buffer(flowGraph);
+		FunctionNode<int, ContinueMsg> serial(flowGraph, 1, [&](const int& value)
+		{
+			RecordRunning(running, maxRunning);
+			//first body holds the only slot till all other messages are rejected
+			while (!release)
+			{
+				std::this_thread::yield();
+			}
+			processed.push_back(value);
+			--running;
+			return ContinueMsg{};
+		}, FlowPolicy::Rejecting);
+		MakeEdge(buffer, serial);
+
+		for (int i = 0; i < count; ++i)
+		{
+			buffer.TryPut(i);
+		}
+		CHECK_EQ(buffer.Size(), static_cast<size_t>(count - 1));
+
+		release = true;
+		flowGraph.WaitForAll();
+		CHECK_EQ(buffer.Size(), 0u);
+	}
+
+	CHECK_EQ(maxRunning.load(), 1);
+	CHECK_EQ(processed.size(), static_cast<size_t>(count));
+	for (int i = 0; i < count; ++i)
+	{
+		CHECK_EQ(processed[i], i);
+	}
+}
+
+TEST_CASE("flow graph limiter never exceeds threshold")
+{
+	const int count = 50;
+	const size_t threshold = 3;
+	std::atomic<int> running{ 0 };
+	std::atomic<int> maxRunning{ 0 };
+	std::atomic<int> processed{ 0 };
+	{
+		FlowGraph flowGraph(4);
+		BufferNode<int> buffer(flowGraph);
+		LimiterNode<int> limiter(flowGraph, threshold);
+		FunctionNode<int, ContinueMsg> work(flowGraph, UnlimitedConcurrency, [&](const int&)
+		{
+			RecordRunning(running, maxRunning);
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+			++processed;
+			--running;
+			return ContinueMsg{};
+		});
+		MakeEdge(buffer, limiter);
+		MakeEdge(limiter, work);
+		//every finished body lets next message through limiter
+		MakeEdge(work, limiter.DecrementPort());
+
+		for (int i = 0; i < count; ++i)
+		{
+			buffer.TryPut(i);
+		}
+		flowGraph.WaitForAll();
+		CHECK_EQ(buffer.Size(), 0u);
+	}
+
+	CHECK_EQ(processed.load(), count);
+	CHECK(maxRunning.load() <= static_cast<int>(threshold));
+}
+
+TEST_CASE("flow graph sequencer restores order")
+{
+	const int count = 64;
+	std::vector<int> ordered;
+	{
+		FlowGraph flowGraph(4);
+		SequencerNode<int> sequencer(flowGraph, [](const int& value) { return static_cast<size_t>(value); });
+		FunctionNode<int, ContinueMsg> collect(flowGraph, 1, [&ordered](const int& value)
+		{
+			ordered.push_back(value);
+			return ContinueMsg{};
+		});
+		MakeEdge(sequencer, collect);
+
+		//both halves arrive backwards, first half first
+		for (int i = count / 2 - 2; i >= 0; i -= 2)
+		{
+			sequencer.TryPut(i + 1);
+			sequencer.TryPut(i);
+		}
+		for (int i = count - 2; i >= count / 2; i -= 2)
+		{
+			sequencer.TryPut(i + 1);
+			sequencer.TryPut(i);
+		}
+		flowGraph.WaitForAll();
+	}
+
+	CHECK_EQ(ordered.size(), static_cast<size_t>(count));
+	for (int i = 0; i < count; ++i)
+	{
+		CHECK_EQ(ordered[i], i);
+	}
+}
+
+#ifdef TASKGRAPH_HAS_COROUTINES
+TEST_CASE("coroutine awaits task and graph")
+{
+	TaskGraph graph(2);
+
+	auto produce = InitialTaskNode<int>::create([]() { return 1000; });
+	auto consume = CoroutineTaskNode<int>::create([&]() -> TaskCoroutine<int>
+	{
+		int input = co_await AwaitTask<int>(produce);
+
+		TaskGraph subGraph(1);
+		auto node = InitialTaskNode<int>::create([]() { return 5; });
+		subGraph.AddTask(node);
+		co_await AwaitGraph(subGraph);
+
+		co_return input + node->GetResult();
+	});
+
+	graph.AddTask(consume);
+	graph.AddTask(produce);
+	graph.WaitAll();
+
+	CHECK_EQ(consume->GetResult(), 1005);
+}
+
+TEST_CASE("coroutine destroys awaited local graph right after it is done")
+{
+	TaskGraph graph(4);
+	std::atomic<int> runs{ 0 };
+
+	auto coroutine = CoroutineTaskNode<int>::create([&]() -> TaskCoroutine<int>
+	{
+		//trivial task may finish and resume coroutine before AwaitGraph returns, sub graph dies at end of every pass
+		for (int repeat = 0; repeat < 200; ++repeat)
+		{
+			TaskGraph subGraph(1);
+			subGraph.AddTask(InitialTaskNode<void>::create([&]() { ++runs; }));
+			co_await AwaitGraph(subGraph);
+		}
+		co_return runs.load();
+	});
+
+	graph.AddTask(coroutine);
+	graph.WaitAll();
+
+	CHECK_EQ(coroutine->GetResult(), 200);
+}
+
+TEST_CASE("coroutine awaits parallel for and blocking call")
+{
+	TaskGraph graph(2);
+
+	auto coroutine = CoroutineTaskNode<int>::create([]() -> TaskCoroutine<int>
+	{
+		std::vector<int> chunks(8, 0);
+		co_await ParallelForAsync<int>(8, [&chunks](unsigned int chunk) { chunks[chunk] = static_cast<int>(chunk); return 0; });
+
+		int blocking = co_await AwaitBlockingCall([]() { return 100; });
+
+		int sum = blocking;
+		for (auto chunk : chunks)
+		{
+			sum += chunk;
+		}
+		co_return sum;
+	});
+
+	graph.AddTask(coroutine);
+	graph.WaitAll();
+
+	CHECK_EQ(coroutine->GetResult(), 128);
+}
+
+TEST_CASE("coroutine awaits run on workers of its graph")
+{
+	//one worker, so every awaited task runs on thread of coroutine
+	TaskGraph graph(1);
+	IoThreadPool io(1);
+	std::thread::id coroutineThread;
+	std::atomic<int> otherThreads{ 0 };
+	std::thread::id blockingThread;
+
+	auto coroutine = CoroutineTaskNode<int>::create([&]() -> TaskCoroutine<int>
+	{
+		coroutineThread = std::this_thread::get_id();
+
+		//sub graph with join, both parents have to be done first
+		TaskGraph subGraph(4);
+		auto left = InitialTaskNode<int>::create([&]() { otherThreads += std::this_thread::get_id() != coroutineThread; return 2; });
+		auto right = InitialTaskNode<int>::create([&]() { otherThreads += std::this_thread::get_id() != coroutineThread; return 3; });
+		auto join = MultiJoinTaskNode<int>::create([&]()
+		{
+			otherThreads += std::this_thread::get_id() != coroutineThread;
+			return left->GetResult() * right->GetResult();
+		}, std::vector<TaskRef>{ left, right });
+		subGraph.AddTask(left);
+		subGraph.AddTask(right);
+		subGraph.AddTaskEdges({ left, right }, join);
+
+		for (int repeat = 0; repeat < 50; ++repeat)
+		{
+			co_await ParallelForAsync<int>(4, [&](unsigned int)
+			{
+				otherThreads += std::this_thread::get_id() != coroutineThread;
+				return 0;
+			});
+		}
+		co_await AwaitGraph(subGraph);
+
+		int blocking = co_await AwaitBlockingCall(io, [&]()
+		{
+			blockingThread = std::this_thread::get_id();
+			return 10;
+		});
+
+		otherThreads += std::this_thread::get_id() != coroutineThread;
+		co_return join->GetResult() + blocking;
+	});
+
+	graph.AddTask(coroutine);
+	graph.WaitAll();
+
+	CHECK_EQ(coroutine->GetResult(), 16);
+	CHECK_EQ(otherThreads.load(), 0);
+	CHECK(blockingThread != coroutineThread);
+}
+#endif
@@ -0,0 +1,6 @@
+#include "test_framework.h"
+
+int main(int argc, char* argv[])
+{
+	return RunTests(argc, argv);
+}
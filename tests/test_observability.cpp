@@ -0,0 +1,376 @@
+#include "test_framework.h"
+#include "task_graph.h"
+#include "task_graph_utils.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <locale>
+#include <sstream>
+#include <thread>
+
+static size_t CountOccurrences(const std::string& text, const std::string& pattern)
+{
+	size_t count = 0;
+	for (auto position = text.find(pattern); position != std::string::npos; position = text.find(pattern, position + 1))
+	{
+		++count;
+	}
+	return count;
+}
+
+//groups every digit and uses decimal comma
+struct GroupingPunct : std::numpunct<char>
+{
+	char do_decimal_point() const override { return ','; }
+	char do_thousands_sep() const override { return '.'; }
+	std::string do_grouping() const override { return "\1"; }
+};
+
+TEST_CASE("trace has every task")
+{
+	const int count = 100;
+	TaskGraph graph(2);
+	graph.EnableTracing();
+
+	for (int i = 0; i < count; ++i)
+	{
+		graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	}
+	graph.WaitAll();
+
+	std::ostringstream trace;
+	graph.GetTracer()->WriteChromeTrace(trace);
+
+	CHECK_EQ(graph.GetTracer()->GetDroppedEvents(), 0ull);
+	CHECK_EQ(CountOccurrences(trace.str(), "\"cat\":\"task\""), static_cast<size_t>(count));
+	CHECK(trace.str().find("coordinator") != std::string::npos);
+}
+
+TEST_CASE("trace numbers ignore locale of stream")
+{
+	TaskGraph graph(2);
+	graph.EnableTracing();
+	for (int i = 0; i < 20; ++i)
+	{
+		graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	}
+	graph.WaitAll();
+
+	std::ostringstream trace;
+	graph.GetTracer()->WriteChromeTrace(trace);
+	std::ostringstream localized;
+	localized.imbue(std::locale(std::locale::classic(), new GroupingPunct));
+	graph.GetTracer()->WriteChromeTrace(localized);
+
+	CHECK_EQ(localized.str(), trace.str());
+	localized.str("");
+	localized << 1.5;
+	CHECK_EQ(localized.str(), std::string("1,5"));
+}
+
+TEST_CASE("trace escapes task names for json")
+{
+	TaskGraph graph(1);
+	graph.EnableTracing();
+	graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	graph.WaitAll();
+
+	std::ostringstream trace;
+	graph.GetTracer()->WriteChromeTrace(trace, [](unsigned int) { return std::string("a\"b\\c\nd\te\x01"); });
+
+	CHECK(trace.str().find("a\\\"b\\\\c\\u000ad\\u0009e\\u0001") != std::string::npos);
+}
+
+TEST_CASE("statistics count executed tasks and reset")
+{
+	TaskGraph graph(3);
+	for (int i = 0; i < 300; ++i)
+	{
+		graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	}
+	graph.WaitAll();
+
+	const auto statistics = graph.GetStatistics();
+	CHECK_EQ(statistics.workers.size(), 3u);
+	CHECK_EQ(statistics.Total().executedTasks, 300ull);
+	CHECK(statistics.Total().queueHighWater > 0);
+
+	graph.ResetStatistics();
+	CHECK_EQ(graph.GetStatistics().Total().executedTasks, 0ull);
+}
+
+TEST_CASE("completion batches add up to completed tasks")
+{
+	const unsigned long long count = 500;
+	TaskGraph graph(4);
+
+	//chain and independent tasks, so batches of different sizes are possible
+	TaskRef previous = InitialTaskNode<void>::create([]() {});
+	graph.AddTask(previous);
+	for (unsigned long long i = 1; i < count / 2; ++i)
+	{
+		TaskRef next = InitialTaskNode<void>::create([]() {});
+		graph.AddTaskEdge(previous, next);
+		previous = next;
+	}
+	for (unsigned long long i = count / 2; i < count; ++i)
+	{
+		graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	}
+	graph.WaitAll();
+
+	const auto statistics = graph.GetCompletionBatchStatistics();
+	CHECK_EQ(statistics.completedTasks, count);
+	CHECK(statistics.batches > 0);
+	CHECK(statistics.batches <= count);
+
+	//every batch is in one bucket, bucket bounds its size
+	unsigned long long histogramBatches = 0;
+	unsigned long long minTasks = 0;
+	unsigned long long maxTasks = 0;
+	for (size_t bucket = 0; bucket < statistics.batchSizeHistogram.size(); ++bucket)
+	{
+		const auto batches = statistics.batchSizeHistogram[bucket];
+		histogramBatches += batches;
+		minTasks += batches << bucket;
+		maxTasks += bucket + 1 < statistics.batchSizeHistogram.size() ? batches * ((2ull << bucket) - 1) : batches * count;
+	}
+	CHECK_EQ(histogramBatches, statistics.batches);
+	CHECK(minTasks <= statistics.completedTasks);
+	CHECK(statistics.completedTasks <= maxTasks);
+}
+
+TEST_CASE("profile finds critical path of chain")
+{
+	TaskGraph graph(2);
+	graph.EnableProfiling();
+
+	TaskRef first = InitialTaskNode<void>::create([]() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); });
+	TaskRef second = InitialTaskNode<void>::create([]() { std::this_thread::sleep_for(std::chrono::milliseconds(2)); });
+	TaskRef side = InitialTaskNode<void>::create([]() {});
+	graph.AddTask(first);
+	graph.AddTask(side);
+	graph.AddTaskEdge(first, second);
+	graph.WaitAll();
+
+	const auto report = graph.AnalyzeLastExecution();
+	const std::vector<TaskId> expectedPath{ first->GetTaskId(), second->GetTaskId() };
+	CHECK(report.criticalPath == expectedPath);
+	CHECK(report.span >= 4 * 1000000LL);
+	CHECK(report.work >= report.span);
+	CHECK_EQ(report.workerUtilization.size(), 2u);
+}
+
+TEST_CASE("perf counters are summed by task name and type")
+{
+	ExecutionProfile profile;
+	auto addTask = [&profile](TaskId taskId, const char* name, const char* typeName, unsigned int runs,
+		unsigned long long cycles, unsigned long long instructions)
+	{
+		auto& task = profile.tasks[taskId];
+		task.taskId = taskId;
+		task.name = name;
+		task.typeName = typeName;
+		task.runs = runs;
+		task.counters.cycles = cycles;
+		task.counters.instructions = instructions;
+		task.counters.llcMisses = instructions / 100;
+		task.counters.branchMisses = instructions / 1000;
+	};
+	addTask(1, "decode", "InitialTaskNode", 1, 1000, 2000);
+	addTask(2, "decode", "InitialTaskNode", 2, 3000, 4000);
+	addTask(3, "merge", "MultiJoinTaskNode", 1, 500, 250);
+	addTask(4, "", "InitialTaskNode", 1, 100, 100);
+	//task that never ran is left out
+	addTask(5, "merge", "MultiJoinTaskNode", 0, 7, 7);
+
+	const auto report = AggregatePerfCounters(profile);
+
+	CHECK_EQ(report.byName.size(), 3u);
+	const auto& decode = report.byName.at("decode");
+	CHECK_EQ(decode.tasks, 2ull);
+	CHECK_EQ(decode.values.cycles, 4000ull);
+	CHECK_EQ(decode.values.instructions, 6000ull);
+	CHECK_EQ(decode.values.llcMisses, 60ull);
+	CHECK_EQ(decode.values.branchMisses, 6ull);
+	CHECK(std::abs(decode.InstructionsPerCycle() - 1.5) < 1e-12);
+	CHECK(std::abs(decode.LlcMissesPerKiloInstruction() - 10.0) < 1e-12);
+	CHECK_EQ(report.byName.at("merge").tasks, 1ull);
+	CHECK_EQ(report.byName.at("merge").values.cycles, 500ull);
+	CHECK_EQ(report.byName.at("unnamed").values.cycles, 100ull);
+
+	CHECK_EQ(report.byType.size(), 2u);
+	CHECK_EQ(report.byType.at("InitialTaskNode").tasks, 3ull);
+	CHECK_EQ(report.byType.at("InitialTaskNode").values.instructions, 6100ull);
+	CHECK_EQ(report.byType.at("MultiJoinTaskNode").values.instructions, 250ull);
+
+	//both groupings cover the same tasks
+	PerfCounterSummary byName;
+	for (const auto& summary : report.byName)
+	{
+		byName.tasks += summary.second.tasks;
+		byName.values += summary.second.values;
+	}
+	PerfCounterSummary byType;
+	for (const auto& summary : report.byType)
+	{
+		byType.tasks += summary.second.tasks;
+		byType.values += summary.second.values;
+	}
+	CHECK_EQ(byName.tasks, 4ull);
+	CHECK_EQ(byType.tasks, 4ull);
+	CHECK_EQ(byName.values.cycles, 4600ull);
+	CHECK_EQ(byType.values.cycles, 4600ull);
+	CHECK_EQ(byType.values.branchMisses, byName.values.branchMisses);
+}
+
+TEST_CASE("export names nodes and edges")
+{
+	TaskGraph graph(2);
+	graph.EnableProfiling();
+
+	TaskRef parent = InitialTaskNode<void>::create([]() {});
+	parent->SetName("parent");
+	TaskRef child = InitialTaskNode<void>::create([]() {});
+	child->SetName("child");
+	graph.AddTask(parent);
+	graph.AddTaskEdge(parent, child);
+	graph.WaitAll();
+
+	auto description = DescribeExecution(graph.GetExecutionProfile());
+	CHECK_EQ(description.nodes.size(), 2u);
+
+	std::ostringstream dot;
+	GraphExporter(description).WriteDot(dot);
+	CHECK(dot.str().find("digraph") != std::string::npos);
+	CHECK(dot.str().find("label=\"parent\\nInitialTaskNode") != std::string::npos);
+	CHECK(dot.str().find("->") != std::string::npos);
+
+	std::ostringstream graphML;
+	GraphExporter(description).WriteGraphML(graphML);
+	CHECK(graphML.str().find("<graphml") != std::string::npos);
+	CHECK_EQ(CountOccurrences(graphML.str(), "<edge "), 1u);
+
+	//locale of caller's stream groups every digit, export must not use it
+	std::ostringstream grouped;
+	grouped.imbue(std::locale(std::locale::classic(), new GroupingPunct));
+	GraphExporter(description).WriteGraphML(grouped);
+	CHECK_EQ(grouped.str(), graphML.str());
+	CHECK(grouped.str().find(',') == std::string::npos);
+	grouped.str("");
+	grouped << 12;
+	CHECK_EQ(grouped.str(), std::string("1.2"));
+}
+
+TEST_CASE("latency histogram percentiles")
+{
+	LatencyHistogram histogram;
+	CHECK_EQ(histogram.GetValueAtPercentile(50), 0ull);
+
+	for (unsigned long long value = 1; value <= 100000; ++value)
+	{
+		histogram.Record(value);
+	}
+
+	CHECK_EQ(histogram.GetCount(), 100000ull);
+	CHECK_EQ(histogram.GetMin(), 1ull);
+	CHECK_EQ(histogram.GetMax(), 100000ull);
+	CHECK(std::abs(static_cast<double>(histogram.GetValueAtPercentile(50)) - 50000) < 50000 / 16.0);
+	CHECK(std::abs(static_cast<double>(histogram.GetValueAtPercentile(99.9)) - 99900) < 99900 / 16.0);
+
+	LatencyHistogram other;
+	other.Record(1000000);
+	histogram.Merge(other);
+	CHECK_EQ(histogram.GetMax(), 1000000ull);
+	CHECK(std::abs(static_cast<double>(histogram.GetValueAtPercentile(100)) - 1000000) < 1000000 / 16.0);
+}
+
+TEST_CASE("cost model learns from run")
+{
+	auto model = std::make_shared<TaskCostModel>();
+	TaskGraph graph(2);
+	graph.SetCostModel(model);
+
+	for (int i = 0; i < 10; ++i)
+	{
+		TaskRef task = InitialTaskNode<void>::create([]() {});
+		task->SetName("learned");
+		graph.AddTask(task);
+	}
+	graph.WaitAll();
+
+	CHECK_EQ(model->GetLatencyHistogram("learned").GetCount(), 10ull);
+	CHECK(model->EstimateNanoseconds("unknown", 123) == 123);
+}
+
+TEST_CASE("queue monitor samples pinned backlog")
+{
+	const unsigned int numThreads = 4;
+	const std::string prometheusFile = "test_queue_monitor.prom";
+
+	TaskGraph graph(numThreads);
+	auto& monitor = graph.EnableQueueMonitor(std::chrono::milliseconds(1));
+	monitor.SetPrometheusFile(prometheusFile);
+
+	//everything pinned to worker 0 piles up in its queue
+	for (int i = 0; i < 200; ++i)
+	{
+		TaskRef task = InitialTaskNode<void>::create([]() { std::this_thread::sleep_for(std::chrono::microseconds(100)); });
+		task->SetAffinity({ 0 });
+		graph.AddTask(task);
+	}
+	graph.WaitAll();
+
+	const auto samples = graph.GetQueueMonitor()->GetSamples();
+	CHECK(!samples.empty());
+
+	size_t deepestQueue = 0;
+	for (const auto& sample : samples)
+	{
+		CHECK_EQ(sample.workerJobs.size(), static_cast<size_t>(numThreads));
+		deepestQueue = std::max(deepestQueue, sample.MaxWorkerJobs());
+	}
+	CHECK(deepestQueue > 0);
+
+	std::ifstream file(prometheusFile);
+	std::stringstream text;
+	text << file.rdbuf();
+	CHECK(text.str().find("taskgraph_worker_queue_depth{worker=\"3\"}") != std::string::npos);
+	CHECK(text.str().find("# TYPE taskgraph_queue_imbalance gauge") != std::string::npos);
+	std::remove(prometheusFile.c_str());
+}
+
+TEST_CASE("queue monitor writes plain numbers in any global locale")
+{
+	QueueDepthSample sample;
+	sample.workerJobs = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 1500 };
+	sample.pendingTasks = 1234;
+	sample.unfinishedTasks = 56789;
+
+	const auto previous = std::locale::global(std::locale(std::locale::classic(), new GroupingPunct));
+	std::ostringstream text;
+	QueueMonitor::WritePrometheus(text, sample);
+	std::locale::global(previous);
+
+	CHECK(text.str().find("taskgraph_worker_queue_depth{worker=\"11\"} 1500\n") != std::string::npos);
+	CHECK(text.str().find("taskgraph_pending_tasks 1234\n") != std::string::npos);
+	CHECK(text.str().find("taskgraph_unfinished_tasks 56789\n") != std::string::npos);
+	CHECK(text.str().find("taskgraph_queue_imbalance 11.49") != std::string::npos);
+
+	//stream keeps its own locale after export
+	text.str("");
+	text << 12;
+	CHECK_EQ(text.str(), std::string("1.2"));
+}
+
+#ifdef __linux__
+TEST_CASE("too long monitor socket path throws before graph runs")
+{
+	TaskGraph graph(2);
+	auto& monitor = graph.EnableQueueMonitor(std::chrono::milliseconds(1));
+	CHECK_THROWS(monitor.SetPrometheusSocket(std::string(200, 'x')), std::invalid_argument);
+
+	graph.AddTask(InitialTaskNode<void>::create([]() {}));
+	graph.WaitAll();
+}
+#endif
@@ -0,0 +1,165 @@
+#include "test_framework.h"
+#include "task_graph.h"
+#include "task_graph_utils.h"
+#include "task_pipeline.h"
+#include <atomic>
+#include <random>
+#include <thread>
+
+//sizes are kept small so the suite stays fast under ThreadSanitizer
+
+TEST_CASE("many independent tasks")
+{
+	const int count = 20000;
+	std::atomic<int> executed{ 0 };
+
+	TaskGraph graph(4);
+	for (int i = 0; i < count; ++i)
+	{
+		graph.AddTask(InitialTaskNode<void>::create([&executed]() { ++executed; }));
+	}
+	graph.WaitAll();
+
+	CHECK_EQ(executed.load(), count);
+	CHECK_EQ(graph.GetStatistics().Total().executedTasks, static_cast<unsigned long long>(count));
+}
+
+TEST_CASE("recursive spawning")
+{
+	std::atomic<int> executed{ 0 };
+	TaskGraph graph(4);
+
+	//binary tree of depth 10 built by spawning from running tasks
+	std::function<void(int)> spawnLevel = [&](int depth)
+	{
+		++executed;
+		if (depth == 0)
+		{
+			return;
+		}
+		for (int child = 0; child < 2; ++child)
+		{
+			graph.SpawnTask(InitialTaskNode<void>::create([&spawnLevel, depth]() { spawnLevel(depth - 1); }));
+		}
+	};
+	graph.AddTask(InitialTaskNode<void>::create([&spawnLevel]() { spawnLevel(10); }));
+	graph.WaitAll();
+
+	CHECK_EQ(executed.load(), (1 << 11) - 1);
+}
+
+TEST_CASE("nested graphs in parallel tasks")
+{
+	const unsigned int outerChunks = 16;
+	std::vector<int> results(outerChunks, 0);
+
+	TaskGraph graph(4);
+	ParallelFor<int>(graph, outerChunks, [&results](unsigned int chunk)
+	{
+		TaskGraph subGraph(2);
+		std::atomic<int> sum{ 0 };
+		for (int i = 1; i <= 10; ++i)
+		{
+			subGraph.AddTask(InitialTaskNode<void>::create([&sum, i]() { sum += i; }));
+		}
+		subGraph.WaitAll();
+		results[chunk] = sum;
+		return 0;
+	});
+	graph.WaitAll();
+
+	for (auto result : results)
+	{
+		CHECK_EQ(result, 55);
+	}
+}
+
+TEST_CASE("retained graph takes tasks from other thread")
+{
+	const int count = 500;
+	std::atomic<int> executed{ 0 };
+
+	TaskGraph graph(4);
+	graph.Retain();
+
+	std::thread coordinator([&graph]() { graph.WaitAll(); });
+	for (int i = 0; i < count; ++i)
+	{
+		graph.SpawnTask(InitialTaskNode<void>::create([&executed]() { ++executed; }));
+	}
+
+	while (executed < count)
+	{
+		std::this_thread::yield();
+	}
+	graph.Release();
+	coordinator.join();
+
+	CHECK_EQ(executed.load(), count);
+}
+
+TEST_CASE("pipeline keeps serial order")
+{
+	const int count = 300;
+	int produced = 0;
+	std::vector<int> output;
+
+	ParallelPipeline(4,
+		MakeFilter<void, int>(FilterMode::SerialInOrder,
+			[&produced](FlowControl& flowControl) -> int
+			{
+				if (produced == count)
+				{
+					flowControl.Stop();
+					return 0;
+				}
+				return produced++;
+			}) &
+		MakeFilter<int, int>(FilterMode::Parallel,
+			[](int value) -> int
+			{
+				return value * 2;
+			}) &
+		MakeFilter<int, void>(FilterMode::SerialInOrder,
+			[&output](int value)
+			{
+				output.push_back(value);
+			}),
+		4);
+
+	CHECK_EQ(output.size(), static_cast<size_t>(count));
+	for (int i = 0; i < count; ++i)
+	{
+		CHECK_EQ(output[i], i * 2);
+	}
+}
+
+TEST_CASE("repeated random graphs")
+{
+	std::mt19937 random(11);
+	TaskGraph graph(4);
+
+	for (int run = 0; run < 30; ++run)
+	{
+		std::atomic<int> executed{ 0 };
+		std::vector<TaskRef> tasks;
+		const int count = 50 + static_cast<int>(random() % 150);
+
+		for (int i = 0; i < count; ++i)
+		{
+			TaskRef task = InitialTaskNode<void>::create([&executed]() { ++executed; });
+			if (tasks.empty() || random() % 4 == 0)
+			{
+				graph.AddTask(task);
+			}
+			else
+			{
+				graph.AddTaskEdge(tasks[random() % tasks.size()], task);
+			}
+			tasks.push_back(task);
+		}
+		graph.WaitAll();
+
+		CHECK_EQ(executed.load(), count);
+	}
+}